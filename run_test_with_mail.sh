@@ -25,21 +25,23 @@ if [ $# -eq 2 ] ; then
 	TESTSUBJECT="$SUBJECT $2 $DATE"
 	LOGFILE="run_log_$1_$DATE"
 
-	if $(./testfw -u $1 -t $2 1>run_log_$1_$DATE) ; then
-		if [ $(which mailx) ] && [ $SEND_EMAIL = "yes" ] ; then
-			mailx -S smtp="$SMTP_SRV" -r "$SENDER_ADDRESS" -s "$TESTSUBJECT" -v "$1" < $LOGFILE
-		else
-			echo "No mailx binary found or configuration is lacking parameters. Tests are not sent, see $LOGFILE"
-		fi
+	./testfw -u $1 -t $2 1>$LOGFILE
+	STATUS=$?
+	
+	# 0 passed, 1 no such test or user, 2 latency budget exceeded, 3 failed
+	case $STATUS in
+		0) ;;
+		1) TESTSUBJECT="$TESTSUBJECT [FAILED - NO SUCH TEST OR USER]" ;;
+		2) TESTSUBJECT="$TESTSUBJECT [SLOW - LATENCY BUDGET EXCEEDED]" ;;
+		*) TESTSUBJECT="$TESTSUBJECT [FAILED]" ;;
+	esac
+	
+	if [ $(which mailx) ] && [ $SEND_EMAIL = "yes" ] ; then
+		mailx -S smtp="$SMTP_SRV" -r "$SENDER_ADDRESS" -s "$TESTSUBJECT" -v "$1" < $LOGFILE
 	else
-		ERROR="$TESTSUBJECT [FAILED - NO SUCH TEST OR USER]"
-		if [ $(which mailx) ] && [ $SEND_EMAIL = "no" ] ; then
-			mailx -S smtp="$SMTP_SRV" -r "$SENDER_ADDRESS" -s "$ERROR" -v "$1" < $LOGFILE
-		else
-			echo "No mailx binary found or configuration is lacking parameters. Test running was not successful, see $LOGFILE"
-		fi
+		echo "No mailx binary found or configuration is lacking parameters. Tests are not sent, see $LOGFILE"
 	fi
-	exit 0
+	exit $STATUS
 else
 	echo "Not enough parameters, run: $0 USERNAME TESTNAME"
 	exit 1
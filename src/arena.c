@@ -0,0 +1,370 @@
+#include <stdarg.h>
+#include "arena.h"
+
+static arena* run_arena = NULL; // Transient data of a test run
+static arena* step_arena = NULL; // Transient data of a single step
+static guint64 run_heap_start = 0; // Heap allocations of the process when the run started
+
+#ifdef ALLOC_STATS
+extern gpointer __libc_malloc(gsize size);
+extern gpointer __libc_calloc(gsize count, gsize size);
+extern gpointer __libc_realloc(gpointer memory, gsize size);
+
+static guint64 heap_allocations = 0; // Heap allocations of the process
+
+/**
+* Count heap allocations of the process, including those of glib and
+* curl. Built only with ALLOC_STATS, memory is allocated by glibc.
+*/
+gpointer malloc(gsize size) {
+	__atomic_fetch_add(&heap_allocations,1,__ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+gpointer calloc(gsize count, gsize size) {
+	__atomic_fetch_add(&heap_allocations,1,__ATOMIC_RELAXED);
+	return __libc_calloc(count,size);
+}
+
+gpointer realloc(gpointer memory, gsize size) {
+	if(!memory) __atomic_fetch_add(&heap_allocations,1,__ATOMIC_RELAXED);
+	return __libc_realloc(memory,size);
+}
+#endif
+
+/**
+* Initialize a new arena with g_new0() that must be free'd with arena_free().
+* Memory is allocated from heap in blocks of given size and allocations
+* are served from the blocks by increasing the amount of used data.
+*
+* @param block_size Size of a single block
+*
+* @return Pointer to newly allocated arena_t
+*/
+arena* arena_new(gsize block_size) {
+	arena* ar = g_new0(struct arena_t,1);
+	ar->block_size = block_size > 0 ? block_size : ARENA_STEP_BLOCK_SIZE;
+	return ar;
+}
+
+/**
+* Add a new block to arena. Block is at least size of block_size of
+* the arena, allocations bigger than that get a block of their own.
+*
+* @param ar Arena to add to
+* @param size Minimum size of the data in block
+*
+* @return TRUE when block was allocated
+*/
+static gboolean arena_add_block(arena* ar, gsize size) {
+	gsize blocksize = MAX(size, ar->block_size);
+	arena_block* block = (arena_block*)g_try_malloc(sizeof(arena_block) + blocksize);
+
+	if(!block) {
+		g_error("not enough memory for arena block of %" G_GSIZE_FORMAT " bytes\n",blocksize);
+		return FALSE;
+	}
+
+	block->size = blocksize;
+	block->used = 0;
+	block->next = ar->blocks;
+	ar->blocks = block;
+	ar->blocks_allocated++;
+	return TRUE;
+}
+
+/**
+* Allocate memory from arena. Memory is aligned to ARENA_ALIGN and is
+* valid until the arena is reset or free'd, it must not be free'd
+* with g_free(). Without arena memory is allocated from heap and must
+* be free'd with g_free(), this applies to all arena functions.
+*
+* @param ar Arena to allocate from, NULL allocates from heap
+* @param size Amount of memory to allocate
+*
+* @return Pointer to allocated memory
+*/
+gpointer arena_alloc(arena* ar, gsize size) {
+	if(!ar) return g_malloc(size);
+
+	gsize aligned = (size + ARENA_ALIGN - 1) & ~((gsize)ARENA_ALIGN - 1);
+
+	if(!ar->blocks || ar->blocks->used + aligned > ar->blocks->size)
+		if(!arena_add_block(ar,aligned)) return NULL;
+
+	gpointer memory = &(ar->blocks->data[ar->blocks->used]);
+	ar->blocks->used += aligned;
+
+	ar->allocations++;
+	ar->bytes += size;
+	return memory;
+}
+
+/**
+* Duplicate string to arena.
+*
+* @param ar Arena to allocate from
+* @param string String to duplicate, can be NULL
+*
+* @return Duplicated string in arena or NULL if string is NULL
+*/
+gchar* arena_strdup(arena* ar, const gchar* string) {
+	if(!string) return NULL;
+	return arena_strndup(ar,string,strlen(string));
+}
+
+/**
+* Duplicate given amount of characters of string to arena. Duplicate
+* is always NUL terminated.
+*
+* @param ar Arena to allocate from
+* @param string String to duplicate, can be NULL
+* @param length Amount of characters to duplicate
+*
+* @return Duplicated string in arena or NULL if string is NULL
+*/
+gchar* arena_strndup(arena* ar, const gchar* string, gsize length) {
+	if(!string) return NULL;
+	gchar* dup = (gchar*)arena_alloc(ar,length + 1);
+	if(dup) {
+		memcpy(dup,string,length);
+		dup[length] = '\0';
+	}
+	return dup;
+}
+
+/**
+* Join strings with separator to arena. Works as g_strjoin(),
+* last parameter must be NULL.
+*
+* @param ar Arena to allocate from
+* @param separator Separator to add between strings, can be NULL
+*
+* @return Joined string in arena
+*/
+gchar* arena_strjoin(arena* ar, const gchar* separator, ...) {
+	va_list args, count;
+	gsize seplen = separator ? strlen(separator) : 0;
+	gsize length = 0;
+	gint strings = 0;
+
+	va_start(args,separator);
+	va_copy(count,args);
+
+	// Calculate length of the result
+	for(const gchar* str = va_arg(count,const gchar*); str; str = va_arg(count,const gchar*)) {
+		length += strlen(str);
+		strings++;
+	}
+	va_end(count);
+	if(strings > 1) length += seplen * (strings - 1);
+
+	gchar* joined = (gchar*)arena_alloc(ar,length + 1);
+	gchar* pos = joined;
+
+	// Copy strings with separators
+	for(gint index = 0; joined && index < strings; index++) {
+		const gchar* str = va_arg(args,const gchar*);
+		gsize strlength = strlen(str);
+
+		if(index > 0 && seplen) {
+			memcpy(pos,separator,seplen);
+			pos += seplen;
+		}
+		memcpy(pos,str,strlength);
+		pos += strlength;
+	}
+	va_end(args);
+
+	if(joined) *pos = '\0';
+	return joined;
+}
+
+/**
+* Join NULL terminated array of strings with separator to arena. Works
+* as g_strjoinv().
+*
+* @param ar Arena to allocate from
+* @param separator Separator to add between strings, can be NULL
+* @param strings Strings to join
+*
+* @return Joined string in arena
+*/
+gchar* arena_strjoinv(arena* ar, const gchar* separator, gchar** strings) {
+	if(!strings) return NULL;
+
+	gsize seplen = separator ? strlen(separator) : 0;
+	gsize length = 0;
+	gint index = 0;
+
+	for(index = 0; strings[index]; index++) length += strlen(strings[index]);
+	if(index > 1) length += seplen * (index - 1);
+
+	gchar* joined = (gchar*)arena_alloc(ar,length + 1);
+	gchar* pos = joined;
+
+	for(index = 0; joined && strings[index]; index++) {
+		gsize strlength = strlen(strings[index]);
+
+		if(index > 0 && seplen) {
+			memcpy(pos,separator,seplen);
+			pos += seplen;
+		}
+		memcpy(pos,strings[index],strlength);
+		pos += strlength;
+	}
+
+	if(joined) *pos = '\0';
+	return joined;
+}
+
+/**
+* Print formatted string to arena. Works as g_strdup_printf().
+*
+* @param ar Arena to allocate from
+* @param format Format of the string
+*
+* @return Formatted string in arena
+*/
+gchar* arena_strdup_printf(arena* ar, const gchar* format, ...) {
+	va_list args, count;
+
+	va_start(args,format);
+	va_copy(count,args);
+	gint length = vsnprintf(NULL,0,format,count);
+	va_end(count);
+
+	gchar* string = length >= 0 ? (gchar*)arena_alloc(ar,length + 1) : NULL;
+	if(string) vsnprintf(string,length + 1,format,args);
+	va_end(args);
+
+	return string;
+}
+
+/**
+* Reset arena, all memory allocated from it is released at once. The
+* most recent block is kept for reuse and the others are free'd.
+*
+* @param ar Arena to reset
+*/
+void arena_reset(arena* ar) {
+	if(!ar || !ar->blocks) return;
+
+	arena_block* block = ar->blocks->next;
+	while(block) {
+		arena_block* next = block->next;
+		g_free(block);
+		block = next;
+	}
+
+	ar->blocks->next = NULL;
+	ar->blocks->used = 0;
+	ar->resets++;
+}
+
+/**
+* Free arena and all of its blocks.
+*
+* @param ar Arena to free
+*/
+void arena_free(arena* ar) {
+	if(!ar) return;
+
+	arena_block* block = ar->blocks;
+	while(block) {
+		arena_block* next = block->next;
+		g_free(block);
+		block = next;
+	}
+	g_free(ar);
+}
+
+/**
+* Get the arena for transient data of a test run. Data allocated from
+* it is released when the test is reset.
+*
+* @return Pointer to run arena (don't free this)
+*/
+arena* arena_run() {
+	if(!run_arena) run_arena = arena_new(ARENA_RUN_BLOCK_SIZE);
+	return run_arena;
+}
+
+/**
+* Get the arena for transient data of a single step. Data allocated
+* from it is released after the step is conducted.
+*
+* @return Pointer to step arena (don't free this)
+*/
+arena* arena_step() {
+	if(!step_arena) step_arena = arena_new(ARENA_STEP_BLOCK_SIZE);
+	return step_arena;
+}
+
+/**
+* Get the amount of heap allocations of the process. Allocations are
+* counted only when built with ALLOC_STATS.
+*
+* @param count Where to store the amount
+*
+* @return FALSE when allocations are not counted
+*/
+gboolean arena_heap_allocations(guint64* count) {
+#ifdef ALLOC_STATS
+	*count = __atomic_load_n(&heap_allocations,__ATOMIC_RELAXED);
+	return TRUE;
+#else
+	*count = 0;
+	return FALSE;
+#endif
+}
+
+/**
+* Start the statistics of a test run, heap allocations are counted
+* from here.
+*/
+void arena_start_run() {
+	arena_heap_allocations(&run_heap_start);
+}
+
+/**
+* Release all data of a test run from run and step arenas and clear
+* their statistics for the next run.
+*/
+void arena_release_run() {
+	arena* arenas[] = { run_arena, step_arena };
+	
+	for(gint index = 0; index < G_N_ELEMENTS(arenas); index++) {
+		if(!arenas[index]) continue;
+		arena_reset(arenas[index]);
+		arenas[index]->allocations = 0;
+		arenas[index]->bytes = 0;
+		arenas[index]->resets = 0;
+		arenas[index]->blocks_allocated = arenas[index]->blocks ? 1 : 0;
+	}
+}
+
+/**
+* Print the allocation statistics of run and step arenas. When built
+* with ALLOC_STATS the heap allocations of the run are printed too, the
+* blocks of the arenas are included in them.
+*/
+void arena_print_stats() {
+	guint64 allocations = 0, blocks = 0, heap = 0;
+
+	if(run_arena) {
+		g_print("Run arena: %" G_GUINT64_FORMAT " allocations (%" G_GUINT64_FORMAT " bytes) in %" G_GUINT64_FORMAT " blocks\n",
+			run_arena->allocations,run_arena->bytes,run_arena->blocks_allocated);
+		allocations += run_arena->allocations;
+		blocks += run_arena->blocks_allocated;
+	}
+	if(step_arena) {
+		g_print("Step arena: %" G_GUINT64_FORMAT " allocations (%" G_GUINT64_FORMAT " bytes) in %" G_GUINT64_FORMAT " blocks, reset %" G_GUINT64_FORMAT " times\n",
+			step_arena->allocations,step_arena->bytes,step_arena->blocks_allocated,step_arena->resets);
+		allocations += step_arena->allocations;
+		blocks += step_arena->blocks_allocated;
+	}
+	if(arena_heap_allocations(&heap)) g_print("Heap allocations: %" G_GUINT64_FORMAT " in run, %" G_GUINT64_FORMAT " of them arena blocks for %" G_GUINT64_FORMAT " arena allocations\n",
+		heap - run_heap_start,blocks,allocations);
+	g_print("\n");
+}
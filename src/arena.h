@@ -0,0 +1,27 @@
+#ifndef __ARENA_H_
+#define __ARENA_H_
+
+#include "definitions.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_RUN_BLOCK_SIZE 65536
+#define ARENA_STEP_BLOCK_SIZE 8192
+
+arena* arena_new(gsize block_size);
+gpointer arena_alloc(arena* ar, gsize size);
+gchar* arena_strdup(arena* ar, const gchar* string);
+gchar* arena_strndup(arena* ar, const gchar* string, gsize length);
+gchar* arena_strjoin(arena* ar, const gchar* separator, ...);
+gchar* arena_strjoinv(arena* ar, const gchar* separator, gchar** strings);
+gchar* arena_strdup_printf(arena* ar, const gchar* format, ...);
+void arena_reset(arena* ar);
+void arena_free(arena* ar);
+
+arena* arena_run();
+arena* arena_step();
+gboolean arena_heap_allocations(guint64* count);
+void arena_start_run();
+void arena_release_run();
+void arena_print_stats();
+
+#endif
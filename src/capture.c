@@ -0,0 +1,159 @@
+#include "capture.h"
+#include "jsonpath.h"
+#include "jsonbackend.h"
+#include "arena.h"
+
+static GHashTable* store = NULL; // Values captured in this run, name as key (allocated from run arena)
+
+/**
+* Make the name of a value captured from the reply of a file without a
+* declared name, e.g. "login:data.token".
+*
+* @param id Id of the file
+* @param expression Path of the value in the reply
+*
+* @return New charstring to be free'd with g_free()
+*/
+gchar* capture_make_name(const gchar* id, const gchar* expression) {
+	return g_strjoin(":",id,expression,NULL);
+}
+
+/**
+* Add a capture to list of captures unless a capture with the same name
+* is in the list already.
+*
+* @param captures List to add to
+* @param name Name of the value in capture store
+* @param expression Path of the value in the reply
+*
+* @return Added or existing capture or NULL if expression is not valid
+*/
+capture* capture_add(GSList** captures, const gchar* name, const gchar* expression) {
+	if(!captures || !name || !expression) return NULL;
+	
+	for(GSList* iter = *captures; iter; iter = g_slist_next(iter))
+		if(g_strcmp0(((capture*)iter->data)->name,name) == 0) return (capture*)iter->data;
+	
+	jsonpath* select = jsonpath_compile(expression);
+	if(!select) return NULL;
+	
+	capture* cap = g_new0(struct capture_t,1);
+	cap->name = g_strdup(name);
+	cap->select = select;
+	*captures = g_slist_append(*captures,cap);
+	return cap;
+}
+
+/**
+* Add a capture of a value needed from the reply of the testfile, named
+* with capture_make_name().
+*
+* @param tfile Testfile whose reply has the value
+* @param expression Path of the value in the reply
+*
+* @return Added or existing capture or NULL if expression is not valid
+*/
+capture* capture_add_to_file(testfile* tfile, const gchar* expression) {
+	if(!tfile || !expression) return NULL;
+	
+	gchar* name = capture_make_name(tfile->id,expression);
+	capture* cap = capture_add(&(tfile->captures),name,expression);
+	g_free(name);
+	return cap;
+}
+
+/**
+* Take the values of the captures of the testfile from its reply to the
+* capture store. Called once when the reply arrives or is restored. Missing
+* values are reported for declared captures only.
+*
+* @param tfile Testfile whose reply arrived
+*
+* @return Amount of values captured
+*/
+guint capture_take(testfile* tfile) {
+	if(!tfile || !tfile->recv) return 0;
+	
+	guint taken = 0;
+	
+	for(GSList* iter = tfile->captures; iter; iter = g_slist_next(iter)) {
+		capture* cap = (capture*)iter->data;
+		gchar* value = jsonbackend_get_string(cap->select,tfile->recv,arena_run());
+		
+		if(value) {
+			capture_set(cap->name,value);
+			taken++;
+		}
+		
+		// Missing values needed internally are reported where they are used
+		else if(cap->declared) g_print("Value \"%s\" (%s) was not found from reply of test id \"%s\"\n",
+			cap->name,cap->select->expression,tfile->id);
+#ifdef G_MESSAGES_DEBUG
+		else g_print("Value \"%s\" was not found from reply of test id \"%s\"\n",cap->name,tfile->id);
+#endif
+	}
+	return taken;
+}
+
+/**
+* Set a value in capture store. Name is copied to run arena, value must
+* be allocated from run arena and is stored as it is.
+*
+* @param name Name of the value
+* @param value Value to set, allocated from run arena
+*/
+void capture_set(const gchar* name, gchar* value) {
+	if(!name || !value) return;
+	if(!store) store = g_hash_table_new((GHashFunc)g_str_hash,(GEqualFunc)g_str_equal);
+	g_hash_table_replace(store,arena_strdup(arena_run(),name),value);
+}
+
+/**
+* Get a value from capture store.
+*
+* @param name Name of the value
+*
+* @return Value (don't free this, valid until capture_clear()) or NULL if not captured
+*/
+const gchar* capture_get(const gchar* name) {
+	if(!store || !name) return NULL;
+	return (const gchar*)g_hash_table_lookup(store,name);
+}
+
+/**
+* Get a value captured with capture_add_to_file() from capture store.
+*
+* @param id Id of the file whose reply had the value
+* @param expression Path of the value in the reply
+*
+* @return Value (don't free this, valid until capture_clear()) or NULL if not captured
+*/
+const gchar* capture_get_from_file(const gchar* id, const gchar* expression) {
+	if(!id || !expression) return NULL;
+	
+	gchar* name = capture_make_name(id,expression);
+	const gchar* value = capture_get(name);
+	g_free(name);
+	return value;
+}
+
+/**
+* Clear the values of the run from capture store, must be called before
+* the run arena is released.
+*/
+void capture_clear() {
+	if(store) g_hash_table_remove_all(store);
+}
+
+/**
+* Free a single capture_t.
+*
+* @param data Pointer to capture to free
+*/
+void free_capture(gpointer data) {
+	capture* cap = (capture*)data;
+	if(!cap) return;
+	g_free(cap->name);
+	free_jsonpath(cap->select);
+	g_free(cap);
+}
@@ -0,0 +1,18 @@
+#ifndef __CAPTURE_H_
+#define __CAPTURE_H_
+
+#include "definitions.h"
+
+gchar* capture_make_name(const gchar* id, const gchar* expression);
+capture* capture_add(GSList** captures, const gchar* name, const gchar* expression);
+capture* capture_add_to_file(testfile* tfile, const gchar* expression);
+guint capture_take(testfile* tfile);
+
+void capture_set(const gchar* name, gchar* value);
+const gchar* capture_get(const gchar* name);
+const gchar* capture_get_from_file(const gchar* id, const gchar* expression);
+void capture_clear();
+
+void free_capture(gpointer data);
+
+#endif
@@ -0,0 +1,308 @@
+#include "checkpoint.h"
+#include "jsonutils.h"
+#include "utils.h"
+#include "arena.h"
+#include <glib/gstdio.h>
+
+/**
+* Make path to checkpoint folder of the test or to a file within it
+* when name is given.
+*
+* @param testpath Base path of the test
+* @param name Name of the file in checkpoint folder, can be NULL
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* checkpoint_make_path(const gchar* testpath, const gchar* name) {
+	if(name) return g_strjoin("/",testpath,CHECKPOINTDIR,name,NULL);
+	return g_strjoin("/",testpath,CHECKPOINTDIR,NULL);
+}
+
+/**
+* Make path to the checkpoint file of a single step (file id).
+*
+* @param testpath Base path of the test
+* @param id File id of the step
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* checkpoint_make_step_path(const gchar* testpath, const gchar* id) {
+	gchar* name = g_strjoin(".",id,"json",NULL);
+	gchar* path = checkpoint_make_path(testpath,name);
+	g_free(name);
+	return path;
+}
+
+/**
+* Write the json built with builder to given file.
+*
+* @param builder Builder containing the json
+* @param path File to write to
+*
+* @return TRUE when file was written
+*/
+static gboolean checkpoint_write(JsonBuilder* builder, const gchar* path) {
+	GError *error = NULL;
+	JsonGenerator *generator = json_generator_new();
+	json_generator_set_root(generator, json_builder_get_root(builder));
+
+	gboolean rval = json_generator_to_file(generator,path,&error);
+
+	if(!rval && error) {
+		g_print("Cannot write checkpoint \"%s\". Reason: %s\n",path,error->message);
+		g_error_free(error);
+	}
+	g_object_unref(generator);
+	return rval;
+}
+
+/**
+* Add a single member-value pair from replace hash table to builder.
+* Called by g_hash_table_foreach() only.
+*/
+static void checkpoint_add_replaced(gpointer key, gpointer value, gpointer builder) {
+	json_builder_set_member_name((JsonBuilder*)builder,(gchar*)key);
+	json_builder_add_string_value((JsonBuilder*)builder,(gchar*)value);
+}
+
+/**
+* Save the state of a conducted step to the checkpoint of the test.
+* Stores the reply (recv) of the server as a string and the values
+* extracted for {parent} and {getinfo} members (replace hash table).
+*
+* @param testpath Base path of the test
+* @param tfile Testfile that was conducted
+* @param verified Result of the verification of the step
+*
+* @return TRUE when checkpoint was written
+*/
+gboolean checkpoint_save_step(const gchar* testpath, testfile* tfile, gboolean verified) {
+	if(!testpath || !tfile) return FALSE;
+
+	gchar* dir = checkpoint_make_path(testpath,NULL);
+	if(g_mkdir_with_parents(dir,0700) != 0) {
+		g_print("Cannot create checkpoint folder \"%s\"\n",dir);
+		g_free(dir);
+		return FALSE;
+	}
+	g_free(dir);
+
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+
+	json_builder_set_member_name(builder,"id");
+	json_builder_add_string_value(builder,tfile->id);
+
+	json_builder_set_member_name(builder,"verified");
+	json_builder_add_string_value(builder,verified ? "yes" : "no");
+
+	// Reply is stored as string, it is not necessarily valid json
+	json_builder_set_member_name(builder,"recv");
+	if(tfile->recv && tfile->recv->data) json_builder_add_string_value(builder,tfile->recv->data);
+	else json_builder_add_null_value(builder);
+
+	json_builder_set_member_name(builder,"replace");
+	json_builder_begin_object(builder);
+	g_hash_table_foreach(tfile->replace,(GHFunc)checkpoint_add_replaced,builder);
+	json_builder_end_object(builder);
+
+	json_builder_end_object(builder);
+
+	gchar* path = checkpoint_make_step_path(testpath,tfile->id);
+	gboolean rval = checkpoint_write(builder,path);
+
+	g_free(path);
+	g_object_unref(builder);
+	return rval;
+}
+
+/**
+* Restore the state of a step from the checkpoint of the test. Sets
+* the recv of the testfile to contain the stored reply and adds the
+* stored extracted values to replace hash table.
+*
+* @param testpath Base path of the test
+* @param tfile Testfile to restore
+*
+* @return TRUE when step was found from checkpoint and reply was restored
+*/
+gboolean checkpoint_restore_step(const gchar* testpath, testfile* tfile) {
+	if(!testpath || !tfile) return FALSE;
+
+	gboolean rval = FALSE;
+	gchar* path = checkpoint_make_step_path(testpath,tfile->id);
+
+	if(!g_file_test(path,G_FILE_TEST_IS_REGULAR)) {
+		g_free(path);
+		return FALSE;
+	}
+
+	JsonParser *parser = json_parser_new();
+
+	if(load_json_from_file(parser,path)) {
+		JsonReader *reader = json_reader_new(json_parser_get_root(parser));
+
+		gchar* recv = get_json_member_string(reader,"recv");
+		if(recv) {
+			free_jsonreply(tfile->recv);
+			tfile->recv = jsonreply_initialize();
+			tfile->recv->data = recv;
+			tfile->recv->length = strlen(recv);
+			rval = TRUE;
+		}
+
+		// Restore the extracted values
+		if(json_reader_read_member(reader,"replace")) {
+			gchar** members = json_reader_list_members(reader);
+			for(gint membidx = 0; members && members[membidx] != NULL; membidx++) {
+				
+				// Copied from the reader to run arena directly
+				if(json_reader_read_member(reader,members[membidx])) {
+					const gchar* value = json_reader_get_string_value(reader);
+					if(value) g_hash_table_replace(tfile->replace,
+						arena_strdup(arena_run(),members[membidx]),
+						arena_strdup(arena_run(),value));
+				}
+				json_reader_end_member(reader);
+			}
+			g_strfreev(members);
+		}
+		json_reader_end_member(reader);
+
+		g_object_unref(reader);
+	}
+
+	g_object_unref(parser);
+	g_free(path);
+	return rval;
+}
+
+/**
+* Check if the checkpoint contains a step with given id.
+*
+* @param testpath Base path of the test
+* @param id File id of the step
+*
+* @return TRUE when checkpoint for the step exists
+*/
+gboolean checkpoint_has_step(const gchar* testpath, const gchar* id) {
+	if(!testpath || !id) return FALSE;
+	gchar* path = checkpoint_make_step_path(testpath,id);
+	gboolean rval = g_file_test(path,G_FILE_TEST_IS_REGULAR);
+	g_free(path);
+	return rval;
+}
+
+/**
+* Save the state of the run to checkpoint. The state tells which
+* step failed first and whether the resources created during the
+* run still exist on the server, i.e. cleanup is pending.
+*
+* @param testpath Base path of the test
+* @param failed Id of the first failed step, can be NULL
+* @param pending TRUE when resources were left on the server
+*
+* @return TRUE when state was written
+*/
+gboolean checkpoint_save_state(const gchar* testpath, const gchar* failed, gboolean pending) {
+	if(!testpath) return FALSE;
+
+	gchar* dir = checkpoint_make_path(testpath,NULL);
+	g_mkdir_with_parents(dir,0700);
+	g_free(dir);
+
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+
+	json_builder_set_member_name(builder,"failed");
+	if(failed) json_builder_add_string_value(builder,failed);
+	else json_builder_add_null_value(builder);
+
+	json_builder_set_member_name(builder,"cleanup");
+	json_builder_add_string_value(builder,pending ? "pending" : "done");
+
+	json_builder_end_object(builder);
+
+	gchar* path = checkpoint_make_path(testpath,CHECKPOINTSTATE);
+	gboolean rval = checkpoint_write(builder,path);
+
+	g_free(path);
+	g_object_unref(builder);
+	return rval;
+}
+
+/**
+* Get a member of the run state stored in checkpoint.
+*
+* @param testpath Base path of the test
+* @param member Member to get
+*
+* @return Newly allocated value of the member or NULL if not set
+*/
+static gchar* checkpoint_get_state_member(const gchar* testpath, const gchar* member) {
+	gchar* value = NULL;
+	gchar* path = checkpoint_make_path(testpath,CHECKPOINTSTATE);
+
+	if(g_file_test(path,G_FILE_TEST_IS_REGULAR)) {
+		JsonParser *parser = json_parser_new();
+		if(load_json_from_file(parser,path)) {
+			JsonReader *reader = json_reader_new(json_parser_get_root(parser));
+			value = get_json_member_string(reader,member);
+			g_object_unref(reader);
+		}
+		g_object_unref(parser);
+	}
+	g_free(path);
+	return value;
+}
+
+/**
+* Get the id of the first failed step of the checkpointed run.
+*
+* @param testpath Base path of the test
+*
+* @return Newly allocated id (free with g_free()) or NULL if no step failed
+*/
+gchar* checkpoint_get_failed(const gchar* testpath) {
+	if(!testpath) return NULL;
+	return checkpoint_get_state_member(testpath,"failed");
+}
+
+/**
+* Check whether the checkpointed run left resources on the server.
+*
+* @param testpath Base path of the test
+*
+* @return TRUE when cleanup of the checkpointed run is pending
+*/
+gboolean checkpoint_cleanup_pending(const gchar* testpath) {
+	if(!testpath) return FALSE;
+	gchar* cleanup = checkpoint_get_state_member(testpath,"cleanup");
+	gboolean rval = g_strcmp0(cleanup,"pending") == 0;
+	g_free(cleanup);
+	return rval;
+}
+
+/**
+* Remove checkpoint of the test with all stored steps.
+*
+* @param testpath Base path of the test
+*/
+void checkpoint_clear(const gchar* testpath) {
+	if(!testpath) return;
+
+	gchar* dir = checkpoint_make_path(testpath,NULL);
+	GDir* folder = g_dir_open(dir,0,NULL);
+
+	if(folder) {
+		const gchar* name = NULL;
+		while((name = g_dir_read_name(folder))) {
+			gchar* path = g_strjoin("/",dir,name,NULL);
+			g_remove(path);
+			g_free(path);
+		}
+		g_dir_close(folder);
+		g_rmdir(dir);
+	}
+	g_free(dir);
+}
@@ -0,0 +1,19 @@
+#ifndef __CHECKPOINT_H_
+#define __CHECKPOINT_H_
+
+#include "definitions.h"
+
+#define CHECKPOINTDIR ".checkpoint"
+#define CHECKPOINTSTATE "state.json"
+
+gboolean checkpoint_save_step(const gchar* testpath, testfile* tfile, gboolean verified);
+gboolean checkpoint_restore_step(const gchar* testpath, testfile* tfile);
+gboolean checkpoint_has_step(const gchar* testpath, const gchar* id);
+
+gboolean checkpoint_save_state(const gchar* testpath, const gchar* failed, gboolean pending);
+gchar* checkpoint_get_failed(const gchar* testpath);
+gboolean checkpoint_cleanup_pending(const gchar* testpath);
+
+void checkpoint_clear(const gchar* testpath);
+
+#endif
@@ -2,7 +2,13 @@
 #include <string.h>
 #include <iconv.h>
 #include <errno.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include "connectionutils.h"
+#include "utils.h"
+#include "pacing.h"
+#include "httpcache.h"
+#include "httpengine.h"
 
 
 CURL *curl = NULL;
@@ -11,9 +17,96 @@ gchar* token = NULL;
 const gchar* server_encoding = NULL;
 const gchar* local_encoding = NULL;
 
+gchar* accept_encoding = NULL;
+
+static GHashTable* retry_policies = NULL; // Retry policies of the test, method as key
+static GHashTable* get_latencies = NULL; // Latencies of recent GET requests for hedging, path as key
+static gchar* latency_key = NULL; // Path of the following requests in get_latencies
+
+static timeouts request_timeouts = { TIMEOUT_CONNECT_MS, TIMEOUT_TOTAL_MS, 
+	TIMEOUT_LOW_SPEED_BYTES, TIMEOUT_LOW_SPEED_S }; // Timeouts of the following requests
+static gint64 deadline = 0; // Monotonic time when all requests are cancelled, 0 if not set
+
+static CURLSH* share = NULL; // DNS, TLS session and connection caches shared by all handles
+static GMutex share_locks[CURL_LOCK_DATA_LAST]; // Lock for each type of shared data
+static guint64 transfers = 0; // Transfers done in this run
+static guint64 connects = 0; // New connections opened in this run
+static guint64 handshakes = 0; // TLS handshakes done in this run
+
+static in_flight_work pending_work = NULL; // Called once while the next request is in flight
+static gpointer pending_work_data = NULL; // Data for pending_work
+static GHashTable* warm_origins = NULL; // Origins (scheme://host:port) connected to in this run
+static GSList* preconnects = NULL; // Connections opened ahead of the requests, http_transfer_t
+
 /**
-* Initialize http "engine". Sets up CURL with curl_global_init()
-* and curl_easy_init(). Also resets token to NULL and sets up
+* Build the list of content encodings curl is able to decode. The encodings
+* are listed in order of preference. Returned charstring must be free'd with
+* g_free().
+*
+* @return Encodings for Accept-Encoding header or NULL if curl cannot decode any
+*/
+static gchar* http_supported_encodings() {
+	curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+	GString* encodings = g_string_new(NULL);
+	
+#ifdef CURL_VERSION_ZSTD
+	if(info->features & CURL_VERSION_ZSTD) g_string_append(encodings,"zstd, ");
+#endif
+#ifdef CURL_VERSION_BROTLI
+	if(info->features & CURL_VERSION_BROTLI) g_string_append(encodings,"br, ");
+#endif
+	if(info->features & CURL_VERSION_LIBZ) g_string_append(encodings,"gzip, deflate, ");
+	
+	if(encodings->len == 0) {
+		g_string_free(encodings,TRUE);
+		return NULL;
+	}
+	
+	// Remove trailing separator
+	g_string_truncate(encodings,encodings->len - 2);
+	return g_string_free(encodings,FALSE);
+}
+
+/**
+* Lock shared data of curl, called by curl only.
+*/
+static void http_share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, gpointer userp) {
+	g_mutex_lock(&share_locks[data]);
+}
+
+/**
+* Unlock shared data of curl, called by curl only.
+*/
+static void http_share_unlock(CURL* handle, curl_lock_data data, gpointer userp) {
+	g_mutex_unlock(&share_locks[data]);
+}
+
+/**
+* Create the share of curl handles once for the process. Resolved
+* addresses, TLS sessions and open connections are kept between runs
+* and used by all handles, including duplicates of hedged requests.
+*/
+static void http_share_init() {
+	if(share) return;
+	
+	curl_global_init(CURL_GLOBAL_ALL);
+	
+	share = curl_share_init();
+	if(!share) return;
+	
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, http_share_lock);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, http_share_unlock);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+/**
+* Initialize http "engine". Sets up CURL with curl_global_init() and the
+* caches shared by handles once for the process and curl_easy_init() for
+* the run. Also resets token to NULL and sets up
 * given server enconding (ENCODING IS NOT YET UTILIZED AS IT 
 * BREAKS UP FOR SOME REASON).
 *
@@ -34,34 +127,276 @@ void http_init(gchar* server_enc) {
 	server_encoding = NULL;
 	local_encoding = NULL;
 	
-	curl_global_init(CURL_GLOBAL_ALL);
+	http_share_init();
 	if(!curl) curl = curl_easy_init();
+	if(curl && share) curl_easy_setopt(curl, CURLOPT_SHARE, share);
+	transfers = connects = handshakes = 0;
+	
+	// Negotiate compression, curl decodes the reply before passing it to callback
+	g_free(accept_encoding);
+	accept_encoding = http_supported_encodings();
+#ifdef G_MESSAGES_DEBUG
+	g_print("Accepted encodings: %s\n",accept_encoding ? accept_encoding : "identity");
+#endif
 }
 
 /**
-* Shutdown http "engine" by calling curl_easy_cleanup() and
-* curl_global_cleanup(). Also frees token with g_free().
+* Shutdown http "engine" by calling curl_easy_cleanup(). Caches shared
+* by the handles are kept for the next run. Also frees token with g_free().
 * Should include secure memset for token.
 */
 void http_close() {
 	g_free(token); // TODO set up secure memset
+	token = NULL;
+	g_free(accept_encoding);
+	accept_encoding = NULL;
+	
+	retry_policies = NULL;
+	if(get_latencies) g_hash_table_destroy(get_latencies);
+	get_latencies = NULL;
+	g_free(latency_key);
+	latency_key = NULL;
+	deadline = 0;
+	
+	pending_work = NULL;
+	pending_work_data = NULL;
+	while(preconnects) {
+		http_transfer* transfer = (http_transfer*)preconnects->data;
+		CURL* handle = (CURL*)transfer->handle;
+		preconnects = g_slist_delete_link(preconnects,preconnects);
+		httpengine_remove(transfer);
+		curl_easy_cleanup(handle);
+	}
+	if(warm_origins) g_hash_table_destroy(warm_origins);
+	warm_origins = NULL;
 	
 	if(curl) curl_easy_cleanup(curl);
 	curl = NULL;
+}
+
+/**
+* Release the caches shared by curl handles and cleanup curl with
+* curl_global_cleanup(). Called at exit of the process.
+*/
+void http_shutdown() {
+	http_close();
+	httpengine_close();
+	if(share) curl_share_cleanup(share);
+	share = NULL;
 	curl_global_cleanup();
 }
 
+/**
+* Print the amount of transfers of the run and the new connections and
+* TLS handshakes they needed.
+*/
+void http_print_stats() {
+	g_print("Connections: %" G_GUINT64_FORMAT " transfers, %" G_GUINT64_FORMAT " new connections, %" G_GUINT64_FORMAT " TLS handshakes\n",
+		transfers,connects,handshakes);
+}
+
 /**
 * Set authentication token to be used in future connections.
 * Token is duplicated with g_strjoin() to include "Authorization: "
-* text at the beginning.
+* text at the beginning. Previously set token is free'd.
 *
 * @param new_token Token to set up.
 */
 void set_token(gchar* new_token) {
+	g_free(token);
 	token = g_strjoin(" ","Authorization: ", new_token, NULL);
 }
 
+/**
+* Set retry policies to use in future connections. Policies are
+* owned by the test and are not copied.
+*
+* @param policies Hash table of retry_policy_t structures, method as key, can be NULL
+*/
+void http_set_retry_policies(GHashTable* policies) {
+	retry_policies = policies;
+}
+
+/**
+* Set timeouts to use in future connections.
+*
+* @param tout Timeouts to use, NULL restores the defaults
+*/
+void http_set_timeouts(const timeouts* tout) {
+	if(tout) request_timeouts = *tout;
+	else {
+		request_timeouts.connect_ms = TIMEOUT_CONNECT_MS;
+		request_timeouts.total_ms = TIMEOUT_TOTAL_MS;
+		request_timeouts.low_speed_bytes = TIMEOUT_LOW_SPEED_BYTES;
+		request_timeouts.low_speed_s = TIMEOUT_LOW_SPEED_S;
+	}
+}
+
+/**
+* Set the path the following requests are made to, e.g. path of the file
+* in preferences before the values are set. Latencies of GET requests
+* are collected for each path, a hedged GET uses the latencies of its
+* own path.
+*
+* @param path Path of the following requests, NULL when not known
+*/
+void http_set_latency_key(const gchar* path) {
+	g_free(latency_key);
+	latency_key = g_strdup(path);
+}
+
+/**
+* Set deadline of the run. Requests in progress when the deadline is
+* reached are cancelled and no new requests are sent after it.
+*
+* @param time Monotonic time (g_get_monotonic_time()) of the deadline, 0 removes deadline
+*/
+void http_set_deadline(gint64 time) {
+	deadline = time;
+}
+
+/**
+* Set work to do while the next request is in flight, e.g. preparing the
+* following step. Work is called once after the request has been written
+* to the connection, before waiting for the reply. Work that was not done
+* is replaced.
+*
+* @param work Work to do, NULL removes the work
+* @param userp Data for work
+*/
+void http_set_in_flight_work(in_flight_work work, gpointer userp) {
+	pending_work = work;
+	pending_work_data = userp;
+}
+
+/**
+* Do the work set with http_set_in_flight_work() once. Engine is run
+* without waiting first so that curl starts the submitted request.
+*/
+static void http_do_in_flight_work() {
+	if(!pending_work) return;
+	
+	in_flight_work work = pending_work;
+	pending_work = NULL;
+	
+	httpengine_run(0);
+	work(pending_work_data);
+}
+
+/**
+* Get the origin of url as scheme://host:port. Returned charstring must be
+* free'd with g_free().
+*
+* @param url Url to get origin of
+*
+* @return Origin or NULL if url cannot be parsed
+*/
+static gchar* http_get_origin(const gchar* url) {
+	CURLU* parsed = curl_url();
+	gchar *scheme = NULL, *host = NULL, *port = NULL, *origin = NULL;
+	
+	if(parsed && curl_url_set(parsed, CURLUPART_URL, url, 0) == CURLUE_OK &&
+		curl_url_get(parsed, CURLUPART_SCHEME, &scheme, 0) == CURLUE_OK &&
+		curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK &&
+		curl_url_get(parsed, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK)
+		origin = g_strdup_printf("%s://%s:%s",scheme,host,port);
+	
+	curl_free(scheme);
+	curl_free(host);
+	curl_free(port);
+	curl_url_cleanup(parsed);
+	return origin;
+}
+
+/**
+* Add origin of url to the origins connected to in this run.
+*
+* @param url Url of a request
+*
+* @return TRUE when origin was not connected to before
+*/
+static gboolean http_add_warm_origin(const gchar* url) {
+	gchar* origin = http_get_origin(url);
+	if(!origin) return FALSE;
+	
+	if(!warm_origins) warm_origins = g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL);
+	if(g_hash_table_contains(warm_origins,origin)) {
+		g_free(origin);
+		return FALSE;
+	}
+	g_hash_table_add(warm_origins,origin);
+	return TRUE;
+}
+
+/**
+* Release a connection opened by http_preconnect() when it has been
+* opened. Called by http engine only.
+*
+* @param transfer Transfer of the connection
+* @param userp Not used
+*/
+static void http_preconnect_done(http_transfer* transfer, gpointer userp) {
+	CURL* handle = (CURL*)transfer->handle;
+#ifdef G_MESSAGES_DEBUG
+	gchar* url = NULL;
+	curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url);
+	g_print("Preconnect to %s: %s\n",url,curl_easy_strerror((CURLcode)transfer->result));
+#endif
+	preconnects = g_slist_remove(preconnects,transfer);
+	httpengine_remove(transfer);
+	curl_easy_cleanup(handle);
+}
+
+/**
+* Resolve the host of url and open a connection to it in the background
+* when no request of the run has been made to its origin. Nothing is sent,
+* the resolved address and TLS session are shared with the handle of the
+* requests so the first request to the host does not wait for DNS and a
+* full handshake. Connection progresses while requests are waited for.
+*
+* @param url Url whose host is connected to
+*
+* @return TRUE when a connection was started
+*/
+gboolean http_preconnect(const gchar* url) {
+	if(!url || !curl || !http_add_warm_origin(url)) return FALSE;
+	
+	CURL* handle = curl_easy_init();
+	if(!handle) return FALSE;
+	
+	if(share) curl_easy_setopt(handle, CURLOPT_SHARE, share);
+	curl_easy_setopt(handle, CURLOPT_URL, url);
+	curl_easy_setopt(handle, CURLOPT_CONNECT_ONLY, 1L);
+	curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, (long)request_timeouts.connect_ms);
+	
+	http_transfer* transfer = httpengine_submit(handle,http_preconnect_done,NULL);
+	if(!transfer) {
+		curl_easy_cleanup(handle);
+		return FALSE;
+	}
+	preconnects = g_slist_prepend(preconnects,transfer);
+	return TRUE;
+}
+
+/**
+* Check if the deadline of the run has been reached.
+*
+* @return TRUE when deadline is set and reached
+*/
+gboolean http_deadline_passed() {
+	return deadline > 0 && g_get_monotonic_time() >= deadline;
+}
+
+/**
+* Progress callback for cancelling requests at deadline. Called by curl only.
+*
+* @return Non-zero to abort the transfer
+*/
+static gint http_progress_callback(gpointer clientp, curl_off_t dltotal, curl_off_t dlnow,
+	curl_off_t ultotal, curl_off_t ulnow) {
+	return http_deadline_passed() ? 1 : 0;
+}
+
 /**
 * Convert string to charset of the REST API. 
 * First converts locale to UTF-8 and then to server encoding if
@@ -80,10 +415,13 @@ gchar* convert_to_rest_api(gchar* data, gint length, gsize* newlength) {
 	
 	// First to UTF8
 	gchar* strutf8 = g_locale_to_utf8(data,	length, &in, &utf8len, NULL);
-	g_print("AS UTF8 (%ld): %s\n",utf8len,strutf8);
+	g_print("AS UTF8 (%" G_GSIZE_FORMAT "): %s\n",utf8len,strutf8);
 	
 	// Then to server
-	if(g_strcmp0(server_encoding,"UTF-8") == 0) return strutf8;
+	if(g_strcmp0(server_encoding,"UTF-8") == 0) {
+		*newlength = utf8len;
+		return strutf8;
+	}
 
 	gchar* converted = g_convert(strutf8, utf8len, server_encoding, "UTF-8", &in, newlength, NULL);
 	g_free(strutf8);
@@ -114,15 +452,108 @@ gchar* convert_from_rest_api(gchar* data, gint length, gsize* newlength) {
 		g_free(strutf8);
 	}
 	else converted = g_locale_from_utf8(data, length, &in, newlength, NULL);
-	g_print("AS LOCAL (%ld): %s\n",*newlength,converted);
+	g_print("AS LOCAL (%" G_GSIZE_FORMAT "): %s\n",*newlength,converted);
 
 	return converted;
 }
 
+/**
+* Write all of data to file.
+*
+* @param fd File to write to
+* @param data Data to write
+* @param length Length of data
+*
+* @return TRUE when all data was written
+*/
+static gboolean http_write_all(gint fd, const gchar* data, gsize length) {
+	while(length > 0) {
+		gssize written = write(fd, data, length);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			g_print("Cannot write reply to temporary file: %s\n",g_strerror(errno));
+			return FALSE;
+		}
+		data += written;
+		length -= written;
+	}
+	return TRUE;
+}
+
+/**
+* Move the data of a reply that grows over HTTP_REPLY_SPILL_SIZE from heap
+* to a temporary file. The file is removed at once, it is freed when it is
+* closed and unmapped. The rest of the reply is written to the file.
+*
+* @param reply Reply to spill
+*
+* @return TRUE when reply was spilled, otherwise data stays in heap
+*/
+static gboolean http_spill_reply(jsonreply* reply) {
+	GError *error = NULL;
+	gchar* name = NULL;
+	gint fd = g_file_open_tmp("testfw-reply-XXXXXX", &name, &error);
+	
+	if(fd < 0) {
+		g_print("Cannot create temporary file for reply: %s\n",error ? error->message : "unknown");
+		if(error) g_error_free(error);
+		return FALSE;
+	}
+	g_unlink(name);
+	g_free(name);
+	
+	if(!http_write_all(fd, reply->data, reply->length)) {
+		close(fd);
+		return FALSE;
+	}
+	
+	g_free(reply->data);
+	reply->data = NULL;
+	reply->size = 0;
+	reply->spill_fd = fd;
+	return TRUE;
+}
+
+/**
+* Map the temporary file of a spilled reply as the data of the reply.
+* Data is NUL terminated as data in heap. Replies that are not spilled
+* are not changed.
+*
+* @param reply Reply to map
+*/
+static void http_map_reply(jsonreply* reply) {
+	if(!reply || reply->spill_fd < 0) return;
+	
+	GError *error = NULL;
+	
+	if(http_write_all(reply->spill_fd, "", 1))
+		reply->mapped = g_mapped_file_new_from_fd(reply->spill_fd, FALSE, &error);
+	
+	// Mapping stays valid after closing
+	close(reply->spill_fd);
+	reply->spill_fd = -1;
+	
+	if(reply->mapped) {
+		reply->data = g_mapped_file_get_contents(reply->mapped);
+		reply->size = reply->length + 1;
+	}
+	else {
+		g_print("Cannot map reply of %" G_GSIZE_FORMAT " bytes: %s\n",reply->length,error ? error->message : "write failed");
+		reply->length = 0;
+	}
+	if(error) g_error_free(error);
+}
+
 /**
 * A callback for storing curl response. Called by curl only.
 * This was inspired by the examples at http://curl.haxx.se/libcurl/c/example.html
 *
+* Compressed replies are decoded by curl chunk by chunk before this is
+* called, so only the decoded data is stored. The buffer is grown by
+* doubling its size to avoid reallocating it for every chunk. Replies
+* growing over HTTP_REPLY_SPILL_SIZE are written to a temporary file
+* instead and the file is mapped when the reply is complete.
+*
 * @param contents
 * @param nmemb
 * @param userp
@@ -133,13 +564,26 @@ static gsize http_get_json_reply_callback(gchar* contents, gsize size, gsize nme
 {
 	gsize realsize = size * nmemb;
 	jsonreply *reply = (jsonreply*)userp;
+	
+	// Large reply, written to file
+	if(reply->spill_fd >= 0 || (reply->length + realsize + 1 > HTTP_REPLY_SPILL_SIZE && http_spill_reply(reply))) {
+		if(!http_write_all(reply->spill_fd, contents, realsize)) return 0;
+		reply->length += realsize;
+		return realsize;
+	}
  
- 	if(reply->data) reply->data = (gchar*)g_try_realloc(reply->data, reply->length + realsize + 1);
- 	else reply->data = (gchar*)g_try_malloc0(reply->length + realsize + 1);
+ 	if(reply->length + realsize + 1 > reply->size) {
+ 		gsize newsize = reply->size ? reply->size : HTTP_REPLY_INITIAL_SIZE;
+ 		while(newsize < reply->length + realsize + 1) newsize *= 2;
+ 		
+ 		gchar* data = (gchar*)g_try_realloc(reply->data, newsize);
 	
-	if(reply->data == NULL) {
-		g_error("not enough memory (realloc returned NULL)\n");
-		return 0;
+		if(data == NULL) {
+			g_error("not enough memory (realloc returned NULL)\n");
+			return 0;
+		}
+		reply->data = data;
+		reply->size = newsize;
 	}
  
 	memcpy(&(reply->data[reply->length]), contents, realsize);
@@ -149,112 +593,745 @@ static gsize http_get_json_reply_callback(gchar* contents, gsize size, gsize nme
 	return realsize;
 }
 
+/**
+* Callback for curl to store caching headers of the reply: ETag,
+* Last-Modified and Cache-Control. Headers of earlier responses
+* (redirects, 100 Continue) are discarded when a status line arrives.
+*
+* @param contents Single header line, not NUL terminated
+* @param size Size of a member
+* @param nmemb Amount of members
+* @param userp jsonreply_t to store the headers to
+*
+* @return Amount of data handled
+*/
+static gsize http_get_header_callback(gchar* contents, gsize size, gsize nmemb, gpointer userp) {
+	gsize realsize = size * nmemb;
+	jsonreply *reply = (jsonreply*)userp;
+	cache_info* info = &(reply->cache);
+	
+	if(realsize >= 5 && g_ascii_strncasecmp(contents,"HTTP/",5) == 0) {
+		g_free(info->etag);
+		g_free(info->last_modified);
+		memset(info,0,sizeof(cache_info));
+		return realsize;
+	}
+	
+	const gchar* colon = memchr(contents,':',realsize);
+	if(!colon) return realsize;
+	
+	gchar* name = g_strndup(contents,colon - contents);
+	gchar* value = g_strstrip(g_strndup(colon + 1,realsize - (colon + 1 - contents)));
+	
+	if(g_ascii_strcasecmp(name,"ETag") == 0) {
+		g_free(info->etag);
+		info->etag = g_strdup(value);
+	}
+	else if(g_ascii_strcasecmp(name,"Last-Modified") == 0) {
+		g_free(info->last_modified);
+		info->last_modified = g_strdup(value);
+	}
+	else if(g_ascii_strcasecmp(name,"Cache-Control") == 0) httpcache_parse_cache_control(info,value);
+	
+	g_free(name);
+	g_free(value);
+	return realsize;
+}
+
+/**
+* Callback for curl to read the next part of the body to upload.
+*
+* @param buffer Where to copy the data
+* @param size Size of a member
+* @param nitems Amount of members buffer can hold
+* @param userp upload_t to read from
+*
+* @return Amount of data copied, 0 at the end of the data
+*/
+static gsize http_read_upload_callback(gchar* buffer, gsize size, gsize nitems, gpointer userp) {
+	upload* source = (upload*)userp;
+	if(!source) return CURL_READFUNC_ABORT;
+	
+	gsize amount = MIN(size * nitems, source->length - source->offset);
+	
+	memcpy(buffer, &(source->data[source->offset]), amount);
+	source->offset += amount;
+	return amount;
+}
+
+/**
+* Callback for curl to rewind the body, e.g. when a request is sent again
+* after redirect or authentication.
+*
+* @param userp upload_t to rewind
+* @param offset Position to move to
+* @param origin Where offset is from, only SEEK_SET is used by curl
+*
+* @return CURL_SEEKFUNC_OK or CURL_SEEKFUNC_CANTSEEK if position is not valid
+*/
+static gint http_seek_upload_callback(gpointer userp, curl_off_t offset, gint origin) {
+	upload* source = (upload*)userp;
+	
+	if(!source || origin != SEEK_SET || offset < 0 || (gsize)offset > source->length) return CURL_SEEKFUNC_CANTSEEK;
+	source->offset = (gsize)offset;
+	return CURL_SEEKFUNC_OK;
+}
+
+static void free_latency_window(gpointer data) {
+	latency_window* window = (latency_window*)data;
+	if(!window) return;
+	g_array_free(window->samples,TRUE);
+	g_free(window);
+}
+
+/**
+* Store latency of a successful GET request to the path set with
+* http_set_latency_key(). Only the HEDGE_SAMPLES most recent latencies
+* of each path are kept, oldest is replaced first.
+*
+* @param latency Latency of the request in microseconds
+*/
+static void http_add_latency(gint64 latency) {
+	if(!latency_key) return;
+	if(!get_latencies) get_latencies = g_hash_table_new_full(g_str_hash,g_str_equal,g_free,free_latency_window);
+	
+	latency_window* window = (latency_window*)g_hash_table_lookup(get_latencies,latency_key);
+	if(!window) {
+		window = g_new0(struct latency_window_t,1);
+		window->samples = g_array_sized_new(FALSE,FALSE,sizeof(gint64),HEDGE_SAMPLES);
+		g_hash_table_insert(get_latencies,g_strdup(latency_key),window);
+	}
+	
+	if(window->samples->len < HEDGE_SAMPLES) g_array_append_val(window->samples,latency);
+	else g_array_index(window->samples,gint64,window->next) = latency;
+	
+	window->next = (window->next + 1) % HEDGE_SAMPLES;
+}
+
+static gint http_compare_latency(gconstpointer a, gconstpointer b) {
+	gint64 first = *(const gint64*)a, second = *(const gint64*)b;
+	return first < second ? -1 : (first > second ? 1 : 0);
+}
+
+/**
+* Get delay after which a duplicate GET is sent. The delay is p95 of the
+* recent GET latencies of the same path when at least HEDGE_MIN_SAMPLES
+* were collected, otherwise the hedge delay of the policy.
+*
+* @param policy Retry policy of GET
+*
+* @return Delay in microseconds
+*/
+static gint64 http_hedge_delay(retry_policy* policy) {
+	latency_window* window = get_latencies && latency_key ? 
+		(latency_window*)g_hash_table_lookup(get_latencies,latency_key) : NULL;
+	
+	if(!window || window->samples->len < HEDGE_MIN_SAMPLES) return (gint64)policy->hedge_ms * 1000;
+	
+	GArray* sorted = g_array_sized_new(FALSE,FALSE,sizeof(gint64),window->samples->len);
+	g_array_append_vals(sorted,window->samples->data,window->samples->len);
+	g_array_sort(sorted,http_compare_latency);
+	
+	guint index = (guint)((sorted->len * 95 + 99) / 100) - 1;
+	gint64 delay = g_array_index(sorted,gint64,index);
+	
+	g_array_free(sorted,TRUE);
+	return delay;
+}
+
+/**
+* Get delay before next attempt. Exponential backoff with full jitter:
+* random delay between 0 and backoff_ms * 2^(number-1) limited to
+* max_backoff_ms.
+*
+* @param policy Retry policy of the method
+* @param number Number of the attempt that failed
+*
+* @return Delay in milliseconds
+*/
+static guint http_backoff_delay(retry_policy* policy, guint number) {
+	guint64 limit = policy->backoff_ms;
+	
+	for(guint exp = 1; exp < number && limit < policy->max_backoff_ms; exp++) limit *= 2;
+	if(limit > policy->max_backoff_ms) limit = policy->max_backoff_ms;
+	
+	return limit > 0 ? (guint)g_random_int_range(0,(gint32)limit + 1) : 0;
+}
+
+/**
+* Check if the attempt failed in a way that might succeed when retried:
+* connection or transfer failed or server was temporarily unable to
+* handle the request (408, 429, 500, 502, 503 and 504).
+*
+* @param try Attempt to check
+*
+* @return TRUE when request can be retried
+*/
+static gboolean http_should_retry(attempt* try) {
+	if(try->outcome == OUTCOME_DEADLINE || try->outcome == OUTCOME_CANCELLED) return FALSE;
+	
+	switch(try->error) {
+		case CURLE_OK:
+			break;
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_PARTIAL_FILE:
+		case CURLE_SSL_CONNECT_ERROR:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+	
+	switch(try->status) {
+		case 408:
+		case 429:
+		case 500:
+		case 502:
+		case 503:
+		case 504:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/**
+* Get outcome of a finished transfer. Curl reports all timeouts with
+* the same code: timeout before connection was established is connect
+* timeout and timeout before the time allowed for the request is low
+* speed timeout.
+*
+* @param handle Curl handle of the transfer
+* @param res Result of the transfer
+* @param latency Duration of the transfer
+*
+* @return Outcome of the transfer
+*/
+static outcome http_get_outcome(CURL* handle, CURLcode res, gint64 latency) {
+	curl_off_t connected = 0;
+	
+	switch(res) {
+		case CURLE_OK:
+			return OUTCOME_OK;
+		case CURLE_ABORTED_BY_CALLBACK:
+			return OUTCOME_DEADLINE;
+		case CURLE_OPERATION_TIMEDOUT:
+			curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connected);
+			if(connected == 0) return OUTCOME_CONNECT_TIMEOUT;
+			if(request_timeouts.total_ms > 0 && 
+				latency >= (gint64)request_timeouts.total_ms * 1000) return OUTCOME_TIMEOUT;
+			return OUTCOME_LOW_SPEED;
+		default:
+			return OUTCOME_FAILED;
+	}
+}
+
+/**
+* Create attempt_t for a finished transfer and fill in status, outcome,
+* amount of data received and latency.
+*
+* @param handle Curl handle of the transfer
+* @param res Result of the transfer
+* @param start Start time of the transfer (g_get_monotonic_time())
+* @param number Number of the attempt
+* @param hedged TRUE when transfer was a hedged duplicate
+*
+* @return Pointer to newly allocated attempt_t, free with g_free()
+*/
+static attempt* http_finish_attempt(CURL* handle, CURLcode res, gint64 start, guint number, gboolean hedged) {
+	attempt* try = g_new0(struct attempt_t,1);
+	try->number = number;
+	try->hedged = hedged;
+	try->error = res;
+	try->latency_us = g_get_monotonic_time() - start;
+	try->outcome = http_get_outcome(handle,res,try->latency_us);
+	
+	long status = 0;
+	if(curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status) == CURLE_OK) try->status = status;
+	
+	// Amount of body data received before decoding
+	curl_off_t wire = 0;
+	if(curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &wire) == CURLE_OK)
+		try->wire_length = (gsize)wire;
+	
+	// Connections opened for the transfer, reused ones are not counted
+	long opened = 0;
+	curl_off_t appconnect = 0;
+	transfers++;
+	if(curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &opened) == CURLE_OK && opened > 0) {
+		connects += opened;
+		if(curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &appconnect) == CURLE_OK && appconnect > 0)
+			handshakes++;
+	}
+	
+	// Cancelled hedges are not failures
+	if(res != CURLE_OK && res != CURLE_ABORTED_BY_CALLBACK) g_print("curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+	
+	return try;
+}
+
+/**
+* Send the request set up in curl handle and store reply to given jsonreply.
+* Waits for pacing of the url before sending, time waited is not included
+* in the latency. Request is sent with the http engine and this waits until
+* it has finished.
+*
+* @param url URL of the request
+* @param reply Where to store the reply
+* @param number Number of the attempt
+*
+* @return Newly allocated attempt_t describing the attempt
+*/
+static attempt* http_perform(const gchar* url, jsonreply* reply, guint number) {
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, reply);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, reply);
+	
+	gint64 queued = pacing_acquire(url);
+	
+	gint64 start = g_get_monotonic_time();
+	CURLcode res = CURLE_FAILED_INIT;
+	
+	// Engine drives the transfer, other submitted transfers progress meanwhile
+	http_transfer* transfer = httpengine_submit(curl,NULL,NULL);
+	if(transfer) {
+		http_do_in_flight_work();
+		httpengine_wait(transfer,0);
+		res = (CURLcode)transfer->result;
+		httpengine_remove(transfer);
+	}
+	else res = curl_easy_perform(curl);
+	
+	pacing_release(url);
+	
+	attempt* try = http_finish_attempt(curl,res,start,number,FALSE);
+	try->queued_us = queued;
+	return try;
+}
+
+/**
+* Send the request set up in curl handle and if there is no reply within
+* delay, send a duplicate request. Reply of the request that finishes
+* first successfully is used and the other request is cancelled. Both
+* attempts are added to tries. Duplicate is sent only when pacing of the
+* url allows it.
+*
+* @param url URL of the request
+* @param reply Where to store the reply, replaced with the reply of duplicate if it was used
+* @param number Number of the attempt
+* @param delay Delay before duplicate in microseconds
+* @param tries List of attempts to append to
+*
+* @return Attempt whose reply was used
+*/
+static attempt* http_perform_hedged(const gchar* url, jsonreply** reply, guint number, gint64 delay, GSList** tries) {
+	CURL* duplicate = NULL;
+	jsonreply* hedgereply = NULL;
+	http_transfer *first = NULL, *second = NULL;
+	attempt *primary = NULL, *hedge = NULL, *used = NULL;
+	gint64 pacewait = 0;
+	
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, *reply);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, *reply);
+	
+	gint64 queued = pacing_acquire(url);
+	gint64 start = g_get_monotonic_time(), hedgestart = 0;
+	
+	first = httpengine_submit(curl,NULL,NULL);
+	if(!first) {
+		primary = http_finish_attempt(curl,CURLE_FAILED_INIT,start,number,FALSE);
+		used = primary;
+	}
+	else http_do_in_flight_work();
+	
+	while(!used) {
+		if(first->finished && !primary) 
+			primary = http_finish_attempt(curl,(CURLcode)first->result,start,number,FALSE);
+		if(second && second->finished && !hedge) 
+			hedge = http_finish_attempt(duplicate,(CURLcode)second->result,hedgestart,number,TRUE);
+		
+		// First successful one is used, if both failed the original is used
+		if(primary && primary->error == CURLE_OK) used = primary;
+		else if(hedge && hedge->error == CURLE_OK) used = hedge;
+		else if(primary && (!duplicate || hedge)) used = primary;
+		if(used) break;
+		
+		gint64 now = g_get_monotonic_time();
+		
+		// Too slow, send duplicate with same options but own reply
+		if(!duplicate && !primary && now - start >= delay) {
+			
+			// Pacing does not allow another request yet
+			if(!pacing_try_acquire(url,&pacewait)) {
+				httpengine_run((gint)MAX(1,pacewait / 1000));
+				continue;
+			}
+			
+			duplicate = curl_easy_duphandle(curl);
+			if(duplicate) {
+				hedgereply = jsonreply_initialize();
+				curl_easy_setopt(duplicate, CURLOPT_WRITEDATA, hedgereply);
+				curl_easy_setopt(duplicate, CURLOPT_HEADERDATA, hedgereply);
+				second = httpengine_submit(duplicate,NULL,NULL);
+				hedgestart = now;
+			}
+			if(!second) {
+				if(duplicate) curl_easy_cleanup(duplicate);
+				duplicate = NULL;
+				pacing_release(url);
+				delay = G_MAXINT64; // Cannot duplicate, wait for original
+			}
+			continue;
+		}
+		
+		gint timeout = 1000;
+		if(!duplicate && delay != G_MAXINT64) timeout = (gint)MAX(1,(start + delay - now) / 1000);
+		httpengine_run(timeout);
+	}
+	
+	// Cancel the one still running
+	if(duplicate && !hedge) {
+		hedge = http_finish_attempt(duplicate,CURLE_ABORTED_BY_CALLBACK,hedgestart,number,TRUE);
+		hedge->outcome = OUTCOME_CANCELLED;
+	}
+	if(!primary) {
+		primary = http_finish_attempt(curl,CURLE_ABORTED_BY_CALLBACK,start,number,FALSE);
+		primary->outcome = OUTCOME_CANCELLED;
+	}
+	
+	primary->queued_us = queued;
+	if(hedge) hedge->queued_us = hedgestart - (start + delay);
+	
+	httpengine_remove(first);
+	pacing_release(url);
+	if(duplicate) {
+		httpengine_remove(second);
+		curl_easy_cleanup(duplicate);
+		pacing_release(url);
+	}
+	
+	*tries = g_slist_append(*tries,primary);
+	if(hedge) *tries = g_slist_append(*tries,hedge);
+	
+	if(used == hedge) {
+		free_jsonreply(*reply);
+		*reply = hedgereply;
+	}
+	else free_jsonreply(hedgereply);
+	
+	return used;
+}
+
+/**
+* Check whether method sends a body.
+*
+* @param method Method to check
+*
+* @return TRUE for POST, PUT and PATCH
+*/
+gboolean http_method_has_body(const gchar* method) {
+	return g_strcmp0(method,"POST") == 0 || g_strcmp0(method,"PUT") == 0 || 
+		g_strcmp0(method,"PATCH") == 0;
+}
+
+/**
+* Open the connection to url before the first request. A HEAD request is
+* sent and its reply is discarded, curl keeps the connection (resolved
+* address, TCP and TLS) and reuses it for the following requests to the
+* same host. Request waits for pacing of the url.
+*
+* @param url URL to connect to
+*
+* @return TRUE when the server replied
+*/
+gboolean http_prewarm(const gchar* url) {
+	if(!url || !curl) return FALSE;
+	
+	jsonreply* reply = jsonreply_initialize();
+	
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_get_json_reply_callback);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, http_get_header_callback);
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)request_timeouts.connect_ms);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)request_timeouts.total_ms);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+	
+	http_add_warm_origin(url);
+	attempt* try = http_perform(url,reply,1);
+	gboolean rval = try->error == CURLE_OK;
+	
+	if(!rval) g_print("Connection to %s failed in %.1f ms\n",url,try->latency_us / 1000.0);
+#ifdef G_MESSAGES_DEBUG
+	else g_print("Connection to %s opened in %.1f ms\n",url,try->latency_us / 1000.0);
+#endif
+	
+	// Following requests set their method
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+	
+	g_free(try);
+	free_jsonreply(reply);
+	return rval;
+}
+
+/**
+* Convert data of the reply from server encoding to local encoding
+* when encodings are set.
+*
+* @param reply Reply to convert
+*/
+static void http_convert_reply(jsonreply* reply) {
+	
+	// Encoding set?
+	if(server_encoding && local_encoding) {
+		gsize l = 0;	
+		gchar* back = convert_from_rest_api(reply->data,reply->length, &l);
+		if(reply->mapped) g_mapped_file_unref(reply->mapped);
+		else g_free(reply->data);
+		reply->mapped = NULL;
+		reply->data = back;
+		reply->length = l;
+		reply->size = l;
+	}
+}
+
 /**
 * Send jsondata as Content-Type "application/json" to given url
-* with given method using CURL. Initializes Content-Length field only with
-* POST method and likewise, adds the given data only with POST.
+* with given method using CURL. Data is sent only with POST, PUT and PATCH,
+* it is read in parts by curl from jsondata (e.g. a mapped file) without
+* copying and curl sets Content-Length.
 * Sets up headers: Accept: application/json, Accept-Charset: utf-8 and
 * if authentication token is set, appends also Authentication: header.
+* Accept-Encoding is set to the encodings curl is able to decode and the
+* amount of data received from network is set to wire_length of reply.
 * A callback set up to get the response which is returned as pointer to
 * jsonreply_t.
 *
+* If a retry policy is set for the method, failed requests are retried
+* with exponential backoff and GETs are hedged when enabled. POST gets an
+* Idempotency-Key header that is the same for all attempts when the policy
+* has idempotency_key enabled. Each attempt is added to attempts of reply.
+*
+* Timeouts set with http_set_timeouts() are used. Requests are cancelled
+* when the deadline set with http_set_deadline() is reached and after it
+* no requests are sent, the outcome of the reply tells which happened.
+*
+* GETs to paths set cacheable with httpcache_configure() are served from
+* the http cache while fresh, stale replies are revalidated with
+* If-None-Match and If-Modified-Since and a 304 reply uses cached data.
+*
 * @param url Where to send
 * @param jsondata Data to send, can be NULL
-* @param method Method to use (GET, POST, DELETE)
+* @param method Method to use (GET, POST, PUT, PATCH, DELETE)
 *
 * @return Newly allocated jsonreply_t pointer containing reply
 */
 jsonreply* http_post(gchar* url, jsonreply* jsondata, gchar* method) {
 	
-	CURLcode res;
 	struct curl_slist *headers = NULL;
 	
 	if(!url || !method  || !curl) return NULL;
 	
 	// New struct for reply
-	jsonreply* reply = g_new0(struct jsonreply_t,1);
+	jsonreply* reply = jsonreply_initialize();
 	gchar* converted = NULL;
-	gchar *contentlength = NULL;
-	gchar* datalen = NULL;
+	upload source = { NULL, 0, 0 };
+	gchar* idempotency = NULL;
+	gchar* ifnonematch = NULL;
+	gchar* ifmodifiedsince = NULL;
+	GSList* tries = NULL;
+	jsonreply* cached = NULL;
+	gboolean cacheable = httpcache_is_cacheable(method,url);
+	
+	retry_policy* policy = retry_policies ? (retry_policy*)g_hash_table_lookup(retry_policies,method) : NULL;
+	gboolean hedge = policy && policy->hedge && g_strcmp0(method,"GET") == 0;
 
 #ifdef G_MESSAGES_DEBUG
-	if(g_strcmp0(method,"POST") == 0) g_print("Content (%ld):%s \n%s To: %s\n", jsondata->length, jsondata->data,method, url);
+	if(jsondata && http_method_has_body(method)) g_print("Content (%" G_GSIZE_FORMAT "):%.*s \n%s To: %s\n", jsondata->length, (gint)jsondata->length, jsondata->data,method, url);
 	else g_print("Content (0)\n%s to %s\n",method,url);
 #endif
 
-	if(curl) {
-		// Setup headers
-		curl_easy_setopt(curl, CURLOPT_URL, url);
-		headers = curl_slist_append(headers, "Accept: application/json");
-		headers = curl_slist_append(headers, "Accept-Charset: utf-8");
-   		headers = curl_slist_append(headers, "Content-Type: application/json; charset=utf-8");
-   		
-   		// Token set, enable authentication
-   		if(token) headers = curl_slist_append(headers, token);  
-   		 
-   		// Set method 		
-   		curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
-   		
-   		// If POST method is given with non-null data
-		if(jsondata && g_strcmp0(method,"POST") == 0) {
+	if(cacheable) {
+		gboolean fresh = FALSE;
+		cached = httpcache_lookup(url,&fresh);
 		
-			// Encoding set?
-			if(server_encoding && local_encoding) {
-			
-				// Convert
-				gsize len = 0;
-				converted = convert_to_rest_api(jsondata->data,jsondata->length, &len);
-				if(len != jsondata->length) g_print("Conversion changed length (%ld -> %ld)\n",
-					jsondata->length, len);
-			
-				// Set datalength according to converted string
-				datalen = g_strdup_printf("%ld",len);
-				
-				// Add data
-				curl_easy_setopt(curl, CURLOPT_POSTFIELDS, converted);
-			}
-			else {
-				// Set datalength according to length
-				datalen = g_strdup_printf("%ld",jsondata->length);
-				
-				// Set data
-				curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsondata->data);
-			}
+		// Nothing is sent while fresh
+		if(cached && fresh) {
+			g_free(reply);
+			http_convert_reply(cached);
+			return cached;
+		}
+	}
+
+	// Setup headers
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	http_add_warm_origin(url);
+	headers = curl_slist_append(headers, "Accept: application/json");
+	headers = curl_slist_append(headers, "Accept-Charset: utf-8");
+	headers = curl_slist_append(headers, "Content-Type: application/json; charset=utf-8");
+	
+	// Token set, enable authentication
+	if(token) headers = curl_slist_append(headers, token);  
+	
+	// Same key for all attempts lets server detect the repeated POST
+	if(policy && policy->idempotency_key) {
+		gchar* uuid = g_uuid_string_random();
+		idempotency = g_strjoin(" ","Idempotency-Key:",uuid,NULL);
+		headers = curl_slist_append(headers, idempotency);
+		g_free(uuid);
+	}
+	
+	// Stale reply in cache, server replies 304 if it is still valid
+	if(cached && cached->cache.etag) {
+		ifnonematch = g_strjoin(" ","If-None-Match:",cached->cache.etag,NULL);
+		headers = curl_slist_append(headers, ifnonematch);
+	}
+	if(cached && cached->cache.last_modified) {
+		ifmodifiedsince = g_strjoin(" ","If-Modified-Since:",cached->cache.last_modified,NULL);
+		headers = curl_slist_append(headers, ifmodifiedsince);
+	}
+	 
+	// Set method, no data is sent unless set below
+	curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+	
+	// Compression, NULL disables decoding
+	curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, accept_encoding);
+	
+	// Body of POST, PUT and PATCH is streamed from the data as curl sends it
+	if(jsondata && http_method_has_body(method)) {
+	
+		// Encoding set?
+		if(server_encoding && local_encoding) {
+		
+			// Convert
+			gsize len = 0;
+			converted = convert_to_rest_api(jsondata->data,jsondata->length, &len);
+			if(len != jsondata->length) g_print("Conversion changed length (%" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT ")\n",
+				jsondata->length, len);
 			
-			// Add content-length header
-			contentlength = g_strjoin(" ","Content-Length:",datalen,NULL);
-	   		headers = curl_slist_append(headers, contentlength);
-			g_free(datalen);
+			source.data = converted;
+			source.length = len;
+		}
+		else {
+			// Data is not necessarily NUL terminated (mapped file)
+			source.data = jsondata->data;
+			source.length = jsondata->length;
 		}
 		
-		// Add all headers to curl
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+		// Content-Length is set by curl from the size
+		curl_easy_setopt(curl, CURLOPT_POST, 1L);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, NULL);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)source.length);
+		curl_easy_setopt(curl, CURLOPT_READFUNCTION, http_read_upload_callback);
+		curl_easy_setopt(curl, CURLOPT_READDATA, &source);
+		curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, http_seek_upload_callback);
+		curl_easy_setopt(curl, CURLOPT_SEEKDATA, &source);
 		
-		// For getting response
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_get_json_reply_callback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, reply);
- 
-		res = curl_easy_perform(curl);
-
-		if(res != CURLE_OK)	
-			g_print("curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-			
-		curl_slist_free_all(headers);
+		// Body is sent without waiting for 100 Continue
+		headers = curl_slist_append(headers, "Expect:");
+	}
+	
+	// Add all headers to curl
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	
+	// For getting response and its caching headers
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_get_json_reply_callback);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, http_get_header_callback);
+	
+	// Timeouts, 0 disables
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)request_timeouts.connect_ms);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)request_timeouts.total_ms);
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)request_timeouts.low_speed_bytes);
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)request_timeouts.low_speed_s);
+	
+	// Progress is checked for cancelling at deadline
+	curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, http_progress_callback);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+	
+	for(guint number = 1; ; number++) {
+		attempt* used = NULL;
+		
+		// Each attempt sends the whole body
+		source.offset = 0;
+		
+		// Nothing is sent after deadline
+		if(http_deadline_passed()) {
+			used = g_new0(struct attempt_t,1);
+			used->number = number;
+			used->outcome = OUTCOME_DEADLINE;
+			tries = g_slist_append(tries,used);
+			g_print("%s %s not sent, run deadline reached\n",method,url);
+		}
+		else if(hedge) used = http_perform_hedged(url,&reply,number,http_hedge_delay(policy),&tries);
+		else {
+			used = http_perform(url,reply,number);
+			tries = g_slist_append(tries,used);
+		}
+		used->used = TRUE;
+		
+		// Collect latencies of GETs for hedging, cancelled ones are not complete
+		for(GSList* iter = tries; iter; iter = g_slist_next(iter)) {
+			attempt* try = (attempt*)iter->data;
+			if(try->number == number && try->outcome == OUTCOME_OK && g_strcmp0(method,"GET") == 0) 
+				http_add_latency(try->latency_us);
+		}
+		
+		reply->status = used->status;
+		reply->wire_length = used->wire_length;
+		reply->outcome = used->outcome;
+		
+		if(!policy || number >= policy->attempts || !http_should_retry(used)) break;
+		
+		guint wait = http_backoff_delay(policy,number);
+		
+		// No time to wait for another attempt
+		if(deadline > 0 && g_get_monotonic_time() + (gint64)wait * 1000 >= deadline) break;
+		g_print("%s %s failed (status %ld), retrying in %u ms (attempt %u/%u)\n",
+			method,url,used->status,wait,number + 1,policy->attempts);
+		
+		// Only the final reply is kept
+		used->used = FALSE;
+		free_jsonreply(reply);
+		reply = jsonreply_initialize();
+		
+		g_usleep((gulong)wait * 1000);
 	}
+	
+	reply->attempts = tries;
+	
+	// Body was on stack, the handle must not refer to it in the following requests
+	curl_easy_setopt(curl, CURLOPT_READDATA, NULL);
+	curl_easy_setopt(curl, CURLOPT_SEEKDATA, NULL);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)-1);
+	curl_easy_setopt(curl, CURLOPT_POST, 0L);
+	curl_easy_setopt(curl, CURLOPT_UPLOAD, 0L);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+		
+	curl_slist_free_all(headers);
 	g_free(converted);
-	g_free(contentlength);
+	g_free(idempotency);
+	g_free(ifnonematch);
+	g_free(ifmodifiedsince);
+	
+	// Large reply is used from the temporary file
+	http_map_reply(reply);
+	
+	// Cache is in server encoding, conversion is done after it
+	if(cacheable) {
+		if(cached && reply->status == 304) httpcache_revalidated(url,cached,reply);
+		else httpcache_store(url,reply);
+	}
+	free_jsonreply(cached);
 	
 #ifdef G_MESSAGES_DEBUG
-	g_print("Reply (%ld):%s \n\n", reply->length, reply->data);
+	g_print("Reply (%" G_GSIZE_FORMAT "):%s \n\n", reply->length, reply->data);
 #endif
 
-	// Encoding set?
-	if(server_encoding && local_encoding) {
-		gsize l = 0;	
-		gchar* back = convert_from_rest_api(reply->data,reply->length, &l);
-		g_free(reply->data);
-		reply->data = back;
-		reply->length = l;
-	}
+	http_convert_reply(reply);
 	return reply;
 }
\ No newline at end of file
@@ -4,10 +4,26 @@
 #include <curl/curl.h>
 #include "definitions.h"
 
+#define HTTP_REPLY_INITIAL_SIZE 4096
+#define HTTP_REPLY_SPILL_SIZE (8 * 1024 * 1024)
+#define HEDGE_SAMPLES 200
+#define HEDGE_MIN_SAMPLES 20
+
 void http_init(gchar* encoding);
 void http_close();
+void http_shutdown();
+void http_print_stats();
 void set_token(gchar* new_token);
+void http_set_retry_policies(GHashTable* policies);
+void http_set_timeouts(const timeouts* tout);
+void http_set_latency_key(const gchar* path);
+void http_set_deadline(gint64 time);
+gboolean http_deadline_passed();
+void http_set_in_flight_work(in_flight_work work, gpointer userp);
 
+gboolean http_method_has_body(const gchar* method);
+gboolean http_prewarm(const gchar* url);
+gboolean http_preconnect(const gchar* url);
 jsonreply* http_post(gchar* url, jsonreply* jsondata, gchar* method);
 
 #endif
\ No newline at end of file
@@ -7,6 +7,22 @@
 #define EXIT_FAILURE -1
 #define EXIT_SUCCESS 0
 
+// Exit codes of test runs, the worst one is used for multiple tests
+#define EXIT_TEST_PASSED 0
+#define EXIT_NOT_FOUND 1
+#define EXIT_TEST_SLOW 2
+#define EXIT_TEST_FAILED 3
+
+#define RETRY_BACKOFF_MS 100
+#define RETRY_MAX_BACKOFF_MS 5000
+#define HEDGE_DELAY_MS 500
+
+#define TIMEOUT_CONNECT_MS 10000
+#define TIMEOUT_TOTAL_MS 60000
+#define TIMEOUT_LOW_SPEED_BYTES 1
+#define TIMEOUT_LOW_SPEED_S 30
+#define DEADLINE_RESERVE_S 30
+
 #include <glib.h>
 #include <json-glib/json-glib.h>
 
@@ -17,33 +33,276 @@ typedef struct user_preference_t {
 	GSequence *tests; // List of tests
 } user_preference;
 
+typedef struct timeouts_t {
+	guint connect_ms; // Time allowed for connecting, 0 disables
+	guint total_ms; // Time allowed for the whole request, 0 disables
+	guint low_speed_bytes; // Request is aborted when receiving less than this per second...
+	guint low_speed_s; // ...for this many seconds, 0 disables
+} timeouts;
+
+typedef enum {
+	OUTCOME_OK = 0, // Reply was received
+	OUTCOME_FAILED, // Connection or transfer failed
+	OUTCOME_CONNECT_TIMEOUT, // Connection was not established in time
+	OUTCOME_TIMEOUT, // Request was not completed in time
+	OUTCOME_LOW_SPEED, // Transfer was too slow for too long
+	OUTCOME_DEADLINE, // Cancelled or not sent because run deadline was reached
+	OUTCOME_CANCELLED, // Hedged duplicate that was not needed
+	OUTCOME_SLOW // Reply was received but latency budget was exceeded
+} outcome;
+
 typedef struct testcase_t {
 	gchar *URL; // REST API URL
 	gchar *name; // Name of the test
 	gchar *encoding; // Encoding of the server
 	GHashTable *files; // Hash table containing all testfile_t structures
 	GSList *intfields; // List of fieldnames that have integers
+	gboolean bounded_memory; // Release replies when no longer needed
+	GHashTable *retries; // Hash table of retry_policy_t structures, method as key
+	timeouts timeouts; // Default timeouts of the files of the test
+	guint deadline_s; // Time allowed for the whole run, 0 disables
+	guint reserve_s; // Part of deadline reserved for cleanup
+	gdouble rate; // Requests per second to URL, 0 is unlimited
+	guint burst; // Requests that can be sent at once within rate
+	guint max_in_flight; // Concurrent requests to URL, 0 is unlimited
+	GSList *cacheable; // Paths whose GET replies are cached on disk between runs
+	gboolean prewarm; // Open connections before the requests need them
 } testcase ;
 
+typedef struct prefetch_t {
+	testcase *test; // Test of the run
+	gchar *testpath; // Base path of the test
+	gint step; // Index of the step to prepare in test sequence
+	const gchar *in_flight; // File id of the step whose request is in flight
+} prefetch;
+
+typedef struct retry_policy_t {
+	guint attempts; // Maximum amount of attempts, 1 disables retrying
+	guint backoff_ms; // Base delay of exponential backoff
+	guint max_backoff_ms; // Upper limit for a single delay
+	gboolean idempotency_key; // Send Idempotency-Key header, required for retrying POST
+	gboolean hedge; // Send a duplicate GET when the first is slower than p95
+	guint hedge_ms; // Hedge delay used until enough latencies are collected for p95
+} retry_policy;
+
+typedef struct pacer_t {
+	gchar *base; // Base URL whose requests are paced
+	gdouble rate; // Tokens added per second, 0 disables rate limiting
+	gdouble burst; // Maximum amount of tokens
+	gdouble tokens; // Tokens available
+	gint64 refilled; // Monotonic time of last refill
+	guint max_in_flight; // Maximum amount of concurrent requests, 0 is unlimited
+	guint in_flight; // Requests in flight
+	gint64 waited_us; // Total time requests waited for pacing
+} pacer;
+
+typedef struct shard_item_t {
+	testcase *test; // Test to assign
+	gint64 duration; // Expected duration of the test in milliseconds
+} shard_item;
+
+typedef struct soak_series_t {
+	gchar *name; // Name of the series, step or memory
+	GArray *times; // Time of each sample in seconds since start (gdouble)
+	GArray *values; // Value of each sample (gdouble)
+	gboolean memory; // Memory of testfw, growth is not a result of the test
+} soak_series;
+
+typedef struct http_transfer_t http_transfer;
+typedef void (*transfer_done)(http_transfer* transfer, gpointer userp);
+typedef void (*in_flight_work)(gpointer userp);
+
+struct http_transfer_t {
+	gpointer handle; // CURL easy handle of the transfer
+	transfer_done done; // Called when the transfer finishes, can be NULL
+	gpointer userp; // Data for done
+	gboolean finished; // Transfer has finished
+	gint result; // CURLcode of the finished transfer
+};
+
+typedef struct attempt_t {
+	guint number; // Number of the attempt, starting from 1
+	gboolean hedged; // Attempt was a duplicate sent by hedging
+	gboolean used; // Reply of this attempt was used
+	glong status; // HTTP status code, 0 if there was no response
+	gint error; // CURLcode of the transfer
+	outcome outcome; // Outcome of the attempt
+	gint64 latency_us; // Duration of the attempt
+	gint64 queued_us; // Time waited for pacing before the attempt
+	gsize wire_length; // Bytes received from network
+} attempt;
+
+typedef struct latency_window_t {
+	GArray *samples; // Recent latencies in microseconds
+	guint next; // Next position to replace in samples
+} latency_window;
+
+typedef struct upload_t {
+	const gchar *data; // Body to send, e.g. in a mapped file
+	gsize length; // Length of the body
+	gsize offset; // Amount of the body sent
+} upload;
+
+typedef struct cache_info_t {
+	gchar *etag; // ETag of the reply, sent as If-None-Match
+	gchar *last_modified; // Last-Modified of the reply, sent as If-Modified-Since
+	gint64 max_age; // Seconds the reply is fresh, 0 requires revalidation
+	gboolean no_cache; // Reply must be revalidated before each use, overrides max_age
+	gboolean has_lifetime; // Reply had max-age or no-cache, also when max-age is 0
+	gboolean no_store; // Server denied storing the reply
+} cache_info;
+
 typedef struct jsonreply_t {
   	gchar *data; // Json as char data
   	gsize length; // Lenght of the char data
+  	gsize size; // Allocated size of the data
+  	gsize wire_length; // Length of the data received from network (before decoding)
+  	glong status; // HTTP status code of the reply
+  	outcome outcome; // Outcome of the request
+  	GSList *attempts; // List of attempt_t structures, one for each request sent
+  	GMappedFile *mapped; // Mapped file containing the data, data is not free'd when set
+  	JsonParser *parser; // Parser of the data, set when data is parsed the first time
+	cache_info cache; // Caching headers of the reply
+	gint spill_fd; // Unlinked temporary file a large reply is written to, -1 when data is in heap
+	gint checked; // Data validated: 0 not checked, 1 valid (on-demand backend), -1 invalid
 } jsonreply;
 
+typedef enum jsonpath_op_t {
+	JSONPATH_MEMBER, // Member of object, applied to each element of array
+	JSONPATH_INDEX, // Element of array
+	JSONPATH_WILDCARD, // All elements of array or members of object
+	JSONPATH_FILTER // Elements having a value at relative path
+} jsonpath_op;
+
+typedef struct jsonpath_step_t {
+	jsonpath_op op; // Operation of the step
+	gchar *name; // Member name (JSONPATH_MEMBER)
+	gint index; // Index of element, negative from the end (JSONPATH_INDEX)
+	struct jsonpath_t *filter; // Path relative to element (JSONPATH_FILTER)
+	gchar *value; // Value the filter path must have (JSONPATH_FILTER)
+} jsonpath_step;
+
+typedef struct jsonpath_t {
+	gchar *expression; // Expression the path was compiled from
+	GArray *steps; // Array of jsonpath_step_t structures
+} jsonpath;
+
+typedef struct arena_block_t {
+	struct arena_block_t *next; // Previous block in arena
+	gsize size; // Size of the data in block
+	gsize used; // Amount of data used
+	gchar data[]; // Data of the block
+} arena_block;
+
+typedef struct arena_t {
+	arena_block *blocks; // Current block, older blocks linked from it
+	gsize block_size; // Default size of a new block
+	guint64 allocations; // Allocations done since creation
+	guint64 bytes; // Bytes allocated since creation
+	guint64 resets; // Times the arena has been reset
+	guint64 blocks_allocated; // Blocks allocated from heap since creation
+} arena;
+
+// Backends only look up values, editing and verifying always use json-glib
+typedef struct json_backend_t {
+	const gchar *name; // Name used for selecting the backend
+	gboolean (*validate)(jsonreply* reply); // Check that data of the reply is valid json
+	gchar* (*get_string)(jsonpath* path, jsonreply* reply, arena* ar); // Value at path allocated from arena or heap
+} json_backend;
+
+typedef struct capture_t {
+	gchar *name; // Name of the value in capture store
+	jsonpath *select; // Compiled path of the value in the reply
+	gboolean declared; // Declared in "capture" of the file in preferences
+} capture;
+
+typedef struct urltemplate_part_t {
+	gchar *literal; // Literal text, NULL when the part is a variable
+	gsize length; // Length of the literal
+	gchar *name; // Name of the value in capture store (variable)
+	gchar *file; // Id of the file whose reply has the value (variable), NULL if not found
+} urltemplate_part;
+
+typedef struct urltemplate_t {
+	gchar *expression; // Path the template was compiled from
+	GArray *parts; // Array of urltemplate_part_t structures
+	gsize literal_length; // Total length of the literal parts
+} urltemplate;
+
+typedef struct reference_t {
+	gchar *member; // Member name whose value is replaced
+	gchar *search_file; // Id of the file whose reply has the value ({parent})
+	gchar *path; // Path to request the value from ({getinfo})
+	gchar *method; // Method of the request ({getinfo})
+	jsonpath *select; // Compiled path of the value in the reply
+	gchar *key; // Key in the fixture store, NULL if not stored
+	guint refs; // Fixtures using the reference
+} reference;
+
+typedef struct cached_request_t {
+	gboolean pending; // Request is being sent, reply is not set
+	jsonreply *reply; // Reply to the request
+} cached_request;
+
+typedef struct fixture_content_t {
+	gchar *hash; // SHA-256 of the file, key in the fixture store
+	GMappedFile *mapped; // File mapped into memory
+	GSList *parents; // Names of members having {parent} as value
+	GSList *getinfos; // Names of members having {getinfo} as value
+	guint refs; // Fixtures using the content
+} fixture_content;
+
+typedef struct fixture_stamp_t {
+	gchar *path; // Path to the file
+	gint64 mtime; // Modification time of the file, -1 if it did not exist
+	gint64 size; // Size of the file
+} fixture_stamp;
+
+typedef struct fixture_t {
+	fixture_content *content; // Shared content of the file
+	GMappedFile *mapped; // Test file mapped into memory
+	GSList *parents; // List of reference_t structures of members having {parent} as value
+	GSList *getinfos; // List of reference_t structures of members having {getinfo} as value
+	GSList *stamps; // List of fixture_stamp_t of the test file and its information files
+} fixture;
+
+typedef struct result_t {
+	gchar *test; // Name of the test
+	gchar *id; // File id of the step
+	gchar *method; // Method used
+	gchar *path; // Path used with REST API URL
+	gsize wire_length; // Bytes received from network
+	gsize decoded_length; // Bytes after decoding
+	guint attempt; // Number of the attempt
+	gboolean hedged; // Attempt was a duplicate sent by hedging
+	gboolean used; // Reply of this attempt was used
+	glong status; // HTTP status code
+	outcome outcome; // Outcome of the attempt
+	gint64 latency_us; // Duration of the attempt
+	gint64 queued_us; // Time waited for pacing before the attempt
+} result;
+
 typedef struct testfile_t {
 	gchar *id; // File id in preferences.json
 	gchar *file; // Filename in test folder
 	gchar *path; // Path for REST API URL
+	gchar *name; // Name of the file in path templates, id when not set
+	urltemplate *template; // Path compiled at load
+	GSList *captures; // List of capture_t, values taken from the reply when it arrives
 	gchar *method; // Method to use
 	gboolean need_delete;
+	timeouts timeouts; // Timeouts of the requests of this file
+	guint max_latency_ms; // Latency budget of the request, 0 if not set
+	guint p95_latency_ms; // Budget for p95 latency of the request over runs, 0 if not set
+	fixture *fixture; // Test file mapped and validated for this run
 	jsonreply *send; // File data as json string
 	jsonreply *recv; // Reply sent by the server as json string
 	GSList *required; // List of required members from id 0 (case creation)
-	GSList *reqinfo; // List of jsons telling more information about where to get value for {parent}
 	GHashTable *replace; // Hash table of members to have new value
 	GSList *moreinfo; // List of fields that require more information
-	GSList *infosend; // List of jsons that are to be used to get more info
 	GSList *inforecv; // List of json replies sent by the server
+	gint order; // Position in test sequence
+	gboolean released; // Reply was released, its values needed later were captured
 } testfile;
 
 
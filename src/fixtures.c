@@ -0,0 +1,483 @@
+#include "fixtures.h"
+#include "jsonutils.h"
+#include "utils.h"
+#include "jsonpath.h"
+#include <glib/gstdio.h>
+
+static GHashTable* contents = NULL; // Contents of test files by SHA-256
+static GHashTable* references = NULL; // References by kind, member and SHA-256 of the info file
+static GMutex store_lock; // Protects the stores, files are loaded in parallel
+static guint shared = 0; // Loads served from the stores
+
+/**
+* Free a single reference_t.
+*
+* @param data Pointer to reference to free
+*/
+static void free_reference(gpointer data) {
+	reference* ref = (reference*)data;
+	if(ref) {
+		g_free(ref->member);
+		g_free(ref->search_file);
+		g_free(ref->path);
+		g_free(ref->method);
+		free_jsonpath(ref->select);
+		g_free(ref->key);
+		g_free(ref);
+	}
+}
+
+/**
+* Free a single fixture_content_t.
+*
+* @param data Pointer to content to free
+*/
+static void free_fixture_content(gpointer data) {
+	fixture_content* content = (fixture_content*)data;
+	if(content) {
+		g_mapped_file_unref(content->mapped);
+		g_slist_free_full(content->parents,(GDestroyNotify)g_free);
+		g_slist_free_full(content->getinfos,(GDestroyNotify)g_free);
+		g_free(content->hash);
+		g_free(content);
+	}
+}
+
+/**
+* Free a single fixture_stamp_t.
+*
+* @param data Pointer to stamp to free
+*/
+static void free_fixture_stamp(gpointer data) {
+	fixture_stamp* stamp = (fixture_stamp*)data;
+	if(stamp) {
+		g_free(stamp->path);
+		g_free(stamp);
+	}
+}
+
+/**
+* Get the modification time and size of a file.
+*
+* @param path Path to the file
+* @param mtime Set to modification time, -1 if the file does not exist
+* @param size Set to size of the file
+*/
+static void fixture_stat(const gchar* path, gint64* mtime, gint64* size) {
+	GStatBuf buf;
+	
+	if(g_stat(path,&buf) == 0) {
+		*mtime = (gint64)buf.st_mtime;
+		*size = (gint64)buf.st_size;
+	}
+	else {
+		*mtime = -1;
+		*size = 0;
+	}
+}
+
+/**
+* Add the current modification time and size of a file to the fixture.
+* Stamped before the file is read, a change while reading is seen later.
+*
+* @param fix Fixture the file belongs to
+* @param path Path to the file
+*/
+static void fixture_add_stamp(fixture* fix, const gchar* path) {
+	fixture_stamp* stamp = g_new0(struct fixture_stamp_t,1);
+	stamp->path = g_strdup(path);
+	fixture_stat(path,&(stamp->mtime),&(stamp->size));
+	fix->stamps = g_slist_append(fix->stamps,stamp);
+}
+
+/**
+* Form path to the information file of a member, <file>.<kind>.<member>.json.
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* fixture_make_info_path(const gchar* path, const gchar* kind, const gchar* member) {
+	return g_strjoin(".",path,kind,member,"json",NULL);
+}
+
+/**
+* Parse the reference of a member from its information file. The path of
+* the value ("select") is compiled here. Without it the path is made from
+* "search_member" and "root_task" of {parent} and is data.guid for {getinfo}.
+*
+* @param infopath Path to the information file, for messages
+* @param kind "info" or "getinfo"
+* @param member Member name
+* @param data Contents of the information file, NULL if it cannot be read
+* @param length Length of data
+*
+* @return Newly allocated reference_t, select is NULL when not valid
+*/
+static reference* fixture_parse_reference(const gchar* infopath, const gchar* kind, const gchar* member,
+	const gchar* data, gsize length) {
+	reference* ref = g_new0(struct reference_t,1);
+	ref->member = g_strdup(member);
+	ref->refs = 1;
+	
+	gchar* select = NULL;
+	GError *error = NULL;
+	JsonParser *parser = json_parser_new();
+	
+	if(data && json_parser_load_from_data(parser,data,length,&error)) {
+		JsonReader *reader = json_reader_new(json_parser_get_root(parser));
+		
+		if(json_reader_read_member(reader,"data")) {
+			select = get_json_member_string(reader,"select");
+			
+			if(g_strcmp0(kind,"info") == 0) {
+				ref->search_file = get_json_member_string(reader,"search_file");
+				
+				if(!select) {
+					gchar* search_member = get_json_member_string(reader,"search_member");
+					gchar* search_root = get_json_member_string(reader,"root_task");
+					
+					if(search_member) select = g_strcmp0(search_root,"yes") == 0 ?
+						g_strjoin(".","data","root_task",search_member,NULL) :
+						g_strjoin(".","data",search_member,NULL);
+					
+					g_free(search_member);
+					g_free(search_root);
+				}
+			}
+			else {
+				ref->path = get_json_member_string(reader,"path");
+				ref->method = get_json_member_string(reader,"method");
+				if(!select) select = g_strdup("data.guid");
+			}
+		}
+		json_reader_end_member(reader);
+		g_object_unref(reader);
+	}
+	else g_print("Cannot parse file \"%s\". Reason: %s\n",infopath,
+		error ? error->message : "cannot read file");
+	
+	if(error) g_error_free(error);
+	
+	ref->select = jsonpath_compile(select);
+	
+	g_free(select);
+	g_object_unref(parser);
+	return ref;
+}
+
+/**
+* Get the reference of a member from its information file, named as
+* <file>.info.<member>.json for {parent} and <file>.getinfo.<member>.json
+* for {getinfo}. References are stored by their kind, member and the hash
+* of the information file, identical files are parsed and compiled once
+* and the reference is shared.
+*
+* @param path Path to the test file
+* @param kind "info" or "getinfo"
+* @param member Member name
+*
+* @return Reference to release with fixture_release_reference()
+*/
+static reference* fixture_get_reference(const gchar* path, const gchar* kind, const gchar* member) {
+	gchar* infopath = fixture_make_info_path(path,kind,member);
+	gchar* data = NULL;
+	gsize length = 0;
+	reference* ref = NULL;
+	
+	// Not stored, the error is reported when parsing
+	if(!g_file_get_contents(infopath,&data,&length,NULL)) {
+		ref = fixture_parse_reference(infopath,kind,member,NULL,0);
+		g_free(infopath);
+		return ref;
+	}
+	
+	gchar* hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256,(const guchar*)data,length);
+	gchar* key = g_strjoin(":",kind,member,hash,NULL);
+	
+	g_mutex_lock(&store_lock);
+	if(!references) references = g_hash_table_new(g_str_hash,g_str_equal);
+	if((ref = (reference*)g_hash_table_lookup(references,key))) {
+		ref->refs++;
+		shared++;
+	}
+	g_mutex_unlock(&store_lock);
+	
+	// Parsed without lock, the first one stored is used
+	if(!ref) {
+		reference* parsed = fixture_parse_reference(infopath,kind,member,data,length);
+		
+		g_mutex_lock(&store_lock);
+		if((ref = (reference*)g_hash_table_lookup(references,key))) ref->refs++;
+		else {
+			ref = parsed;
+			ref->key = key;
+			key = NULL;
+			g_hash_table_insert(references,ref->key,ref);
+			parsed = NULL;
+		}
+		g_mutex_unlock(&store_lock);
+		
+		free_reference(parsed);
+	}
+	
+	g_free(key);
+	g_free(hash);
+	g_free(data);
+	g_free(infopath);
+	return ref;
+}
+
+/**
+* Release a reference got with fixture_get_reference(), it is free'd when
+* no fixture uses it.
+*
+* @param data Reference to release
+*/
+static void fixture_release_reference(gpointer data) {
+	reference* ref = (reference*)data;
+	if(!ref) return;
+	
+	g_mutex_lock(&store_lock);
+	gboolean last = --ref->refs == 0;
+	if(last && ref->key) g_hash_table_remove(references,ref->key);
+	g_mutex_unlock(&store_lock);
+	
+	if(last) free_reference(ref);
+}
+
+/**
+* Get the content of a test file. The file is mapped and hashed, content
+* that is already in the store is used and the new mapping is dropped.
+* Otherwise the file is validated and the members having {parent} or
+* {getinfo} as value are listed in the order they appear in the file.
+* This is the only time the file is parsed.
+*
+* @param path Path to the file
+*
+* @return Content to release with fixture_release_content() or NULL if not valid
+*/
+static fixture_content* fixture_get_content(const gchar* path) {
+	GError *error = NULL;
+	GMappedFile* mapped = g_mapped_file_new(path,FALSE,&error);
+	
+	if(!mapped) {
+		g_print("Cannot map file \"%s\". Reason: %s\n",path,error ? error->message : "unknown");
+		if(error) g_error_free(error);
+		return NULL;
+	}
+	
+	gsize length = g_mapped_file_get_length(mapped);
+	const gchar* data = g_mapped_file_get_contents(mapped);
+	gchar* hash = length ? g_compute_checksum_for_data(G_CHECKSUM_SHA256,(const guchar*)data,length) : NULL;
+	fixture_content* content = NULL;
+	
+	g_mutex_lock(&store_lock);
+	if(!contents) contents = g_hash_table_new(g_str_hash,g_str_equal);
+	if(hash && (content = (fixture_content*)g_hash_table_lookup(contents,hash))) {
+		content->refs++;
+		shared++;
+	}
+	g_mutex_unlock(&store_lock);
+	
+	if(content) {
+		g_mapped_file_unref(mapped);
+		g_free(hash);
+		return content;
+	}
+	
+	JsonParser *parser = json_parser_new();
+	
+	if(length == 0 || !json_parser_load_from_data(parser,data,length,&error)) {
+		g_print("Cannot parse file \"%s\". Reason: %s\n",path,error ? error->message : "empty file");
+		if(error) g_error_free(error);
+		g_object_unref(parser);
+		g_mapped_file_unref(mapped);
+		g_free(hash);
+		return NULL;
+	}
+	
+	fixture_content* parsed = g_new0(struct fixture_content_t,1);
+	parsed->hash = hash;
+	parsed->mapped = mapped;
+	parsed->refs = 1;
+	
+	JsonReader *reader = json_reader_new(json_parser_get_root(parser));
+	gchar** members = json_reader_list_members(reader);
+	
+	// Members to replace when the file is sent
+	for(gint membidx = 0; members && members[membidx] != NULL; membidx++) {
+		gchar* membstring = get_json_member_string(reader,members[membidx]);
+		
+		if(g_strcmp0(membstring,"{parent}") == 0)
+			parsed->parents = g_slist_append(parsed->parents,g_strdup(members[membidx]));
+		else if(g_strcmp0(membstring,"{getinfo}") == 0)
+			parsed->getinfos = g_slist_append(parsed->getinfos,g_strdup(members[membidx]));
+		
+		g_free(membstring);
+	}
+	
+	g_strfreev(members);
+	g_object_unref(reader);
+	g_object_unref(parser);
+	
+	// Parsed without lock, the first one stored is used
+	g_mutex_lock(&store_lock);
+	if((content = (fixture_content*)g_hash_table_lookup(contents,hash))) content->refs++;
+	else {
+		content = parsed;
+		g_hash_table_insert(contents,content->hash,content);
+		parsed = NULL;
+	}
+	g_mutex_unlock(&store_lock);
+	
+	free_fixture_content(parsed);
+	return content;
+}
+
+/**
+* Release a content got with fixture_get_content(), it is free'd and
+* unmapped when no fixture uses it.
+*
+* @param content Content to release
+*/
+static void fixture_release_content(fixture_content* content) {
+	if(!content) return;
+	
+	g_mutex_lock(&store_lock);
+	gboolean last = --content->refs == 0;
+	if(last) g_hash_table_remove(contents,content->hash);
+	g_mutex_unlock(&store_lock);
+	
+	if(last) free_fixture_content(content);
+}
+
+/**
+* Load a test file with its information files. Contents of the files are
+* stored by their hash: identical files of any test or user are read and
+* hashed but parsed and compiled only once and shared read-only. The
+* references of members having {parent} or {getinfo} as value are in the
+* order they appear in the file. Modification time and size of the files
+* are stored for fixture_is_current().
+*
+* @param path Path to the file
+*
+* @return Newly allocated fixture_t to be free'd with free_fixture() or NULL if not valid
+*/
+fixture* fixture_load(const gchar* path) {
+	if(!path) return NULL;
+	
+	fixture* fix = g_new0(struct fixture_t,1);
+	fixture_add_stamp(fix,path);
+	
+	fixture_content* content = fixture_get_content(path);
+	if(!content) {
+		free_fixture(fix);
+		return NULL;
+	}
+	
+	fix->content = content;
+	fix->mapped = g_mapped_file_ref(content->mapped);
+	
+	for(GSList* iter = content->parents; iter; iter = g_slist_next(iter)) {
+		gchar* infopath = fixture_make_info_path(path,"info",(gchar*)iter->data);
+		fixture_add_stamp(fix,infopath);
+		fix->parents = g_slist_append(fix->parents,fixture_get_reference(path,"info",(gchar*)iter->data));
+		g_free(infopath);
+	}
+	
+	for(GSList* iter = content->getinfos; iter; iter = g_slist_next(iter)) {
+		gchar* infopath = fixture_make_info_path(path,"getinfo",(gchar*)iter->data);
+		fixture_add_stamp(fix,infopath);
+		fix->getinfos = g_slist_append(fix->getinfos,fixture_get_reference(path,"getinfo",(gchar*)iter->data));
+		g_free(infopath);
+	}
+	
+	return fix;
+}
+
+/**
+* Check whether the files of the fixture are unchanged since it was loaded.
+* A file is changed when its modification time or size differs or it was
+* created or removed.
+*
+* @param fix Fixture to check
+*
+* @return TRUE when none of the files has changed
+*/
+gboolean fixture_is_current(fixture* fix) {
+	if(!fix) return FALSE;
+	
+	for(GSList* iter = fix->stamps; iter; iter = g_slist_next(iter)) {
+		fixture_stamp* stamp = (fixture_stamp*)iter->data;
+		gint64 mtime = 0, size = 0;
+		
+		fixture_stat(stamp->path,&mtime,&size);
+		if(mtime != stamp->mtime || size != stamp->size) return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+* Print the amount of file contents and references in the fixture store
+* and the amount of loads that were served from it.
+*/
+void fixture_print_stats() {
+	g_mutex_lock(&store_lock);
+	g_print("Fixture store: %u files, %u info files, %u loads shared\n",
+		contents ? g_hash_table_size(contents) : 0,
+		references ? g_hash_table_size(references) : 0,
+		shared);
+	g_mutex_unlock(&store_lock);
+}
+
+/**
+* Check whether the fixture can be sent as it is.
+*
+* @param fix Fixture to check
+*
+* @return TRUE when fixture has no members to replace
+*/
+gboolean fixture_is_raw(fixture* fix) {
+	return fix && !fix->parents && !fix->getinfos;
+}
+
+/**
+* Create the data to send from fixture. A raw fixture is not copied, the
+* data refers to the mapped file and keeps a reference to it. Otherwise
+* the original bytes are copied as the values are replaced in the copy.
+*
+* @param fix Fixture to send
+*
+* @return Newly allocated jsonreply_t to be free'd with free_jsonreply()
+*/
+jsonreply* fixture_make_send(fixture* fix) {
+	if(!fix) return NULL;
+	
+	jsonreply* send = jsonreply_initialize();
+	send->length = g_mapped_file_get_length(fix->mapped);
+	
+	if(fixture_is_raw(fix)) {
+		send->mapped = g_mapped_file_ref(fix->mapped);
+		send->data = g_mapped_file_get_contents(fix->mapped);
+	}
+	else send->data = g_strndup(g_mapped_file_get_contents(fix->mapped),send->length);
+	
+	return send;
+}
+
+/**
+* Free a single fixture_t, the shared content and references are released
+* and the file is unmapped when no fixture or data to send refers to it.
+*
+* @param data Pointer to fixture to free
+*/
+void free_fixture(gpointer data) {
+	fixture* fix = (fixture*)data;
+	if(fix) {
+		if(fix->mapped) g_mapped_file_unref(fix->mapped);
+		g_slist_free_full(fix->parents,(GDestroyNotify)fixture_release_reference);
+		g_slist_free_full(fix->getinfos,(GDestroyNotify)fixture_release_reference);
+		g_slist_free_full(fix->stamps,(GDestroyNotify)free_fixture_stamp);
+		fixture_release_content(fix->content);
+		g_free(fix);
+	}
+}
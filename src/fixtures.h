@@ -0,0 +1,13 @@
+#ifndef __FIXTURES_H_
+#define __FIXTURES_H_
+
+#include "definitions.h"
+
+fixture* fixture_load(const gchar* path);
+gboolean fixture_is_current(fixture* fix);
+gboolean fixture_is_raw(fixture* fix);
+jsonreply* fixture_make_send(fixture* fix);
+void fixture_print_stats();
+void free_fixture(gpointer data);
+
+#endif
@@ -0,0 +1,462 @@
+#include "history.h"
+#include "results.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+static GHashTable* run_history = NULL; // History loaded for the current run
+static gchar* run_history_user = NULL; // User whose history is loaded
+
+/**
+* Form path to the run history of the user.
+*
+* @param username User
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* history_make_path(const gchar* username) {
+	return g_strjoin("/",TESTPATH,username,HISTORYFILE,NULL);
+}
+
+/**
+* Lock the history of the user. Runs of all processes, e.g. shards, append
+* to the same history, appending and compacting are done under exclusive
+* lock and reading under shared lock. The history file is replaced when
+* compacted, so a separate lock file is locked.
+*
+* @param username User whose history is locked
+* @param operation LOCK_EX or LOCK_SH
+*
+* @return Descriptor of the lock file to give to history_unlock() or -1 if not locked
+*/
+static gint history_lock(const gchar* username, gint operation) {
+	gchar* path = g_strjoin("/",TESTPATH,username,HISTORYFILE_LOCK,NULL);
+	gint fd = open(path,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+	
+	if(fd >= 0 && flock(fd,operation) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	if(fd < 0) g_print("Cannot lock history with \"%s\"\n",path);
+	
+	g_free(path);
+	return fd;
+}
+
+/**
+* Unlock the history locked with history_lock().
+*
+* @param fd Descriptor of the lock file, -1 is ignored
+*/
+static void history_unlock(gint fd) {
+	if(fd < 0) return;
+	flock(fd,LOCK_UN);
+	close(fd);
+}
+
+/**
+* Form key of a step used in history: test, file id, method and path
+* separated with tabs. Path is the path in preferences so {id} is kept
+* as it is, file id separates the steps using the same path.
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* history_make_key(const gchar* test, const gchar* id, const gchar* method, const gchar* path) {
+	return g_strjoin("\t",test ? test : "",id ? id : "",method ? method : "",path ? path : "",NULL);
+}
+
+/**
+* Free history samples, called by GHashTable destroy notification.
+*/
+static void history_free_samples(gpointer data) {
+	g_array_free((GArray*)data,TRUE);
+}
+
+/**
+* Load history of the user. Each line of history contains the run id (start
+* time of appending in microseconds), test, file id, method, path, outcome
+* and latency in microseconds separated with tabs. Only successful requests
+* are used as samples.
+*
+* @param username User whose history is loaded
+*
+* @return Hash table with history key as key and GArray of latencies
+* (gint64, oldest first) as value, free with g_hash_table_destroy()
+*/
+static GHashTable* history_load(const gchar* username) {
+	GHashTable* history = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)history_free_samples);
+	
+	gchar* path = history_make_path(username);
+	gchar* contents = NULL;
+	gint lock = history_lock(username,LOCK_SH);
+	gboolean loaded = g_file_get_contents(path,&contents,NULL,NULL);
+	history_unlock(lock);
+	
+	if(loaded) {
+		gchar** lines = g_strsplit(contents,"\n",-1);
+		
+		for(gint lineidx = 0; lines[lineidx]; lineidx++) {
+			gchar** fields = g_strsplit(lines[lineidx],"\t",HISTORY_FIELDS);
+			
+			// Slow replies are successful too
+			if(g_strv_length(fields) == HISTORY_FIELDS && 
+				(g_strcmp0(fields[5],"ok") == 0 || g_strcmp0(fields[5],"slow") == 0)) {
+				gchar* key = history_make_key(fields[1],fields[2],fields[3],fields[4]);
+				GArray* samples = (GArray*)g_hash_table_lookup(history,key);
+				
+				if(!samples) {
+					samples = g_array_new(FALSE,FALSE,sizeof(gint64));
+					g_hash_table_insert(history,key,samples);
+				}
+				else g_free(key);
+				
+				gint64 latency = g_ascii_strtoll(fields[6],NULL,10);
+				g_array_append_val(samples,latency);
+			}
+			g_strfreev(fields);
+		}
+		g_strfreev(lines);
+		g_free(contents);
+	}
+	g_free(path);
+	return history;
+}
+
+/**
+* Load the history of the user for the current run. Latency budgets and
+* regressions of the run are checked against it, the history is read only
+* once per run.
+*
+* @param username User whose history is loaded
+*/
+void history_load_run(const gchar* username) {
+	history_release_run();
+	if(!username) return;
+	
+	run_history = history_load(username);
+	run_history_user = g_strdup(username);
+}
+
+/**
+* Release the history loaded with history_load_run().
+*/
+void history_release_run() {
+	if(run_history) g_hash_table_destroy(run_history);
+	run_history = NULL;
+	g_free(run_history_user);
+	run_history_user = NULL;
+}
+
+/**
+* Get the history of the user, the history of the run when it is loaded
+* for the user.
+*
+* @param username User whose history is needed
+* @param loaded Set to TRUE when the history was loaded now and must be
+* free'd with g_hash_table_destroy()
+*
+* @return Hash table of history_load()
+*/
+static GHashTable* history_get(const gchar* username, gboolean* loaded) {
+	*loaded = !run_history || g_strcmp0(run_history_user,username) != 0;
+	return *loaded ? history_load(username) : run_history;
+}
+
+static gint history_compare_latency(gconstpointer a, gconstpointer b) {
+	gint64 first = *(const gint64*)a, second = *(const gint64*)b;
+	return first < second ? -1 : (first > second ? 1 : 0);
+}
+
+/**
+* Get percentile of sorted samples using nearest rank.
+*
+* @param sorted Sorted samples
+* @param percentile Percentile (0-100)
+*
+* @return Value at percentile
+*/
+static gint64 history_percentile(GArray* sorted, guint percentile) {
+	guint rank = (sorted->len * percentile + 99) / 100;
+	return g_array_index(sorted,gint64,rank > 0 ? rank - 1 : 0);
+}
+
+/**
+* Get the samples of the rolling baseline: at most HISTORY_WINDOW of the
+* most recent samples, sorted.
+*
+* @param samples All samples, oldest first
+*
+* @return New sorted GArray, free with g_array_free()
+*/
+static GArray* history_baseline(GArray* samples) {
+	guint first = samples->len > HISTORY_WINDOW ? samples->len - HISTORY_WINDOW : 0;
+	GArray* sorted = g_array_sized_new(FALSE,FALSE,sizeof(gint64),samples->len - first);
+	
+	g_array_append_vals(sorted,&g_array_index(samples,gint64,first),samples->len - first);
+	g_array_sort(sorted,history_compare_latency);
+	return sorted;
+}
+
+/**
+* Compare latencies of the current run against the history of the user and
+* print the steps whose latency regressed. Baseline of a step is the rolling
+* window of its last HISTORY_WINDOW successful requests. A step regressed when
+* its latency (median if it was requested multiple times) is above p95 of the
+* baseline and its robust z-score, (latency - median) / (1.4826 * MAD), is
+* above HISTORY_Z_THRESHOLD. Steps with less than HISTORY_MIN_SAMPLES in
+* history are not compared.
+*
+* @param username User whose history is used
+* @param results List of result_t of the current run
+*
+* @return Amount of regressed steps
+*/
+guint history_report_regressions(const gchar* username, GSList* results) {
+	if(!username || !results) return 0;
+	
+	gboolean loaded = FALSE;
+	GHashTable* history = history_get(username,&loaded);
+	GHashTable* current = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)history_free_samples);
+	guint regressions = 0, compared = 0;
+	
+	// Latencies of the current run by step
+	for(GSList* iter = results; iter; iter = g_slist_next(iter)) {
+		result* res = (result*)iter->data;
+		if(!res->used || (res->outcome != OUTCOME_OK && res->outcome != OUTCOME_SLOW)) continue;
+		
+		gchar* key = history_make_key(res->test,res->id,res->method,res->path);
+		GArray* samples = (GArray*)g_hash_table_lookup(current,key);
+		if(!samples) {
+			samples = g_array_new(FALSE,FALSE,sizeof(gint64));
+			g_hash_table_insert(current,key,samples);
+		}
+		else g_free(key);
+		g_array_append_val(samples,res->latency_us);
+	}
+	
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	g_hash_table_iter_init(&iter,current);
+	
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		GArray* samples = (GArray*)g_hash_table_lookup(history,key);
+		if(!samples || samples->len < HISTORY_MIN_SAMPLES) continue;
+		
+		GArray* now = (GArray*)value;
+		g_array_sort(now,history_compare_latency);
+		gint64 latency = history_percentile(now,50);
+		
+		GArray* baseline = history_baseline(samples);
+		gint64 p50 = history_percentile(baseline,50);
+		gint64 p95 = history_percentile(baseline,95);
+		
+		// Median absolute deviation
+		GArray* deviations = g_array_sized_new(FALSE,FALSE,sizeof(gint64),baseline->len);
+		for(guint index = 0; index < baseline->len; index++) {
+			gint64 deviation = llabs(g_array_index(baseline,gint64,index) - p50);
+			g_array_append_val(deviations,deviation);
+		}
+		g_array_sort(deviations,history_compare_latency);
+		gint64 mad = history_percentile(deviations,50);
+		
+		// Stable endpoints have MAD of 0, scale has a floor to avoid flagging jitter
+		gdouble scale = MAX(1.4826 * mad,MAX(0.05 * p50,HISTORY_MIN_SCALE_US));
+		gdouble z = (latency - p50) / scale;
+		compared++;
+		
+		if(latency > p95 && z > HISTORY_Z_THRESHOLD) {
+			if(regressions == 0) {
+				g_print("Latency regressions compared to last %d runs:\n",HISTORY_WINDOW);
+				g_print("test\tid\tmethod\tpath\tp50 ms\tp95 ms\tnow ms\tz\n");
+				g_print("-------------------------------------------------------------------------------\n");
+			}
+			g_print(" %s\t%.1f\t%.1f\t%.1f\t%.1f\n",(gchar*)key,
+				p50 / 1000.0,p95 / 1000.0,latency / 1000.0,z);
+			regressions++;
+		}
+		
+		g_array_free(deviations,TRUE);
+		g_array_free(baseline,TRUE);
+	}
+	
+	if(compared > 0) g_print("%u of %u steps compared to history regressed\n\n",regressions,compared);
+	
+	g_hash_table_destroy(current);
+	if(loaded) g_hash_table_destroy(history);
+	return regressions;
+}
+
+/**
+* Get percentile of the latency of a step over the last runs and the
+* given latency of the current run. The last HISTORY_WINDOW - 1 samples
+* of history are used with the given latency. History loaded for the run
+* with history_load_run() is used.
+*
+* @param username User whose history is used
+* @param test Name of the test
+* @param id File id of the step
+* @param method Method of the step
+* @param path Path of the step in preferences
+* @param latency Latency of the current run in microseconds
+* @param percentile Percentile (0-100)
+*
+* @return Latency at percentile in microseconds, -1 if there are less than HISTORY_MIN_SAMPLES
+*/
+gint64 history_get_percentile(const gchar* username, const gchar* test, const gchar* id, 
+	const gchar* method, const gchar* path, gint64 latency, guint percentile) {
+	if(!username) return -1;
+	
+	gboolean loaded = FALSE;
+	GHashTable* history = history_get(username,&loaded);
+	gchar* key = history_make_key(test,id,method,path);
+	GArray* previous = (GArray*)g_hash_table_lookup(history,key);
+	GArray* samples = g_array_new(FALSE,FALSE,sizeof(gint64));
+	gint64 value = -1;
+	
+	if(previous) g_array_append_vals(samples,previous->data,previous->len);
+	
+	// Current run is the newest, the oldest is left out of the window
+	g_array_append_val(samples,latency);
+	
+	if(samples->len >= HISTORY_MIN_SAMPLES) {
+		GArray* baseline = history_baseline(samples);
+		value = history_percentile(baseline,percentile);
+		g_array_free(baseline,TRUE);
+	}
+	
+	g_array_free(samples,TRUE);
+	g_free(key);
+	if(loaded) g_hash_table_destroy(history);
+	return value;
+}
+
+/**
+* Compact the history by keeping only the lines of the last HISTORY_WINDOW
+* runs of each step, a step can have multiple lines in a run. Lines of
+* older format are dropped. History must be locked exclusively.
+*
+* @param path Path of the history
+*
+* @return TRUE when history was compacted
+*/
+static gboolean history_compact(const gchar* path) {
+	gchar* contents = NULL;
+	if(!g_file_get_contents(path,&contents,NULL,NULL)) return FALSE;
+	
+	gchar** lines = g_strsplit(contents,"\n",-1);
+	GHashTable* counts = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		NULL);
+	GHashTable* runs = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)g_free);
+	
+	// Keep lines of last HISTORY_WINDOW runs of each step, go from newest to oldest
+	gint length = g_strv_length(lines);
+	gboolean* keep = g_new0(gboolean,length);
+	
+	for(gint lineidx = length - 1; lineidx >= 0; lineidx--) {
+		gchar** fields = g_strsplit(lines[lineidx],"\t",HISTORY_FIELDS);
+		
+		if(g_strv_length(fields) == HISTORY_FIELDS) {
+			gchar* key = history_make_key(fields[1],fields[2],fields[3],fields[4]);
+			guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts,key));
+			
+			// Another run of the step
+			if(g_strcmp0(g_hash_table_lookup(runs,key),fields[0]) != 0) {
+				count++;
+				g_hash_table_replace(runs,g_strdup(key),g_strdup(fields[0]));
+			}
+			
+			if(count <= HISTORY_WINDOW) keep[lineidx] = TRUE;
+			g_hash_table_replace(counts,key,GUINT_TO_POINTER(count));
+		}
+		g_strfreev(fields);
+	}
+	
+	GString* compacted = g_string_new(NULL);
+	for(gint lineidx = 0; lineidx < length; lineidx++) 
+		if(keep[lineidx]) g_string_append_printf(compacted,"%s\n",lines[lineidx]);
+	
+	gboolean rval = g_file_set_contents(path,compacted->str,compacted->len,NULL);
+	if(!rval) g_print("Cannot compact history \"%s\"\n",path);
+	
+	g_string_free(compacted,TRUE);
+	g_free(keep);
+	g_strfreev(lines);
+	g_hash_table_destroy(runs);
+	g_hash_table_destroy(counts);
+	g_free(contents);
+	return rval;
+}
+
+/**
+* Append the results of the current run to the history of the user. All
+* attempts are stored with their outcome. Lines of the run are appended
+* under lock, so runs of concurrent processes (e.g. shards) are all kept.
+* History is compacted with history_compact() when it has grown over
+* HISTORY_COMPACT_SIZE.
+*
+* @param username User whose history is appended
+* @param results List of result_t of the current run
+*
+* @return TRUE when history was written
+*/
+gboolean history_append(const gchar* username, GSList* results) {
+	if(!username || !results) return FALSE;
+	
+	gchar* path = history_make_path(username);
+	GString* history = g_string_new(NULL);
+	gboolean rval = FALSE;
+	
+	// Start of appending identifies the run, also runs within the same second
+	gint64 run = g_get_real_time();
+	
+	// Current run as lines of history
+	for(GSList* iter = results; iter; iter = g_slist_next(iter)) {
+		result* res = (result*)iter->data;
+		if(!res->used) continue;
+		g_string_append_printf(history,"%" G_GINT64_FORMAT "\t%s\t%s\t%s\t%s\t%s\t%" G_GINT64_FORMAT "\n",
+			run,res->test,res->id,res->method,res->path,results_outcome_to_string(res->outcome),res->latency_us);
+	}
+	
+	gint lock = history_lock(username,LOCK_EX);
+	gint fd = lock >= 0 ? open(path,O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,0644) : -1;
+	
+	if(fd >= 0) {
+		gsize written = 0;
+		while(written < history->len) {
+			gssize count = write(fd,history->str + written,history->len - written);
+			if(count < 0 && errno == EINTR) continue;
+			if(count < 0) break;
+			written += count;
+		}
+		rval = written == history->len;
+		
+		off_t size = lseek(fd,0,SEEK_END);
+		close(fd);
+		
+		if(rval && size > HISTORY_COMPACT_SIZE) history_compact(path);
+	}
+	history_unlock(lock);
+	
+	if(!rval) g_print("Cannot save history to \"%s\"\n",path);
+	
+	g_string_free(history,TRUE);
+	g_free(path);
+	return rval;
+}
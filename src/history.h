@@ -0,0 +1,22 @@
+#ifndef __HISTORY_H_
+#define __HISTORY_H_
+
+#include "definitions.h"
+
+#define HISTORYFILE "history.tsv"
+#define HISTORYFILE_LOCK "history.lock"
+#define HISTORY_COMPACT_SIZE (512 * 1024)
+#define HISTORY_FIELDS 7
+#define HISTORY_WINDOW 30
+#define HISTORY_MIN_SAMPLES 5
+#define HISTORY_Z_THRESHOLD 3.5
+#define HISTORY_MIN_SCALE_US 1000
+
+void history_load_run(const gchar* username);
+void history_release_run();
+guint history_report_regressions(const gchar* username, GSList* results);
+gboolean history_append(const gchar* username, GSList* results);
+gint64 history_get_percentile(const gchar* username, const gchar* test, const gchar* id, 
+	const gchar* method, const gchar* path, gint64 latency, guint percentile);
+
+#endif
@@ -0,0 +1,254 @@
+#include "httpcache.h"
+#include "utils.h"
+#include <glib/gstdio.h>
+
+static gchar* cache_dir = NULL; // Folder of the cached replies, NULL when cache is disabled
+static gchar* cache_base = NULL; // Base URL of the test
+static GSList* cache_prefixes = NULL; // Paths under base URL that are cacheable (owned by testcase)
+static guint cache_hits = 0; // Fresh replies used without a request
+static guint cache_revalidated = 0; // Replies revalidated with 304 Not Modified
+static guint cache_misses = 0; // Cacheable requests that got a full reply
+
+/**
+* Configure the cache for a run. GETs to URLs starting with base and one
+* of the prefixes are cached to files in dir.
+*
+* @param dir Folder of the cache, NULL disables caching
+* @param base Base URL of the test
+* @param prefixes List of cacheable paths (not copied), NULL disables caching
+*/
+void httpcache_configure(const gchar* dir, const gchar* base, GSList* prefixes) {
+	httpcache_clear();
+	if(!dir || !base || !prefixes) return;
+	
+	if(g_mkdir_with_parents(dir,0700) != 0) {
+		g_print("Cannot create http cache folder \"%s\", caching disabled\n",dir);
+		return;
+	}
+	
+	cache_dir = g_strdup(dir);
+	cache_base = g_strdup(base);
+	cache_prefixes = prefixes;
+}
+
+/**
+* Check whether request can be cached.
+*
+* @param method Method of the request
+* @param url URL of the request
+*
+* @return TRUE when request is a GET to a cacheable path
+*/
+gboolean httpcache_is_cacheable(const gchar* method, const gchar* url) {
+	if(!cache_dir || !url || g_strcmp0(method,"GET") != 0) return FALSE;
+	if(!g_str_has_prefix(url,cache_base) || url[strlen(cache_base)] != '/') return FALSE;
+	
+	const gchar* path = &url[strlen(cache_base) + 1];
+	
+	for(GSList* iter = cache_prefixes; iter; iter = g_slist_next(iter))
+		if(g_str_has_prefix(path,(gchar*)iter->data)) return TRUE;
+	
+	return FALSE;
+}
+
+/**
+* Make path to a file of the cached reply of url.
+*
+* @param url URL of the request
+* @param suffix Suffix of the file, "meta" or "body"
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* httpcache_make_path(const gchar* url, const gchar* suffix) {
+	gchar* hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256,url,-1);
+	gchar* name = g_strjoin(".",hash,suffix,NULL);
+	gchar* path = g_strjoin("/",cache_dir,name,NULL);
+	g_free(hash);
+	g_free(name);
+	return path;
+}
+
+/**
+* Parse the directives of Cache-Control header that affect the cache:
+* max-age, no-cache and no-store. No-cache requires revalidation whatever
+* the max-age is, independent of the order of the directives.
+*
+* @param info Cache information to set
+* @param value Value of the header
+*/
+void httpcache_parse_cache_control(cache_info* info, const gchar* value) {
+	if(!info || !value) return;
+	
+	gchar** directives = g_strsplit(value,",",0);
+	
+	for(gint index = 0; directives[index]; index++) {
+		gchar* directive = g_strstrip(directives[index]);
+		
+		if(g_ascii_strncasecmp(directive,"max-age=",8) == 0) {
+			info->max_age = g_ascii_strtoll(&directive[8],NULL,10);
+			info->has_lifetime = TRUE;
+		}
+		else if(g_ascii_strcasecmp(directive,"no-cache") == 0) {
+			info->no_cache = TRUE;
+			info->has_lifetime = TRUE;
+		}
+		else if(g_ascii_strcasecmp(directive,"no-store") == 0) info->no_store = TRUE;
+	}
+	g_strfreev(directives);
+}
+
+/**
+* Write cache information of the reply of url with the time it was stored.
+*
+* @param url URL of the request
+* @param info Cache information of the reply
+* @param stored Real time in seconds when reply was received or revalidated
+*/
+static void httpcache_write_meta(const gchar* url, cache_info* info, gint64 stored) {
+	GKeyFile* meta = g_key_file_new();
+	
+	g_key_file_set_string(meta,"cache","url",url);
+	if(info->etag) g_key_file_set_string(meta,"cache","etag",info->etag);
+	if(info->last_modified) g_key_file_set_string(meta,"cache","last_modified",info->last_modified);
+	g_key_file_set_int64(meta,"cache","max_age",info->max_age);
+	g_key_file_set_boolean(meta,"cache","no_cache",info->no_cache);
+	g_key_file_set_int64(meta,"cache","stored",stored);
+	
+	gchar* path = httpcache_make_path(url,"meta");
+	if(!g_key_file_save_to_file(meta,path,NULL)) g_print("Cannot write http cache \"%s\"\n",path);
+	
+	g_free(path);
+	g_key_file_free(meta);
+}
+
+/**
+* Lookup the cached reply of url. The reply is fresh when it was stored
+* or revalidated less than max-age seconds ago and it had no no-cache.
+*
+* @param url URL of the request
+* @param fresh Set to TRUE when reply can be used without revalidation
+*
+* @return Newly allocated jsonreply_t with data and cache information or NULL if not cached
+*/
+jsonreply* httpcache_lookup(const gchar* url, gboolean* fresh) {
+	if(fresh) *fresh = FALSE;
+	if(!cache_dir || !url) return NULL;
+	
+	gchar* metapath = httpcache_make_path(url,"meta");
+	gchar* bodypath = httpcache_make_path(url,"body");
+	GKeyFile* meta = g_key_file_new();
+	jsonreply* cached = NULL;
+	
+	if(g_key_file_load_from_file(meta,metapath,G_KEY_FILE_NONE,NULL)) {
+		gchar* stored_url = g_key_file_get_string(meta,"cache","url",NULL);
+		
+		// Hash matches only the same url
+		if(g_strcmp0(stored_url,url) == 0) {
+			cached = jsonreply_initialize();
+			
+			if(g_file_get_contents(bodypath,&(cached->data),&(cached->length),NULL)) {
+				cached->size = cached->length;
+				cached->status = 200;
+				cached->outcome = OUTCOME_OK;
+				cached->cache.etag = g_key_file_get_string(meta,"cache","etag",NULL);
+				cached->cache.last_modified = g_key_file_get_string(meta,"cache","last_modified",NULL);
+				cached->cache.max_age = g_key_file_get_int64(meta,"cache","max_age",NULL);
+				cached->cache.no_cache = g_key_file_get_boolean(meta,"cache","no_cache",NULL);
+				
+				gint64 age = g_get_real_time() / G_USEC_PER_SEC - g_key_file_get_int64(meta,"cache","stored",NULL);
+				if(fresh) *fresh = !cached->cache.no_cache && age >= 0 && age < cached->cache.max_age;
+				
+				if(fresh && *fresh) cache_hits++;
+			}
+			else {
+				free_jsonreply(cached);
+				cached = NULL;
+			}
+		}
+		g_free(stored_url);
+	}
+	
+	g_key_file_free(meta);
+	g_free(metapath);
+	g_free(bodypath);
+	return cached;
+}
+
+/**
+* Use the cached reply for a 304 Not Modified reply. The data of cached
+* reply is moved to reply and its status is set to 200. Cache information
+* sent with 304 replaces the stored one and the reply is fresh again.
+*
+* @param url URL of the request
+* @param cached Cached reply, data is moved from it
+* @param reply Reply with status 304
+*/
+void httpcache_revalidated(const gchar* url, jsonreply* cached, jsonreply* reply) {
+	if(!cache_dir || !cached || !reply || reply->status != 304) return;
+	
+	g_free(reply->data);
+	reply->data = cached->data;
+	reply->length = cached->length;
+	reply->size = cached->size;
+	reply->status = 200;
+	cached->data = NULL;
+	
+	// Server may update the validators and lifetime
+	if(!reply->cache.etag) reply->cache.etag = g_strdup(cached->cache.etag);
+	if(!reply->cache.last_modified) reply->cache.last_modified = g_strdup(cached->cache.last_modified);
+	if(!reply->cache.has_lifetime) {
+		reply->cache.max_age = cached->cache.max_age;
+		reply->cache.no_cache = cached->cache.no_cache;
+	}
+	
+	httpcache_write_meta(url,&(reply->cache),g_get_real_time() / G_USEC_PER_SEC);
+	cache_revalidated++;
+}
+
+/**
+* Store a successful reply to cache unless server denied it with no-store.
+* Replies without a validator (ETag or Last-Modified) are stored only when
+* they have a lifetime.
+*
+* @param url URL of the request
+* @param reply Reply to store
+*/
+void httpcache_store(const gchar* url, jsonreply* reply) {
+	if(!cache_dir || !url || !reply) return;
+	
+	if(reply->outcome != OUTCOME_OK || reply->status != 200) return;
+	
+	cache_misses++;
+	
+	if(reply->cache.no_store) return;
+	if(!reply->cache.etag && !reply->cache.last_modified && (reply->cache.no_cache || reply->cache.max_age <= 0)) return;
+	
+	gchar* bodypath = httpcache_make_path(url,"body");
+	
+	if(g_file_set_contents(bodypath,reply->data ? reply->data : "",reply->length,NULL))
+		httpcache_write_meta(url,&(reply->cache),g_get_real_time() / G_USEC_PER_SEC);
+	else g_print("Cannot write http cache \"%s\"\n",bodypath);
+	
+	g_free(bodypath);
+}
+
+/**
+* Print the statistics of the http cache of the run.
+*/
+void httpcache_print_stats() {
+	if(!cache_dir) return;
+	g_print("Http cache: %u hits, %u revalidated (304), %u misses\n",
+		cache_hits,cache_revalidated,cache_misses);
+}
+
+/**
+* Disable the cache and clear its statistics.
+*/
+void httpcache_clear() {
+	g_free(cache_dir);
+	g_free(cache_base);
+	cache_dir = NULL;
+	cache_base = NULL;
+	cache_prefixes = NULL;
+	cache_hits = cache_revalidated = cache_misses = 0;
+}
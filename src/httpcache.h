@@ -0,0 +1,19 @@
+#ifndef __HTTPCACHE_H_
+#define __HTTPCACHE_H_
+
+#include "definitions.h"
+
+#define HTTPCACHEDIR ".httpcache"
+
+void httpcache_configure(const gchar* dir, const gchar* base, GSList* prefixes);
+gboolean httpcache_is_cacheable(const gchar* method, const gchar* url);
+
+jsonreply* httpcache_lookup(const gchar* url, gboolean* fresh);
+void httpcache_revalidated(const gchar* url, jsonreply* cached, jsonreply* reply);
+void httpcache_store(const gchar* url, jsonreply* reply);
+void httpcache_parse_cache_control(cache_info* info, const gchar* value);
+
+void httpcache_print_stats();
+void httpcache_clear();
+
+#endif
@@ -0,0 +1,263 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "httpengine.h"
+
+static CURLM* multi = NULL; // Multi handle driving all transfers
+static gint epollfd = -1; // Sockets of the transfers waited for with epoll
+static gint64 timer = -1; // Monotonic time curl wants to be called, -1 if not set
+static guint in_flight = 0; // Transfers submitted and not finished
+
+/**
+* Callback for curl to tell which events of a socket to wait for. Sockets
+* are added to epoll when first seen and removed when curl is done with them.
+*
+* @param easy Easy handle the socket is used by
+* @param sock Socket
+* @param what Events to wait for or CURL_POLL_REMOVE
+* @param userp Not used
+* @param socketp NULL until socket is added to epoll
+*
+* @return 0
+*/
+static gint httpengine_socket_callback(CURL* easy, curl_socket_t sock, gint what, gpointer userp, gpointer socketp) {
+	struct epoll_event event = { 0 };
+	event.data.fd = sock;
+	
+	if(what == CURL_POLL_REMOVE) {
+		epoll_ctl(epollfd, EPOLL_CTL_DEL, sock, NULL);
+		return 0;
+	}
+	
+	if(what & CURL_POLL_IN) event.events |= EPOLLIN;
+	if(what & CURL_POLL_OUT) event.events |= EPOLLOUT;
+	
+	if(socketp) epoll_ctl(epollfd, EPOLL_CTL_MOD, sock, &event);
+	else if(epoll_ctl(epollfd, EPOLL_CTL_ADD, sock, &event) == 0) 
+		curl_multi_assign(multi, sock, GINT_TO_POINTER(1));
+	
+	return 0;
+}
+
+/**
+* Callback for curl to set the time when it must be called even if there
+* are no events.
+*
+* @param handle Multi handle
+* @param timeout_ms Time to wait, -1 removes the timer
+* @param userp Not used
+*
+* @return 0
+*/
+static gint httpengine_timer_callback(CURLM* handle, long timeout_ms, gpointer userp) {
+	timer = timeout_ms < 0 ? -1 : g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+	return 0;
+}
+
+/**
+* Raise the limit of open files to the hard limit so that the amount of
+* concurrent transfers is not limited by it.
+*/
+static void httpengine_raise_fd_limit() {
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= limit.rlim_max) return;
+	limit.rlim_cur = limit.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+/**
+* Initialize the engine once, called when the first transfer is submitted.
+*
+* @return TRUE when engine is ready
+*/
+static gboolean httpengine_init() {
+	if(multi) return TRUE;
+	
+	epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if(epollfd < 0) {
+		g_print("Cannot create epoll instance for http engine\n");
+		return FALSE;
+	}
+	
+	multi = curl_multi_init();
+	if(!multi) {
+		close(epollfd);
+		epollfd = -1;
+		return FALSE;
+	}
+	
+	curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, httpengine_socket_callback);
+	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, httpengine_timer_callback);
+	
+	httpengine_raise_fd_limit();
+	return TRUE;
+}
+
+/**
+* Submit a transfer set up in easy handle. The transfer progresses when
+* httpengine_run() is called and done is called from it when the transfer
+* has finished. Transfer must be released with httpengine_remove().
+*
+* @param handle Easy handle set up for the transfer
+* @param done Called when transfer has finished, can be NULL
+* @param userp Data for done
+*
+* @return Newly allocated http_transfer_t or NULL if transfer cannot be submitted
+*/
+http_transfer* httpengine_submit(CURL* handle, transfer_done done, gpointer userp) {
+	if(!handle || !httpengine_init()) return NULL;
+	
+	http_transfer* transfer = g_new0(struct http_transfer_t,1);
+	transfer->handle = handle;
+	transfer->done = done;
+	transfer->userp = userp;
+	
+	curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+	
+	if(curl_multi_add_handle(multi, handle) != CURLM_OK) {
+		g_free(transfer);
+		return NULL;
+	}
+	in_flight++;
+	return transfer;
+}
+
+/**
+* Finish the transfers curl reports done. Handles are removed from the
+* multi handle before done is called so they can be reused or submitted
+* again from done.
+*
+* @return Amount of finished transfers
+*/
+static guint httpengine_finish() {
+	CURLMsg* msg = NULL;
+	gint queued = 0;
+	guint finished = 0;
+	
+	while((msg = curl_multi_info_read(multi, &queued))) {
+		if(msg->msg != CURLMSG_DONE) continue;
+		
+		CURL* handle = msg->easy_handle;
+		CURLcode result = msg->data.result;
+		http_transfer* transfer = NULL;
+		curl_easy_getinfo(handle, CURLINFO_PRIVATE, (gchar**)&transfer);
+		
+		curl_multi_remove_handle(multi, handle);
+		in_flight--;
+		finished++;
+		
+		if(!transfer) continue;
+		transfer->finished = TRUE;
+		transfer->result = result;
+		if(transfer->done) transfer->done(transfer,transfer->userp);
+	}
+	return finished;
+}
+
+/**
+* Wait for events of the sockets of the transfers for at most timeout and
+* let curl handle them. Sockets with events are handled in batches of
+* HTTPENGINE_EVENTS, only the sockets with events are processed.
+*
+* @param timeout_ms Maximum time to wait, 0 does not wait and -1 waits until
+* there is an event or curl needs to be called
+*
+* @return Amount of transfers that finished
+*/
+guint httpengine_run(gint timeout_ms) {
+	if(!multi) return 0;
+	
+	struct epoll_event events[HTTPENGINE_EVENTS];
+	gint running = 0;
+	gint wait = timeout_ms;
+	
+	// Wake up for the timer of curl
+	if(timer >= 0) {
+		gint64 left = (timer - g_get_monotonic_time() + 999) / 1000;
+		if(left < 0) left = 0;
+		if(wait < 0 || left < wait) wait = (gint)left;
+	}
+	
+	// Nothing would wake up
+	if(in_flight == 0 && timer < 0 && wait < 0) return 0;
+	
+	gint count = epoll_wait(epollfd, events, HTTPENGINE_EVENTS, wait);
+	
+	for(gint index = 0; index < count; index++) {
+		gint action = 0;
+		if(events[index].events & EPOLLIN) action |= CURL_CSELECT_IN;
+		if(events[index].events & EPOLLOUT) action |= CURL_CSELECT_OUT;
+		if(events[index].events & (EPOLLERR | EPOLLHUP)) action |= CURL_CSELECT_ERR;
+		curl_multi_socket_action(multi, events[index].data.fd, action, &running);
+	}
+	
+	if(timer >= 0 && g_get_monotonic_time() >= timer) {
+		timer = -1;
+		curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+	}
+	
+	return httpengine_finish();
+}
+
+/**
+* Run the engine until transfer has finished. Other transfers progress
+* while waiting.
+*
+* @param transfer Transfer to wait for
+* @param until Monotonic time to stop waiting at, 0 waits until finished
+*
+* @return TRUE when transfer has finished
+*/
+gboolean httpengine_wait(http_transfer* transfer, gint64 until) {
+	if(!transfer) return FALSE;
+	
+	while(!transfer->finished) {
+		gint timeout = -1;
+		
+		if(until > 0) {
+			gint64 left = until - g_get_monotonic_time();
+			if(left <= 0) break;
+			timeout = (gint)MAX(1,(left + 999) / 1000);
+		}
+		httpengine_run(timeout);
+	}
+	return transfer->finished;
+}
+
+/**
+* Release a transfer. Transfer that has not finished is cancelled and
+* done is not called for it.
+*
+* @param transfer Transfer to release
+*/
+void httpengine_remove(http_transfer* transfer) {
+	if(!transfer) return;
+	
+	if(!transfer->finished && multi) {
+		curl_multi_remove_handle(multi, (CURL*)transfer->handle);
+		in_flight--;
+	}
+	curl_easy_setopt((CURL*)transfer->handle, CURLOPT_PRIVATE, NULL);
+	g_free(transfer);
+}
+
+/**
+* Get the amount of transfers in flight.
+*
+* @return Transfers submitted and not finished
+*/
+guint httpengine_in_flight() {
+	return in_flight;
+}
+
+/**
+* Close the engine. Transfers must have been removed before.
+*/
+void httpengine_close() {
+	if(multi) curl_multi_cleanup(multi);
+	if(epollfd >= 0) close(epollfd);
+	multi = NULL;
+	epollfd = -1;
+	timer = -1;
+	in_flight = 0;
+}
@@ -0,0 +1,16 @@
+#ifndef __HTTPENGINE_H_
+#define __HTTPENGINE_H_
+
+#include <curl/curl.h>
+#include "definitions.h"
+
+#define HTTPENGINE_EVENTS 256
+
+http_transfer* httpengine_submit(CURL* handle, transfer_done done, gpointer userp);
+guint httpengine_run(gint timeout_ms);
+gboolean httpengine_wait(http_transfer* transfer, gint64 until);
+void httpengine_remove(http_transfer* transfer);
+guint httpengine_in_flight();
+void httpengine_close();
+
+#endif
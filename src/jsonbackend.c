@@ -0,0 +1,955 @@
+#include "jsonbackend.h"
+#include "jsonutils.h"
+#include "jsonpath.h"
+#include "arena.h"
+#include "connectionutils.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static gboolean ondemand_validate(jsonreply* reply);
+static gchar* ondemand_get_string(jsonpath* path, jsonreply* reply, arena* ar);
+
+/**
+* Check that the data of the reply is valid by parsing it with json-glib.
+* The parsed json is kept in the reply for later use. Large replies are
+* checked on demand instead, see jsonbackend_is_large().
+*
+* @param reply Reply to check
+*
+* @return TRUE when data is valid json
+*/
+static gboolean glib_validate(jsonreply* reply) {
+	if(jsonbackend_is_large(reply)) return ondemand_validate(reply);
+	return jsonreply_get_root(reply) != NULL;
+}
+
+/**
+* Evaluate path over the json of the reply parsed with json-glib. Large
+* replies are searched on demand instead, see jsonbackend_is_large().
+*
+* @param path Compiled path
+* @param reply Reply to search
+* @param ar Arena to allocate from, when NULL value must be free'd with g_free()
+*
+* @return Value or NULL if not found or not a value
+*/
+static gchar* glib_get_string(jsonpath* path, jsonreply* reply, arena* ar) {
+	if(jsonbackend_is_large(reply)) return ondemand_get_string(path,reply,ar);
+	return jsonpath_get_string(path,jsonreply_get_root(reply),ar);
+}
+
+/**
+* Skip json whitespace.
+*
+* @param p Position in data
+* @param end End of data
+*
+* @return Position of the first character not being whitespace
+*/
+static const gchar* ondemand_skip_space(const gchar* p, const gchar* end) {
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+	return p;
+}
+
+/**
+* Find the next character ending the plain part of a string: quote,
+* backslash or a control character. With SSE2 16 characters are
+* checked at once.
+*
+* @param p Position within string
+* @param end End of data
+*
+* @return Position of the character or end when not found
+*/
+static const gchar* ondemand_find_string_end(const gchar* p, const gchar* end) {
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i escape = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1f);
+	
+	while(end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk,quote),_mm_cmpeq_epi8(chunk,escape));
+		
+		// Character is a control character when min(c,0x1f) == c (unsigned)
+		found = _mm_or_si128(found,_mm_cmpeq_epi8(_mm_min_epu8(chunk,control),chunk));
+		
+		gint mask = _mm_movemask_epi8(found);
+		if(mask) return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	while(p < end && *p != '"' && *p != '\\' && (guchar)*p >= 0x20) p++;
+	return p;
+}
+
+/**
+* Find the next quote or bracket. Brackets are found by setting bit 0x20,
+* which turns '[' and ']' to '{' and '}'. With SSE2 16 characters are
+* checked at once.
+*
+* @param p Position in data
+* @param end End of data
+*
+* @return Position of the character or end when not found
+*/
+static const gchar* ondemand_find_structural(const gchar* p, const gchar* end) {
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i close = _mm_set1_epi8('}');
+	const __m128i bit = _mm_set1_epi8(0x20);
+	
+	while(end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i folded = _mm_or_si128(chunk,bit);
+		__m128i found = _mm_or_si128(_mm_cmpeq_epi8(folded,open),_mm_cmpeq_epi8(folded,close));
+		found = _mm_or_si128(found,_mm_cmpeq_epi8(chunk,quote));
+		
+		gint mask = _mm_movemask_epi8(found);
+		if(mask) return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	while(p < end && *p != '"' && (*p | 0x20) != '{' && (*p | 0x20) != '}') p++;
+	return p;
+}
+
+/**
+* Check that the plain part of a string is valid UTF-8. ASCII is skipped
+* first, with SSE2 16 characters at once, and only the rest is validated.
+*
+* @param p Start of the plain part
+* @param end End of the plain part
+*
+* @return TRUE when the part is valid UTF-8
+*/
+static gboolean ondemand_check_utf8(const gchar* p, const gchar* end) {
+#ifdef __SSE2__
+	while(end - p >= 16 && !_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p))) p += 16;
+#endif
+	while(p < end && (guchar)*p < 0x80) p++;
+	return p == end || g_utf8_validate(p,end - p,NULL);
+}
+
+/**
+* Check a string, escapes must be valid, control characters are not
+* allowed and the characters must be valid UTF-8.
+*
+* @param p Position of the opening quote
+* @param end End of data
+*
+* @return Position after the closing quote or NULL if not valid
+*/
+static const gchar* ondemand_check_string(const gchar* p, const gchar* end) {
+	const gchar* plain = ++p;
+	
+	while((p = ondemand_find_string_end(p,end)) < end) {
+		if(!ondemand_check_utf8(plain,p)) return NULL;
+		if(*p == '"') return p + 1;
+		if(*p != '\\' || p + 1 >= end) return NULL;
+		
+		switch(p[1]) {
+			case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+				p += 2;
+				break;
+			case 'u':
+				if(end - p < 6) return NULL;
+				for(gint index = 2; index < 6; index++) if(!g_ascii_isxdigit(p[index])) return NULL;
+				p += 6;
+				break;
+			default:
+				return NULL;
+		}
+		plain = p;
+	}
+	return NULL;
+}
+
+/**
+* Check a number.
+*
+* @param p Position of the number
+* @param end End of data
+*
+* @return Position after the number or NULL if not valid
+*/
+static const gchar* ondemand_check_number(const gchar* p, const gchar* end) {
+	if(p < end && *p == '-') p++;
+	
+	if(p < end && *p == '0') p++;
+	else if(p < end && g_ascii_isdigit(*p)) while(p < end && g_ascii_isdigit(*p)) p++;
+	else return NULL;
+	
+	if(p < end && *p == '.') {
+		const gchar* digits = ++p;
+		while(p < end && g_ascii_isdigit(*p)) p++;
+		if(p == digits) return NULL;
+	}
+	
+	if(p < end && (*p == 'e' || *p == 'E')) {
+		if(++p < end && (*p == '+' || *p == '-')) p++;
+		const gchar* digits = p;
+		while(p < end && g_ascii_isdigit(*p)) p++;
+		if(p == digits) return NULL;
+	}
+	return p;
+}
+
+/**
+* Check a literal true, false or null.
+*
+* @param p Position of the literal
+* @param end End of data
+* @param literal Expected literal
+*
+* @return Position after the literal or NULL if not valid
+*/
+static const gchar* ondemand_check_literal(const gchar* p, const gchar* end, const gchar* literal) {
+	gsize length = strlen(literal);
+	if(end - p < length || memcmp(p,literal,length) != 0) return NULL;
+	return p + length;
+}
+
+/**
+* Check a value and all values within it.
+*
+* @param p Position of the value
+* @param end End of data
+* @param depth Depth of the value, limited to JSONBACKEND_MAX_DEPTH
+*
+* @return Position after the value or NULL if not valid
+*/
+static const gchar* ondemand_check_value(const gchar* p, const gchar* end, guint depth) {
+	if(p >= end) return NULL;
+	
+	switch(*p) {
+		case '"':
+			return ondemand_check_string(p,end);
+		case '{':
+		case '[': {
+			if(depth >= JSONBACKEND_MAX_DEPTH) return NULL;
+			
+			gboolean object = *p == '{';
+			gchar close = object ? '}' : ']';
+			
+			p = ondemand_skip_space(p + 1,end);
+			if(p < end && *p == close) return p + 1;
+			
+			while(p < end) {
+				// Member name of object
+				if(object) {
+					if(*p != '"' || !(p = ondemand_check_string(p,end))) return NULL;
+					p = ondemand_skip_space(p,end);
+					if(p >= end || *p != ':') return NULL;
+					p = ondemand_skip_space(p + 1,end);
+				}
+				
+				if(!(p = ondemand_check_value(p,end,depth + 1))) return NULL;
+				
+				p = ondemand_skip_space(p,end);
+				if(p < end && *p == close) return p + 1;
+				if(p >= end || *p != ',') return NULL;
+				p = ondemand_skip_space(p + 1,end);
+			}
+			return NULL;
+		}
+		case 't':
+			return ondemand_check_literal(p,end,"true");
+		case 'f':
+			return ondemand_check_literal(p,end,"false");
+		case 'n':
+			return ondemand_check_literal(p,end,"null");
+		default:
+			return ondemand_check_number(p,end);
+	}
+}
+
+/**
+* Check that the data of the reply is valid json. Data is checked once,
+* the result is kept in the reply until data is changed. Searching values
+* relies on this, they skip values by the quotes and brackets only.
+*
+* @param reply Reply to check
+*
+* @return TRUE when data is valid json
+*/
+static gboolean ondemand_validate(jsonreply* reply) {
+	if(!reply || !reply->data) return FALSE;
+	
+	if(reply->checked == 0) {
+		const gchar* end = reply->data + reply->length;
+		const gchar* p = ondemand_check_value(ondemand_skip_space(reply->data,end),end,0);
+		
+		if(p) p = ondemand_skip_space(p,end);
+		reply->checked = p == end ? 1 : -1;
+	}
+	return reply->checked > 0;
+}
+
+/**
+* Skip a string of checked data.
+*
+* @param p Position of the opening quote
+* @param end End of data
+*
+* @return Position after the closing quote
+*/
+static const gchar* ondemand_skip_string(const gchar* p, const gchar* end) {
+	p++;
+	while((p = ondemand_find_string_end(p,end)) < end) {
+		if(*p == '"') return p + 1;
+		p += 2;
+	}
+	return end;
+}
+
+/**
+* Skip a value of checked data. Objects and arrays are skipped by
+* counting the brackets outside strings.
+*
+* @param p Position of the value
+* @param end End of data
+*
+* @return Position after the value
+*/
+static const gchar* ondemand_skip(const gchar* p, const gchar* end) {
+	if(p >= end) return end;
+	
+	if(*p == '"') return ondemand_skip_string(p,end);
+	
+	if(*p == '{' || *p == '[') {
+		gint depth = 0;
+		
+		while((p = ondemand_find_structural(p,end)) < end) {
+			if(*p == '"') p = ondemand_skip_string(p,end);
+			else {
+				depth += (*p | 0x20) == '{' ? 1 : -1;
+				p++;
+				if(depth == 0) return p;
+			}
+		}
+		return end;
+	}
+	
+	// Number or literal
+	while(p < end && *p != ',' && *p != '}' && *p != ']' && !g_ascii_isspace(*p)) p++;
+	return p;
+}
+
+/**
+* Get the first element of an array or the name of the first member of
+* an object.
+*
+* @param p Position of the opening bracket
+* @param end End of data
+*
+* @return Position of the element or NULL if empty
+*/
+static const gchar* ondemand_first(const gchar* p, const gchar* end) {
+	p = ondemand_skip_space(p + 1,end);
+	return p < end && *p != '}' && *p != ']' ? p : NULL;
+}
+
+/**
+* Get the next element of an array or the name of the next member of an
+* object.
+*
+* @param p Position of the current element or member value
+* @param end End of data
+*
+* @return Position of the next element or NULL if this was the last
+*/
+static const gchar* ondemand_next(const gchar* p, const gchar* end) {
+	p = ondemand_skip_space(ondemand_skip(p,end),end);
+	return p < end && *p == ',' ? ondemand_skip_space(p + 1,end) : NULL;
+}
+
+/**
+* Get the value of a member.
+*
+* @param name Position of the member name
+* @param end End of data
+*
+* @return Position of the value
+*/
+static const gchar* ondemand_member_value(const gchar* name, const gchar* end) {
+	const gchar* p = ondemand_skip_space(ondemand_skip_string(name,end),end);
+	return ondemand_skip_space(p + 1,end);
+}
+
+/**
+* Get the value of four hex digits.
+*
+* @param p Position of the digits
+*
+* @return Value of the digits
+*/
+static gunichar ondemand_hex(const gchar* p) {
+	gunichar value = 0;
+	for(gint index = 0; index < 4; index++) value = (value << 4) | g_ascii_xdigit_value(p[index]);
+	return value;
+}
+
+/**
+* Get the contents of a string with escapes replaced. Escaped surrogate
+* pairs are combined. Unescaped string is never longer than the escaped
+* one, it is written to a single allocation of that size.
+*
+* @param p Position of the opening quote
+* @param end End of data
+* @param ar Arena to allocate from, when NULL string must be free'd with g_free()
+*
+* @return String
+*/
+static gchar* ondemand_unescape(const gchar* p, const gchar* end, arena* ar) {
+	const gchar* close = ondemand_skip_string(p,end) - 1;
+	gchar* value = (gchar*)arena_alloc(ar,close - p);
+	gchar* pos = value;
+	
+	for(p++; p < close; p++) {
+		const gchar* plain = p;
+		p = ondemand_find_string_end(p,close);
+		memcpy(pos,plain,p - plain);
+		pos += p - plain;
+		if(p >= close) break;
+		
+		switch(*++p) {
+			case 'b': *pos++ = '\b'; break;
+			case 'f': *pos++ = '\f'; break;
+			case 'n': *pos++ = '\n'; break;
+			case 'r': *pos++ = '\r'; break;
+			case 't': *pos++ = '\t'; break;
+			case 'u': {
+				gunichar c = ondemand_hex(p + 1);
+				p += 4;
+				
+				if(c >= 0xd800 && c < 0xdc00 && close - p > 6 && p[1] == '\\' && p[2] == 'u') {
+					gunichar low = ondemand_hex(p + 3);
+					if(low >= 0xdc00 && low < 0xe000) {
+						c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+						p += 6;
+					}
+				}
+				pos += g_unichar_to_utf8(c,pos);
+				break;
+			}
+			default:
+				*pos++ = *p;
+				break;
+		}
+	}
+	*pos = '\0';
+	return value;
+}
+
+/**
+* Compare a member name to a name, the member name is unescaped only
+* when it contains escapes.
+*
+* @param p Position of the member name
+* @param end End of data
+* @param name Name to compare to
+*
+* @return TRUE when names are equal
+*/
+static gboolean ondemand_name_equals(const gchar* p, const gchar* end, const gchar* name) {
+	gsize length = ondemand_skip_string(p,end) - p - 2;
+	
+	if(!memchr(p + 1,'\\',length)) return length == strlen(name) && memcmp(p + 1,name,length) == 0;
+	
+	gchar* unescaped = ondemand_unescape(p,end,NULL);
+	gboolean equal = g_strcmp0(unescaped,name) == 0;
+	g_free(unescaped);
+	return equal;
+}
+
+/**
+* Get a value as string, converted as json-glib values are converted
+* by jsonpath_get_string().
+*
+* @param p Position of the value, can be NULL
+* @param end End of data
+* @param ar Arena to allocate from, when NULL string must be free'd with g_free()
+*
+* @return String or NULL if not a value
+*/
+static gchar* ondemand_to_string(const gchar* p, const gchar* end, arena* ar) {
+	if(!p) return NULL;
+	
+	switch(*p) {
+		case '"':
+			return ondemand_unescape(p,end,ar);
+		case 't':
+			return arena_strdup(ar,"true");
+		case 'f':
+			return arena_strdup(ar,"false");
+		case 'n':
+		case '{':
+		case '[':
+			return NULL;
+	}
+	
+	// Number is terminated for conversion in a copy, on stack unless very long
+	gchar shortnumber[JSONBACKEND_NUMBER_SIZE];
+	gsize length = ondemand_skip(p,end) - p;
+	gchar* number = length < sizeof(shortnumber) ? shortnumber : (gchar*)g_malloc(length + 1);
+	gchar* value = NULL;
+	
+	memcpy(number,p,length);
+	number[length] = '\0';
+	
+	if(strpbrk(number,".eE")) {
+		gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+		value = arena_strdup(ar,g_ascii_dtostr(buffer,sizeof(buffer),g_ascii_strtod(number,NULL)));
+	}
+	else value = arena_strdup_printf(ar,"%" G_GINT64_FORMAT,g_ascii_strtoll(number,NULL,10));
+	
+	if(number != shortnumber) g_free(number);
+	return value;
+}
+
+/**
+* Match the steps of path starting from given step to the value at p.
+* Works as jsonpath_match() but over checked data: values not on the
+* path are skipped without building them.
+*
+* @param path Path to match
+* @param stepidx Index of the step to match
+* @param p Position of the value, can be NULL
+* @param end End of data
+*
+* @return Position of the matching value or NULL
+*/
+static const gchar* ondemand_match(jsonpath* path, guint stepidx, const gchar* p, const gchar* end) {
+	if(!p) return NULL;
+	if(stepidx == path->steps->len) return p;
+	
+	jsonpath_step* step = &g_array_index(path->steps,jsonpath_step,stepidx);
+	const gchar* match = NULL;
+	
+	if(*p == '[') {
+		switch(step->op) {
+			// Member or filter step on array is applied to each element
+			case JSONPATH_MEMBER:
+			case JSONPATH_FILTER:
+				for(const gchar* element = ondemand_first(p,end); element && !match; element = ondemand_next(element,end))
+					match = ondemand_match(path,stepidx,element,end);
+				break;
+			case JSONPATH_WILDCARD:
+				for(const gchar* element = ondemand_first(p,end); element && !match; element = ondemand_next(element,end))
+					match = ondemand_match(path,stepidx + 1,element,end);
+				break;
+			case JSONPATH_INDEX: {
+				gint index = step->index;
+				
+				if(index < 0) {
+					for(const gchar* element = ondemand_first(p,end); element; element = ondemand_next(element,end))
+						index++;
+				}
+				
+				const gchar* element = index >= 0 ? ondemand_first(p,end) : NULL;
+				for(; element && index > 0; index--) element = ondemand_next(element,end);
+				match = ondemand_match(path,stepidx + 1,element,end);
+				break;
+			}
+		}
+	}
+	else if(*p == '{') {
+		const gchar* found = NULL;
+		gchar* value = NULL;
+		
+		switch(step->op) {
+			// Last member with the name is used, as with json-glib
+			case JSONPATH_MEMBER:
+				for(const gchar* name = ondemand_first(p,end); name; ) {
+					const gchar* member = ondemand_member_value(name,end);
+					if(ondemand_name_equals(name,end,step->name)) found = member;
+					name = ondemand_next(member,end);
+				}
+				match = ondemand_match(path,stepidx + 1,found,end);
+				break;
+			case JSONPATH_WILDCARD:
+				for(const gchar* name = ondemand_first(p,end); name && !match; ) {
+					const gchar* member = ondemand_member_value(name,end);
+					match = ondemand_match(path,stepidx + 1,member,end);
+					name = ondemand_next(member,end);
+				}
+				break;
+			case JSONPATH_FILTER:
+				value = ondemand_to_string(ondemand_match(step->filter,0,p,end),end,NULL);
+				if(g_strcmp0(value,step->value) == 0) match = ondemand_match(path,stepidx + 1,p,end);
+				g_free(value);
+				break;
+			case JSONPATH_INDEX:
+				break;
+		}
+	}
+	return match;
+}
+
+/**
+* Evaluate path over the data of the reply without parsing it. Data is
+* checked once and values are searched directly from it.
+*
+* @param path Compiled path
+* @param reply Reply to search
+* @param ar Arena to allocate from, when NULL value must be free'd with g_free()
+*
+* @return Value or NULL if not found or not a value
+*/
+static gchar* ondemand_get_string(jsonpath* path, jsonreply* reply, arena* ar) {
+	if(!path || !ondemand_validate(reply)) return NULL;
+	
+	const gchar* end = reply->data + reply->length;
+	return ondemand_to_string(ondemand_match(path,0,ondemand_skip_space(reply->data,end),end),end,ar);
+}
+
+static const json_backend backends[] = {
+	{ "glib", glib_validate, glib_get_string },
+	{ "ondemand", ondemand_validate, ondemand_get_string }
+};
+
+static const json_backend* selected = &backends[0]; // Backend used for searching values
+
+/**
+* Select the backend used for searching values from replies.
+*
+* @param name Name of the backend, "glib" or "ondemand"
+*
+* @return TRUE when backend was found
+*/
+gboolean jsonbackend_select(const gchar* name) {
+	for(guint index = 0; index < G_N_ELEMENTS(backends); index++) {
+		if(g_strcmp0(backends[index].name,name) == 0) {
+			selected = &backends[index];
+			return TRUE;
+		}
+	}
+	g_print("Unknown json backend \"%s\", use glib or ondemand\n",name);
+	return FALSE;
+}
+
+/**
+* Check whether the reply is too large for a json-glib tree. Replies over
+* HTTP_REPLY_SPILL_SIZE were spilled to a file to cap the memory use, a
+* tree of them would take several times their size. These are validated
+* and searched on demand with every backend.
+*
+* @param reply Reply to check
+*
+* @return TRUE when reply is over HTTP_REPLY_SPILL_SIZE
+*/
+gboolean jsonbackend_is_large(jsonreply* reply) {
+	return reply && reply->length > HTTP_REPLY_SPILL_SIZE;
+}
+
+/**
+* Check that the data of the reply is valid json with the selected backend.
+*
+* @param reply Reply to check
+*
+* @return TRUE when data is valid json
+*/
+gboolean jsonbackend_validate(jsonreply* reply) {
+	return selected->validate(reply);
+}
+
+/**
+* Evaluate path over the reply with the selected backend. Integers,
+* doubles and booleans are converted to strings.
+*
+* @param path Compiled path
+* @param reply Reply to search, can be NULL
+* @param ar Arena to allocate the value from, when NULL value must be free'd with g_free()
+*
+* @return Value or NULL if not found or not a value
+*/
+gchar* jsonbackend_get_string(jsonpath* path, jsonreply* reply, arena* ar) {
+	if(!path || !reply) return NULL;
+	return selected->get_string(path,reply,ar);
+}
+
+/**
+* Free values found by a backend.
+*
+* @param values Values to free
+* @param count Amount of values, some may be NULL
+*/
+static void jsonbackend_free_values(gchar** values, guint count) {
+	for(guint index = 0; values && index < count; index++) g_free(values[index]);
+	g_free(values);
+}
+
+/**
+* Count the heap allocations of evaluating the paths over data once with
+* a backend. Values are allocated from arena or from heap and free'd.
+*
+* @param backend Backend to use
+* @param paths Compiled paths
+* @param data Json data
+* @param length Length of data
+* @param ar Arena to allocate the values from, NULL uses heap
+* @param count Where to store the amount of allocations
+*
+* @return FALSE when allocations are not counted
+*/
+static gboolean jsonbackend_count_allocations(const json_backend* backend, GPtrArray* paths,
+	gchar* data, gsize length, arena* ar, guint64* count) {
+	guint64 before = 0, after = 0;
+	jsonreply reply = { 0 };
+	reply.data = data;
+	reply.length = length;
+	reply.spill_fd = -1;
+	
+	if(!arena_heap_allocations(&before)) return FALSE;
+	
+	for(guint index = 0; index < paths->len; index++) {
+		gchar* value = backend->get_string((jsonpath*)g_ptr_array_index(paths,index),&reply,ar);
+		if(!ar) g_free(value);
+	}
+	jsonreply_clear_root(&reply);
+	arena_reset(ar);
+	
+	arena_heap_allocations(&after);
+	*count = after - before;
+	return TRUE;
+}
+
+/**
+* Time evaluating the paths over the json of a file with each backend.
+* Each round starts from unparsed data as when a reply arrives, parsing
+* or checking is included in the time. Values found by the backends are
+* compared to the values of the first backend. When built with ALLOC_STATS
+* the heap allocations of a round are counted with values allocated from
+* heap and from an arena.
+*
+* @param file File containing the json
+* @param expressions NULL terminated array of path expressions
+*
+* @return TRUE when all backends found identical values
+*/
+gboolean jsonbackend_bench(const gchar* file, gchar** expressions) {
+	gchar* data = NULL;
+	gsize length = 0;
+	GError* error = NULL;
+	
+	if(!g_file_get_contents(file,&data,&length,&error)) {
+		g_print("Cannot read \"%s\". Reason: %s\n",file,error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+	
+	GPtrArray* paths = g_ptr_array_new_with_free_func(free_jsonpath);
+	for(gint index = 0; expressions && expressions[index]; index++) {
+		jsonpath* path = jsonpath_compile(expressions[index]);
+		if(path) g_ptr_array_add(paths,path);
+	}
+	
+	gboolean identical = TRUE;
+	gboolean first_valid = FALSE;
+	gchar** first = NULL;
+	gint64 first_elapsed = 0;
+	
+	// Backends must agree on the validity of the data
+	for(guint backend = 0; backend < G_N_ELEMENTS(backends); backend++) {
+		jsonreply reply = { 0 };
+		reply.data = data;
+		reply.length = length;
+		reply.spill_fd = -1;
+		
+		gboolean valid = backends[backend].validate(&reply);
+		if(backend > 0 && valid != first_valid) {
+			g_print("Validity differs: %s with %s, %s with %s\n",
+				first_valid ? "valid" : "invalid",backends[0].name,
+				valid ? "valid" : "invalid",backends[backend].name);
+			identical = FALSE;
+		}
+		if(backend == 0) first_valid = valid;
+		jsonreply_clear_root(&reply);
+	}
+	
+	// Nothing to search from data that is not valid
+	if(!identical || !first_valid) {
+		g_print("%s: %" G_GSIZE_FORMAT " bytes, %s\n",file,length,
+			identical ? "not valid with any backend" : "validity of the backends differs");
+		g_ptr_array_free(paths,TRUE);
+		g_free(data);
+		return identical;
+	}
+	
+	g_print("%s: %" G_GSIZE_FORMAT " bytes, %u paths, %u rounds\n",file,length,paths->len,JSONBACKEND_BENCH_ROUNDS);
+	g_print("backend\tus/round\trelative\tfound\theap allocations/round\twith arena\n");
+	
+	arena* ar = arena_new(ARENA_STEP_BLOCK_SIZE);
+	
+	for(guint backend = 0; backend < G_N_ELEMENTS(backends); backend++) {
+		gchar** values = g_new0(gchar*,paths->len);
+		gint64 start = g_get_monotonic_time();
+		
+		for(guint round = 0; round < JSONBACKEND_BENCH_ROUNDS; round++) {
+			jsonreply reply = { 0 };
+			reply.data = data;
+			reply.length = length;
+			reply.spill_fd = -1;
+			
+			for(guint index = 0; index < paths->len; index++) {
+				g_free(values[index]);
+				values[index] = backends[backend].get_string((jsonpath*)g_ptr_array_index(paths,index),&reply,NULL);
+			}
+			jsonreply_clear_root(&reply);
+		}
+		
+		gint64 elapsed = MAX(g_get_monotonic_time() - start,1);
+		if(backend == 0) first_elapsed = elapsed;
+		
+		guint found = 0;
+		for(guint index = 0; index < paths->len; index++) {
+			if(values[index]) found++;
+			if(backend > 0 && g_strcmp0(values[index],first[index]) != 0) {
+				g_print("Value of \"%s\" differs: %s with %s, %s with %s\n",
+					((jsonpath*)g_ptr_array_index(paths,index))->expression,
+					first[index] ? first[index] : "none",backends[0].name,
+					values[index] ? values[index] : "none",backends[backend].name);
+				identical = FALSE;
+			}
+		}
+		
+		g_print("%s\t%.1f\t\t%.2fx\t\t%u/%u",backends[backend].name,
+			(gdouble)elapsed / JSONBACKEND_BENCH_ROUNDS,
+			(gdouble)first_elapsed / elapsed,found,paths->len);
+		
+		// Arena block is allocated before counting, as it is kept between steps
+		guint64 heap = 0, arenaheap = 0;
+		arena_alloc(ar,1);
+		if(jsonbackend_count_allocations(&backends[backend],paths,data,length,NULL,&heap) &&
+			jsonbackend_count_allocations(&backends[backend],paths,data,length,ar,&arenaheap))
+			g_print("\t%" G_GUINT64_FORMAT "\t\t\t%" G_GUINT64_FORMAT "\n",heap,arenaheap);
+		else g_print("\t-\t\t\t-\n");
+		
+		if(backend == 0) first = values;
+		else jsonbackend_free_values(values,paths->len);
+	}
+	
+	g_print("Values of the backends are %s\n",identical ? "identical" : "different");
+	
+	jsonbackend_free_values(first,paths->len);
+	g_ptr_array_free(paths,TRUE);
+	arena_free(ar);
+	g_free(data);
+	return identical;
+}
+
+/**
+* List the paths of all values in json, members are sorted by name.
+* Members whose names cannot be written in a path are left out.
+*
+* @param node Node to list
+* @param prefix Path of the node
+* @param paths Array to add the paths to
+*/
+static void jsonbackend_list_paths(JsonNode* node, const gchar* prefix, GPtrArray* paths) {
+	switch(json_node_get_node_type(node)) {
+		case JSON_NODE_OBJECT: {
+			JsonObject* object = json_node_get_object(node);
+			GList* members = g_list_sort(json_object_get_members(object),(GCompareFunc)g_strcmp0);
+			
+			for(GList* iter = members; iter; iter = g_list_next(iter)) {
+				const gchar* name = (const gchar*)iter->data;
+				gboolean writable = *name != '\0';
+				
+				for(const gchar* c = name; *c && writable; c++) 
+					writable = g_ascii_isalnum(*c) || *c == '_' || *c == '-';
+				if(!writable) continue;
+				
+				gchar* path = g_strjoin(".",prefix,name,NULL);
+				jsonbackend_list_paths(json_object_get_member(object,name),path,paths);
+				g_free(path);
+			}
+			g_list_free(members);
+			break;
+		}
+		case JSON_NODE_ARRAY: {
+			JsonArray* array = json_node_get_array(node);
+			
+			for(guint index = 0; index < json_array_get_length(array); index++) {
+				gchar* path = g_strdup_printf("%s[%u]",prefix,index);
+				jsonbackend_list_paths(json_array_get_element(array,index),path,paths);
+				g_free(path);
+			}
+			break;
+		}
+		default:
+			g_ptr_array_add(paths,g_strdup(prefix));
+			break;
+	}
+}
+
+/**
+* Add the json files within directory and its subdirectories to list.
+*
+* @param dir Directory to search
+* @param files List of paths to add to, sorted
+*/
+static void jsonbackend_find_files(const gchar* dir, GSList** files) {
+	GDir* folder = g_dir_open(dir,0,NULL);
+	if(!folder) return;
+	
+	const gchar* name = NULL;
+	while((name = g_dir_read_name(folder))) {
+		gchar* path = g_strjoin("/",dir,name,NULL);
+		
+		if(g_file_test(path,G_FILE_TEST_IS_DIR)) jsonbackend_find_files(path,files);
+		else if(g_str_has_suffix(name,".json")) {
+			*files = g_slist_insert_sorted(*files,path,(GCompareFunc)g_strcmp0);
+			path = NULL;
+		}
+		g_free(path);
+	}
+	g_dir_close(folder);
+}
+
+/**
+* Compare the backends over all json files within directory, e.g. the
+* test files and the corpus in tests/jsonbackend. Every value of each file
+* is searched with jsonbackend_bench(). Files that are not valid
+* json are only checked to be invalid with all backends.
+*
+* @param dir Directory containing the files
+*
+* @return TRUE when all backends found identical values in all files
+*/
+gboolean jsonbackend_bench_corpus(const gchar* dir) {
+	GSList* files = NULL;
+	guint differing = 0;
+	
+	jsonbackend_find_files(dir,&files);
+	
+	for(GSList* iter = files; iter; iter = g_slist_next(iter)) {
+		const gchar* file = (const gchar*)iter->data;
+		jsonreply reply = { 0 };
+		reply.spill_fd = -1;
+		
+		if(!g_file_get_contents(file,&reply.data,&reply.length,NULL)) continue;
+		
+		GPtrArray* paths = g_ptr_array_new_with_free_func(g_free);
+		JsonNode* root = jsonreply_get_root(&reply);
+		if(root) jsonbackend_list_paths(root,"$",paths);
+		g_ptr_array_add(paths,NULL);
+		
+		if(!jsonbackend_bench(file,(gchar**)paths->pdata)) differing++;
+		g_print("\n");
+		
+		g_ptr_array_free(paths,TRUE);
+		jsonreply_clear_root(&reply);
+		g_free(reply.data);
+	}
+	
+	g_print("%u of %u files in \"%s\" have identical values with all backends\n",
+		g_slist_length(files) - differing,g_slist_length(files),dir);
+	
+	g_slist_free_full(files,(GDestroyNotify)g_free);
+	return differing == 0;
+}
@@ -0,0 +1,20 @@
+#ifndef __JSON_BACKEND_H_
+#define __JSON_BACKEND_H_
+
+#include "definitions.h"
+
+#define JSONBACKEND_DEFAULT "glib"
+#define JSONBACKEND_MAX_DEPTH 1024
+#define JSONBACKEND_BENCH_ROUNDS 200
+#define JSONBACKEND_NUMBER_SIZE 64
+
+gboolean jsonbackend_select(const gchar* name);
+
+gboolean jsonbackend_is_large(jsonreply* reply);
+gboolean jsonbackend_validate(jsonreply* reply);
+gchar* jsonbackend_get_string(jsonpath* path, jsonreply* reply, arena* ar);
+
+gboolean jsonbackend_bench(const gchar* file, gchar** expressions);
+gboolean jsonbackend_bench_corpus(const gchar* dir);
+
+#endif
@@ -0,0 +1,359 @@
+#include "jsonpath.h"
+#include "arena.h"
+
+static jsonpath* jsonpath_compile_until(const gchar* expression, const gchar** end, const gchar* stop);
+
+/**
+* Check whether character can be part of a member name in expression.
+*
+* @param c Character to check
+*
+* @return TRUE when character is allowed in member name
+*/
+static gboolean jsonpath_is_name_char(gchar c) {
+	return g_ascii_isalnum(c) || c == '_' || c == '-' || c == '$' || c == '@';
+}
+
+/**
+* Print error of compilation with the position in expression.
+*
+* @param expression Expression being compiled
+* @param pos Position of the error
+* @param reason Reason of the error
+*/
+static void jsonpath_print_error(const gchar* expression, const gchar* pos, const gchar* reason) {
+	g_print("Invalid path \"%s\" at position %ld: %s\n",expression,(glong)(pos - expression),reason);
+}
+
+/**
+* Parse a literal value of a filter: a string in double or single quotes
+* (quotes within escaped with \) or a bare value until ']'.
+*
+* @param expression Expression being compiled
+* @param pos Position of the literal, set to the position after it
+*
+* @return Newly allocated value or NULL when not valid
+*/
+static gchar* jsonpath_parse_literal(const gchar* expression, const gchar** pos) {
+	const gchar* p = *pos;
+	GString* value = g_string_new(NULL);
+	
+	if(*p == '"' || *p == '\'') {
+		gchar quote = *p++;
+		
+		while(*p && *p != quote) {
+			if(*p == '\\' && p[1]) p++;
+			g_string_append_c(value,*p++);
+		}
+		
+		if(*p != quote) {
+			jsonpath_print_error(expression,p,"unterminated string");
+			g_string_free(value,TRUE);
+			return NULL;
+		}
+		p++;
+	}
+	else {
+		while(*p && *p != ']' && !g_ascii_isspace(*p)) g_string_append_c(value,*p++);
+		
+		if(value->len == 0) {
+			jsonpath_print_error(expression,p,"value expected");
+			g_string_free(value,TRUE);
+			return NULL;
+		}
+	}
+	
+	*pos = p;
+	return g_string_free(value,FALSE);
+}
+
+/**
+* Compile a bracketed step: [index], [*] or [?path==value].
+*
+* @param expression Expression being compiled
+* @param pos Position after '[', set to the position after ']'
+* @param step Step to fill
+*
+* @return TRUE when step was valid
+*/
+static gboolean jsonpath_compile_bracket(const gchar* expression, const gchar** pos, jsonpath_step* step) {
+	const gchar* p = *pos;
+	
+	if(*p == '*') {
+		step->op = JSONPATH_WILDCARD;
+		p++;
+	}
+	else if(*p == '?') {
+		step->op = JSONPATH_FILTER;
+		p++;
+		step->filter = jsonpath_compile_until(expression,&p,"=]");
+		if(!step->filter) return FALSE;
+		
+		while(g_ascii_isspace(*p)) p++;
+		if(p[0] != '=' || p[1] != '=') {
+			jsonpath_print_error(expression,p,"== expected");
+			return FALSE;
+		}
+		p += 2;
+		while(g_ascii_isspace(*p)) p++;
+		
+		if(!(step->value = jsonpath_parse_literal(expression,&p))) return FALSE;
+		while(g_ascii_isspace(*p)) p++;
+	}
+	else if(*p == '-' || g_ascii_isdigit(*p)) {
+		gchar* end = NULL;
+		step->op = JSONPATH_INDEX;
+		step->index = (gint)g_ascii_strtoll(p,&end,10);
+		if(end == p || (*p == '-' && end == p + 1)) {
+			jsonpath_print_error(expression,p,"index expected");
+			return FALSE;
+		}
+		p = end;
+	}
+	else {
+		jsonpath_print_error(expression,p,"index, * or ? expected");
+		return FALSE;
+	}
+	
+	if(*p != ']') {
+		jsonpath_print_error(expression,p,"] expected");
+		return FALSE;
+	}
+	
+	*pos = p + 1;
+	return TRUE;
+}
+
+/**
+* Compile expression until end of string or one of the stop characters.
+* Path of a filter is compiled with this until the comparison.
+*
+* @param expression Whole expression, for errors
+* @param end Start of the path, set to the position where compilation ended
+* @param stop Characters ending the path, can be NULL
+*
+* @return Compiled path or NULL when not valid
+*/
+static jsonpath* jsonpath_compile_until(const gchar* expression, const gchar** end, const gchar* stop) {
+	const gchar* p = *end;
+	jsonpath* path = g_new0(struct jsonpath_t,1);
+	path->steps = g_array_new(FALSE,TRUE,sizeof(jsonpath_step));
+	
+	gboolean valid = TRUE;
+	
+	while(g_ascii_isspace(*p)) p++;
+	const gchar* start = p;
+	
+	// Optional root ($ for the json, @ for the element in filter), $.data is same as data
+	if((*p == '$' || *p == '@') && (p[1] == '.' || p[1] == '[')) p += p[1] == '.' ? 2 : 1;
+	
+	while(valid && *p && !(stop && strchr(stop,*p)) && !g_ascii_isspace(*p)) {
+		jsonpath_step step = { 0 };
+		
+		if(*p == '[') {
+			p++;
+			valid = jsonpath_compile_bracket(expression,&p,&step);
+			g_array_append_val(path->steps,step);
+		}
+		else {
+			if(*p == '.' && path->steps->len > 0) p++;
+			
+			const gchar* name = p;
+			while(jsonpath_is_name_char(*p)) p++;
+			
+			if(p == name) {
+				jsonpath_print_error(expression,p,"member name expected");
+				valid = FALSE;
+			}
+			else {
+				step.op = JSONPATH_MEMBER;
+				step.name = g_strndup(name,p - name);
+				g_array_append_val(path->steps,step);
+			}
+		}
+	}
+	
+	if(valid && path->steps->len == 0) {
+		jsonpath_print_error(expression,p,"empty path");
+		valid = FALSE;
+	}
+	
+	if(!valid) {
+		free_jsonpath(path);
+		return NULL;
+	}
+	
+	path->expression = g_strndup(start,p - start);
+	*end = p;
+	return path;
+}
+
+/**
+* Compile a path expression. Supported steps are member names separated
+* with '.', array index [n] (negative from the end), all elements or
+* members [*] and filter [?path==value] selecting elements whose value at
+* relative path equals the value. A member step on an array is applied to
+* each element, this way "data.guid" finds the guid of an object or of the
+* first element in an array having it.
+*
+* @param expression Expression to compile, e.g. data[?title=="Expenses"].guid
+*
+* @return Newly allocated jsonpath_t to be free'd with free_jsonpath() or NULL if not valid
+*/
+jsonpath* jsonpath_compile(const gchar* expression) {
+	if(!expression) return NULL;
+	
+	const gchar* end = expression;
+	jsonpath* path = jsonpath_compile_until(expression,&end,NULL);
+	
+	while(g_ascii_isspace(*end)) end++;
+	
+	if(path && *end != '\0') {
+		jsonpath_print_error(expression,end,"unexpected character");
+		free_jsonpath(path);
+		return NULL;
+	}
+	if(path) {
+		g_free(path->expression);
+		path->expression = g_strdup(expression);
+	}
+	return path;
+}
+
+/**
+* Get the value of a node as string for comparison and results.
+*
+* @param node Node to convert
+* @param ar Arena to allocate from, when NULL string must be free'd with g_free()
+*
+* @return String or NULL if node is not a value
+*/
+static gchar* jsonpath_node_to_string(JsonNode* node, arena* ar) {
+	if(!node || json_node_get_node_type(node) != JSON_NODE_VALUE) return NULL;
+	
+	switch(json_node_get_value_type(node)) {
+		case G_TYPE_STRING:
+			return arena_strdup(ar,json_node_get_string(node));
+		case G_TYPE_INT64:
+			return arena_strdup_printf(ar,"%" G_GINT64_FORMAT,json_node_get_int(node));
+		case G_TYPE_DOUBLE: {
+			gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+			return arena_strdup(ar,g_ascii_dtostr(buffer,sizeof(buffer),json_node_get_double(node)));
+		}
+		case G_TYPE_BOOLEAN:
+			return arena_strdup(ar,json_node_get_boolean(node) ? "true" : "false");
+		default:
+			return NULL;
+	}
+}
+
+/**
+* Match the steps of path starting from given step to node. Search is
+* depth first and ends at the first match.
+*
+* @param path Path to match
+* @param stepidx Index of the step to match
+* @param node Node to match the step to
+*
+* @return Matching node or NULL
+*/
+static JsonNode* jsonpath_match(jsonpath* path, guint stepidx, JsonNode* node) {
+	if(!node) return NULL;
+	if(stepidx == path->steps->len) return node;
+	
+	jsonpath_step* step = &g_array_index(path->steps,jsonpath_step,stepidx);
+	JsonNodeType type = json_node_get_node_type(node);
+	JsonNode* match = NULL;
+	
+	// Member or filter step on array is applied to each element
+	if(type == JSON_NODE_ARRAY && (step->op == JSONPATH_MEMBER || step->op == JSONPATH_FILTER)) {
+		JsonArray* array = json_node_get_array(node);
+		for(guint index = 0; index < json_array_get_length(array) && !match; index++)
+			match = jsonpath_match(path,stepidx,json_array_get_element(array,index));
+		return match;
+	}
+	
+	switch(step->op) {
+		case JSONPATH_MEMBER:
+			if(type == JSON_NODE_OBJECT) 
+				match = jsonpath_match(path,stepidx + 1,
+					json_object_get_member(json_node_get_object(node),step->name));
+			break;
+		case JSONPATH_INDEX:
+			if(type == JSON_NODE_ARRAY) {
+				JsonArray* array = json_node_get_array(node);
+				gint index = step->index < 0 ? (gint)json_array_get_length(array) + step->index : step->index;
+				if(index >= 0 && index < json_array_get_length(array))
+					match = jsonpath_match(path,stepidx + 1,json_array_get_element(array,index));
+			}
+			break;
+		case JSONPATH_WILDCARD:
+			if(type == JSON_NODE_ARRAY) {
+				JsonArray* array = json_node_get_array(node);
+				for(guint index = 0; index < json_array_get_length(array) && !match; index++)
+					match = jsonpath_match(path,stepidx + 1,json_array_get_element(array,index));
+			}
+			else if(type == JSON_NODE_OBJECT) {
+				GList* values = json_object_get_values(json_node_get_object(node));
+				for(GList* iter = values; iter && !match; iter = g_list_next(iter))
+					match = jsonpath_match(path,stepidx + 1,(JsonNode*)iter->data);
+				g_list_free(values);
+			}
+			break;
+		case JSONPATH_FILTER:
+			if(type == JSON_NODE_OBJECT) {
+				gchar* value = jsonpath_node_to_string(jsonpath_match(step->filter,0,node),NULL);
+				if(g_strcmp0(value,step->value) == 0) match = jsonpath_match(path,stepidx + 1,node);
+				g_free(value);
+			}
+			break;
+	}
+	return match;
+}
+
+/**
+* Evaluate path over parsed json.
+*
+* @param path Compiled path
+* @param root Root node of the json
+*
+* @return First matching node (owned by the json) or NULL if not found
+*/
+JsonNode* jsonpath_evaluate(jsonpath* path, JsonNode* root) {
+	if(!path || !root) return NULL;
+	return jsonpath_match(path,0,root);
+}
+
+/**
+* Evaluate path over parsed json and get the value as string. Integers,
+* doubles and booleans are converted to strings.
+*
+* @param path Compiled path
+* @param root Root node of the json
+* @param ar Arena to allocate from, when NULL value must be free'd with g_free()
+*
+* @return Value or NULL if not found or not a value
+*/
+gchar* jsonpath_get_string(jsonpath* path, JsonNode* root, arena* ar) {
+	return jsonpath_node_to_string(jsonpath_evaluate(path,root),ar);
+}
+
+/**
+* Free a compiled path.
+*
+* @param data Pointer to jsonpath_t to free
+*/
+void free_jsonpath(gpointer data) {
+	jsonpath* path = (jsonpath*)data;
+	if(!path) return;
+	
+	for(guint index = 0; index < path->steps->len; index++) {
+		jsonpath_step* step = &g_array_index(path->steps,jsonpath_step,index);
+		g_free(step->name);
+		g_free(step->value);
+		free_jsonpath(step->filter);
+	}
+	g_array_free(path->steps,TRUE);
+	g_free(path->expression);
+	g_free(path);
+}
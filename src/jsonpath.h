@@ -0,0 +1,11 @@
+#ifndef __JSONPATH_H_
+#define __JSONPATH_H_
+
+#include "definitions.h"
+
+jsonpath* jsonpath_compile(const gchar* expression);
+JsonNode* jsonpath_evaluate(jsonpath* path, JsonNode* root);
+gchar* jsonpath_get_string(jsonpath* path, JsonNode* root, arena* ar);
+void free_jsonpath(gpointer data);
+
+#endif
@@ -1,6 +1,12 @@
 #include "jsonutils.h"
 #include "preferences.h"
 #include "connectionutils.h"
+#include "results.h"
+#include "arena.h"
+#include "jsonpath.h"
+#include "jsonbackend.h"
+#include "capture.h"
+#include "requestcache.h"
 
 GSList *integer_fields = NULL;
 
@@ -155,14 +161,53 @@ gboolean load_json_from_data(JsonParser* parser, const gchar* data, const gssize
 	
 	rval = json_parser_load_from_data(parser, data, length, &error);
 		
-	if (error) {
-		g_error ("Cannot parse data. Reason: %s\n", error->message);
+	if (error && !rval) {
+		g_print ("Cannot parse data. Reason: %s\n", error->message);
 		g_error_free(error);
 	}
 	
 	return rval;
 }
 
+/**
+* Get the root of the parsed json data. Data is parsed only the first time,
+* the parser is kept in the jsonreply_t until the data is changed. Data
+* found not valid is not parsed again.
+*
+* @param jsondata JSON as data in form of jsonreply_t
+*
+* @return Root node of the json (owned by jsondata) or NULL if data is not valid
+*/
+JsonNode* jsonreply_get_root(jsonreply* jsondata) {
+	if(!jsondata || !jsondata->data || jsondata->checked < 0) return NULL;
+	
+	if(!jsondata->parser) {
+		JsonParser *parser = json_parser_new();
+		
+		if(!load_json_from_data(parser,jsondata->data,jsondata->length)) {
+			g_object_unref(parser);
+			jsondata->checked = -1;
+			return NULL;
+		}
+		jsondata->parser = parser;
+	}
+	return json_parser_get_root(jsondata->parser);
+}
+
+/**
+* Clear the parsed json and the validation of the data, must be called
+* when data is changed.
+*
+* @param jsondata JSON as data in form of jsonreply_t
+*/
+void jsonreply_clear_root(jsonreply* jsondata) {
+	if(!jsondata) return;
+	jsondata->checked = 0;
+	if(!jsondata->parser) return;
+	g_object_unref(jsondata->parser);
+	jsondata->parser = NULL;
+}
+
 /**
 * Retrieve given value from given json as data. Can be used to search from an array or
 * from an object with two level search. First search value is the member name whose value
@@ -178,11 +223,11 @@ gchar* get_value_of_member(jsonreply* jsondata, const gchar* search, const gchar
 	if(!jsondata || !search) return NULL;
 	
 	gchar *value = NULL;
-	JsonParser *parser = json_parser_new();
+	JsonNode *root = jsonreply_get_root(jsondata);
 	
-	// Load json data
-	if(load_json_from_data(parser,jsondata->data,jsondata->length)) {
-		JsonReader *reader = json_reader_new (json_parser_get_root (parser));
+	// Json data is parsed only once
+	if(root) {
+		JsonReader *reader = json_reader_new (root);
 		
 		// Replies contain either data or error, only data is checked now
 		if(json_reader_read_member(reader,"data")) {
@@ -240,10 +285,26 @@ gchar* get_value_of_member(jsonreply* jsondata, const gchar* search, const gchar
 		g_object_unref(reader);
 	}
 	
-	g_object_unref(parser);
 	return value;
 }
 
+/**
+* Release the reply of the testfile. Values needed by later steps were
+* captured when the reply arrived (see capture_take()).
+*
+* @param tfile Testfile whose reply is released
+*
+* @return TRUE when reply was released
+*/
+gboolean release_testfile_reply(testfile* tfile) {
+	if(!tfile || !tfile->recv || tfile->released) return FALSE;
+	
+	free_jsonreply(tfile->recv);
+	tfile->recv = NULL;
+	tfile->released = TRUE;
+	
+	return TRUE;
+}
 
 /** 
 * Replace value of given member field in the json. Creates a new json from the given jsonreply_t
@@ -261,10 +322,10 @@ gboolean set_value_of_member(jsonreply* jsondata, const gchar* member, const gch
 	
 	gboolean rval = TRUE;
 	
-	JsonParser *parser = json_parser_new();
+	JsonNode *root = jsonreply_get_root(jsondata);
 	
-	// Load existing data
-	if(load_json_from_data(parser,jsondata->data,jsondata->length)) {
+	// Use existing data
+	if(root) {
 	
 		// Initialize a new builder to construct new json with
 		// a new value for a member
@@ -272,7 +333,7 @@ gboolean set_value_of_member(jsonreply* jsondata, const gchar* member, const gch
 		json_builder_begin_object(builder);
 		
 		// Start reading json and get list of members
-		JsonReader *reader = json_reader_new (json_parser_get_root (parser));
+		JsonReader *reader = json_reader_new (root);
 		gchar** members = json_reader_list_members(reader);
 		
 		// Go through members
@@ -296,9 +357,10 @@ gboolean set_value_of_member(jsonreply* jsondata, const gchar* member, const gch
 		JsonGenerator *generator = json_generator_new();
 		json_generator_set_root(generator, json_builder_get_root(builder));
 		
-		// Free previous data and assign new to this json
+		// Free previous data and assign new to this json, it is parsed again when needed
 		g_free(jsondata->data);
 		jsondata->data = json_generator_to_data(generator,&(jsondata->length));
+		jsonreply_clear_root(jsondata);
 		
 		g_strfreev(members);
 		g_object_unref(generator);
@@ -307,8 +369,6 @@ gboolean set_value_of_member(jsonreply* jsondata, const gchar* member, const gch
 	}
 	else rval = FALSE;
 	
-	g_object_unref(parser);
-	
 	return rval;
 }
 
@@ -331,10 +391,10 @@ gboolean set_values_of_all_members(jsonreply* jsondata, GHashTable* replace) {
 	gboolean rval = TRUE;
 	gint replaced = 0;
 	
-	JsonParser *parser = json_parser_new();
+	JsonNode *root = jsonreply_get_root(jsondata);
 	
-	// Load existing data
-	if(load_json_from_data(parser,jsondata->data,jsondata->length)) {
+	// Use existing data
+	if(root) {
 	
 		// Initialize a new builder to construct new json with
 		// a new value for a member
@@ -342,7 +402,7 @@ gboolean set_values_of_all_members(jsonreply* jsondata, GHashTable* replace) {
 		json_builder_begin_object(builder);
 		
 		// Start reading json and get list of members
-		JsonReader *reader = json_reader_new (json_parser_get_root (parser));
+		JsonReader *reader = json_reader_new (root);
 		gchar** members = json_reader_list_members(reader);
 		
 		// Go through members
@@ -375,9 +435,10 @@ gboolean set_values_of_all_members(jsonreply* jsondata, GHashTable* replace) {
 		JsonGenerator *generator = json_generator_new();
 		json_generator_set_root(generator, json_builder_get_root(builder));
 		
-		// Free previous data and assign new to this json
+		// Free previous data and assign new to this json, it is parsed again when needed
 		g_free(jsondata->data);
 		jsondata->data = json_generator_to_data(generator,&(jsondata->length));
+		jsonreply_clear_root(jsondata);
 		
 		g_strfreev(members);
 		g_object_unref(generator);
@@ -386,8 +447,6 @@ gboolean set_values_of_all_members(jsonreply* jsondata, GHashTable* replace) {
 	}
 	else rval = FALSE;
 	
-	g_object_unref(parser);
-	
 	// All were not replaced
 	if(replaced != g_hash_table_size(replace)) {
 		g_print("Replaced %d values but hash table contains: %d values. Errors may exist in tests\n",replaced,g_hash_table_size(replace));
@@ -442,20 +501,20 @@ jsonreply* create_delete_reply(const gchar* member, const gchar* value) {
 * having "title" as member name, the check_value2 is checked for equality to that elements
 * "formatted_value" field.
 *
-* @param parser Parser in which the JSON is loaded
+* @param root Root of the parsed JSON
 * @param check_value1 Value of "title" member field
 * @param check_value2 Value to be checked, the value of "formatted_value" member field
 *
 * @return TRUE only when equal match is found
 */
-gboolean verify_in_array(JsonParser *parser, const gchar* check_value1, const gchar* check_value2) {
+gboolean verify_in_array(JsonNode *root, const gchar* check_value1, const gchar* check_value2) {
 	
-	if(!parser || !check_value1 || !check_value2) return FALSE;
+	if(!root || !check_value1 || !check_value2) return FALSE;
 	
 	gboolean success = FALSE;
 	
 	// Reader for response
-	JsonReader *reader = json_reader_new (json_parser_get_root (parser));
+	JsonReader *reader = json_reader_new (root);
 	
 	// Start reading array
 	if(json_reader_read_member(reader,"data")) {
@@ -514,12 +573,50 @@ gboolean verify_in_array(JsonParser *parser, const gchar* check_value1, const gc
 	return success;
 }
 
+/**
+* Get a value of a large response without building a tree of it, see
+* jsonbackend_is_large(). Finds the "formatted_value" of the element in
+* "data" having the given title or, without title, the member of "data"
+* the same way as get_value_of_member().
+*
+* @param response Large response to search
+* @param title Value of "title" of the element, NULL to search member
+* @param member Member name to search when title is NULL
+*
+* @return Newly allocated value that must be free'd with g_free() or NULL if not found
+*/
+static gchar* get_large_response_value(jsonreply* response, const gchar* title, const gchar* member) {
+	GString* expression = g_string_new("data");
+	
+	if(title) {
+		// Quotes and backslashes are escaped for the filter literal
+		g_string_append(expression,"[?title==\"");
+		for(const gchar* p = title; *p; p++) {
+			if(*p == '"' || *p == '\\') g_string_append_c(expression,'\\');
+			g_string_append_c(expression,*p);
+		}
+		g_string_append(expression,"\"].formatted_value");
+	}
+	else g_string_append_printf(expression,".%s",member);
+	
+	jsonpath* path = jsonpath_compile(expression->str);
+	gchar* value = jsonbackend_get_string(path,response,NULL);
+	
+	free_jsonpath(path);
+	g_string_free(expression,TRUE);
+	return value;
+}
+
 /**
 * Verify two JSONs for equality of values. The members of request are
 * looped through and corresponding values are searched from response JSON.
 * Can iterate through arrays, which have all members within "data" member
 * and works for plain JSON objects. If an array is to be verified 
-* verify_in_array() is called.
+* verify_in_array() is called. Comparing is done with json-glib, the
+* selected json backend is used only for looking up values, but the
+* response must be valid also for the backend as its values are looked up
+* by the following steps. Large responses (see jsonbackend_is_large()) are
+* not parsed into a tree, their values are looked up on demand instead.
 *
 * @param request Request jsonreply_t containing requested values
 * @param response Server response jsonreply_t containing values set by server
@@ -528,19 +625,20 @@ gboolean verify_in_array(JsonParser *parser, const gchar* check_value1, const gc
 */
 gboolean verify_server_response(jsonreply* request, jsonreply* response) {
 
-	if(!request  || !response) return FALSE;
+	if(!request  || !response || !jsonbackend_validate(response)) return FALSE;
 
 	gboolean test_ok = TRUE;
 	gboolean array = FALSE;
-	JsonParser *req_parser = json_parser_new();
-	JsonParser *res_parser = json_parser_new();
 	
-	// Load both jsons from memory
-	if(load_json_from_data(req_parser,request->data,request->length) &&
-		load_json_from_data(res_parser,response->data,response->length)) {
+	// Both jsons are parsed only once
+	JsonNode *req_root = jsonreply_get_root(request);
+	gboolean large = jsonbackend_is_large(response);
+	JsonNode *res_root = large ? NULL : jsonreply_get_root(response);
+	
+	if(req_root && (res_root || large)) {
 		
 		// Initialize reader for request only
-		JsonReader *req_reader = json_reader_new (json_parser_get_root (req_parser));
+		JsonReader *req_reader = json_reader_new (req_root);
 		
 		// If this member contains data it must be dealt differenlty from plain json objects
 		if(json_reader_read_member(req_reader,"data")) {
@@ -576,7 +674,14 @@ gboolean verify_server_response(jsonreply* request, jsonreply* response) {
 					
 					// Check if the response contains same value as the value2 (formatted_value)
 					print_check_init(value1,value2);
-					test_ok = verify_in_array(res_parser,value1,value2);
+					if(res_root) test_ok = verify_in_array(res_root,value1,value2);
+					else if(value1 && value2) {
+						gchar* res_value = get_large_response_value(response,value1,NULL);
+						test_ok = g_strcmp0(res_value,value2) == 0;
+						if(!test_ok) print_check_failure(value2,res_value);
+						g_free(res_value);
+					}
+					else test_ok = FALSE;
 					if(test_ok) print_check_ok();
 					
 					g_free(value1);
@@ -606,7 +711,8 @@ gboolean verify_server_response(jsonreply* request, jsonreply* response) {
 				gchar* req_membstring = get_json_member_string(req_reader,members[membidx]);
 				
 				// Get the corresponding value from the response
-				gchar* res_membstring = get_value_of_member(response,members[membidx],NULL);
+				gchar* res_membstring = large ? get_large_response_value(response,NULL,members[membidx]) :
+					get_value_of_member(response,members[membidx],NULL);
 						
 				print_check_init(members[membidx],req_membstring);
 				// Response was found
@@ -636,82 +742,46 @@ gboolean verify_server_response(jsonreply* request, jsonreply* response) {
 	}
 	else test_ok = FALSE;
 	
-	g_object_unref(req_parser);
-	g_object_unref(res_parser);
 	return test_ok;
 }
 
 /**
 * Replace value of a required member in the sent JSON at given index
-* in the list of required members. Gets the member name and corresponding
-* jsonreply_t from which the three member field values are read:
-* (search_file, search_member and root_Task). These fields tell from
-* which file response, which member and whether sub-element is required to be used.
-* Calls get_value_of_member() to get values from JSON. And for setting
-* the value calls set_value_of_member().
-*
-* @param filetable GHashTable of testfile_t structs from which the file is searched
+* in the list of required members. The reference of the member tells
+* from which file response and with which compiled path the value was
+* captured. For setting the value calls set_value_of_member().
+*
 * @param tfile Current testfile_t containing the member to be replaced
-* @param index Position of member name and JSON at testfile_t structures
+* @param index Position of member name and reference at testfile_t structures
 *
 * @return TRUE when value was replaced
 */
-gboolean replace_required_member(GHashTable* filetable, testfile* tfile, gint index) {
+gboolean replace_required_member(testfile* tfile, gint index) {
 
-	if(!filetable || !tfile) return FALSE;
-	
-	gboolean rval = TRUE;
-	gchar *search_file = NULL;	
-	gchar *search_member = NULL;
-	gchar *search_root = NULL;
-	gboolean root_task = FALSE;
+	if(!tfile || !tfile->fixture) return FALSE;
 	
-	// Get member to be replaced
-	const gchar* member = (gchar*)g_slist_nth_data(tfile->required,index);
+	gboolean rval = FALSE;
 	
-	// Get the json holding the details for this parameter
-	jsonreply* info = (jsonreply*)g_slist_nth_data(tfile->reqinfo,index);
+	// Get the reference telling where the value is
+	reference* ref = (reference*)g_slist_nth_data(tfile->fixture->parents,index);
 	
-	// Found json
-	if(info) {
+	// Found reference with a valid path
+	if(ref && ref->select) {
 #ifdef G_MESSAGES_DEBUG
-		g_print("member %s info: %s\n",member,info->data);
+		g_print("member %s from %s: %s\n",ref->member,ref->search_file,ref->select->expression);
 #endif
 		
-		// Get path and method from file
-		search_file = get_value_of_member(info,"search_file",NULL);
-		search_member = get_value_of_member(info,"search_member",NULL);
-		search_root = get_value_of_member(info,"root_task",NULL);
-		if(search_root && g_strcmp0(search_root,"yes") == 0) root_task = TRUE;
-		
-		// Get the file
-		testfile* req_file = (testfile*)g_hash_table_find(filetable,
-			(GHRFunc)find_from_hash_table, 
-			search_file);
-
-		// Something to search for?
-		if(search_member) {
-			gchar* new_value = get_value_of_member(
-				req_file->recv,
-				search_member,
-				root_task ? "root_task" : NULL);
-	
-			// Create new json using the "value" and save it
-			if(new_value && set_value_of_member(tfile->send, member, new_value)) {
+		// Captured when the reply of the file arrived
+		const gchar* new_value = capture_get_from_file(ref->search_file,ref->select->expression);
+	
+		// Create new json using the "value" and save it
+		if(new_value && set_value_of_member(tfile->send, ref->member, new_value)) {
 #ifdef G_MESSAGES_DEBUG
-				g_print("Replaced member %s value to %s\n",member,new_value);
+			g_print("Replaced member %s value to %s\n",ref->member,new_value);
 #endif
-				rval = TRUE;
-			}
-		g_free(new_value);
+			rval = TRUE;
 		}
 	}
-	else rval = FALSE;
-	
-	
-	g_free(search_file);
-	g_free(search_root);
-	g_free(search_member);
 	
 	return rval;
 }
@@ -719,128 +789,87 @@ gboolean replace_required_member(GHashTable* filetable, testfile* tfile, gint in
 
 /**
 * Add value of a required member in the testfile replace hash table.
-* Gets the member name and corresponding jsonreply_t from which the 
-* three member field values are read: (search_file, search_member 
-* and root_Task). These fields tell from which file response, which
-* member and whether sub-element is required to be used.
-*
-* Calls get_value_of_member() to get values from JSON.
+* The reference of the member at index tells from which file response
+* (search_file) and with which compiled path (select) the value was
+* captured, the value is read from capture store.
 *
-* @param filetable GHashTable of testfile_t structs from which the file is searched
 * @param tfile Current testfile_t containing the member to be replaced
-* @param index Position of member name and JSON at testfile_t structures
+* @param index Position of member name and reference at testfile_t structures
 *
 * @return TRUE when value was added to hash table (or replaced a value of existing)
 */
-gboolean add_required_member_value_to_list(GHashTable* filetable, testfile* tfile, gint index) {
+gboolean add_required_member_value_to_list(testfile* tfile, gint index) {
 
-	if(!filetable || !tfile) return FALSE;
+	if(!tfile) return FALSE;
 	
 	// List empty
-	if(!tfile->required) return TRUE;
-	
-	gboolean rval = TRUE;
-	gchar *search_file = NULL;	
-	gchar *search_member = NULL;
-	gchar *search_root = NULL;
-	gboolean root_task = FALSE;
+	if(!tfile->required || !tfile->fixture) return TRUE;
 	
-	// Get member to be replaced
-	const gchar* member = (gchar*)g_slist_nth_data(tfile->required,index);
+	gboolean rval = FALSE;
 	
-	// Get the json holding the details for this parameter
-	jsonreply* info = (jsonreply*)g_slist_nth_data(tfile->reqinfo,index);
+	// Get the reference telling where the value is
+	reference* ref = (reference*)g_slist_nth_data(tfile->fixture->parents,index);
 	
-	// Found json
-	if(info) {
+	// Found reference with a valid path
+	if(ref && ref->select) {
 #ifdef G_MESSAGES_DEBUG
-		g_print("member %s info: %s\n",member,info->data);
+		g_print("member %s from %s: %s\n",ref->member,ref->search_file,ref->select->expression);
 #endif
 		
-		// Get path and method from file
-		search_file = get_value_of_member(info,"search_file",NULL);
-		search_member = get_value_of_member(info,"search_member",NULL);
-		search_root = get_value_of_member(info,"root_task",NULL);
-		if(search_root && g_strcmp0(search_root,"yes") == 0) root_task = TRUE;
-		
-		// Get the file
-		testfile* req_file = (testfile*)g_hash_table_find(filetable,
-			(GHRFunc)find_from_hash_table, 
-			search_file);
-
-		// Something to search for?
-		if(search_member) {
-			gchar* new_value = get_value_of_member(
-				req_file->recv,
-				search_member,
-				root_task ? "root_task" : NULL);
-	
-			// Create new json using the "value" and save it
-			if(new_value) {
-				g_hash_table_insert(tfile->replace,g_strdup(member),g_strdup(new_value));
-				rval = TRUE;
-			}
-		g_free(new_value);
+		// Captured when the reply of the file arrived
+		const gchar* new_value = capture_get_from_file(ref->search_file,ref->select->expression);
+	
+		// Add the value to be replaced, values of the store stay in run arena until the end of run
+		if(new_value) {
+			g_hash_table_insert(tfile->replace,arena_strdup(arena_run(),ref->member),(gchar*)new_value);
+			rval = TRUE;
 		}
+		else g_print("Value for member \"%s\" not found with \"%s\" from test id \"%s\"\n",
+			ref->member,ref->select->expression,ref->search_file);
 	}
-	else rval = FALSE;
-	
-	
-	g_free(search_file);
-	g_free(search_root);
-	g_free(search_member);
 	
 	return rval;
 }
 
 /**
 * Replace value of a member requiring more information from the server.
-* The JSON having the details is read at index of tfile structures and
-* an request is sent to url+"path" field in the JSON using "method". The
-* reply to this response contains a member field matching one at index in
-* the list of getinfo-member fields in tfile. 
+* The reference of the member at index tells the path and method of the
+* request and the compiled path of the value in the reply (data.guid if
+* not set).
 *
-* Calls get_value_of_member() to read the pfererences from getinfo JSON.
 * Calls http_post() to send the request (most likely GET).
-* Calls get_value_of_member() to get the value from the server response.
 * Calls set_value_of_member() to replace the member value.
 *
 * @param tfile Current testfile_t containing the member to be replaced
-* @param index Position of member name and JSON at testfile_t structures
+* @param index Position of member name and reference at testfile_t structures
 * @param url Base url to which request is sent
 *
 * @return TRUE when value was found in reply and replaced
 */
 gboolean replace_getinfo_member(testfile* tfile, gint index, const gchar* url) {
 
-	if(!tfile  || !url) return FALSE;
-	
-	gboolean rval = TRUE;
-	// Get member to be replaced
-	const gchar* member = (gchar*)g_slist_nth_data(tfile->moreinfo,index);
+	if(!tfile || !url || !tfile->fixture) return FALSE;
 	
-	// Get the json holding the details for this parameter
-	jsonreply* infosend = (jsonreply*)g_slist_nth_data(tfile->infosend,index);
-	jsonreply* inforecv = NULL;
+	gboolean rval = FALSE;
 	
-	// Found json
-	if(infosend) {
+	// Get the reference telling where the value is
+	reference* ref = (reference*)g_slist_nth_data(tfile->fixture->getinfos,index);
 	
-		// Get path and method from file
-		gchar* infopath = get_value_of_member(infosend,"path",NULL);
-		gchar* method = get_value_of_member(infosend,"method",NULL);
+	// Found reference with a valid path
+	if(ref && ref->select) {
 		
 		// Construct url
-		gchar* infourl = g_strjoin("/",url,infopath,NULL);
+		gchar* infourl = g_strjoin("/",url,ref->path,NULL);
 						
 		// Send an empty json to server to retrieve information
-		inforecv = http_post(infourl,NULL,method);
+		http_set_latency_key(ref->path);
+		jsonreply* inforecv = http_post(infourl,NULL,ref->method);
 		
 		// Search the value and replace it
-		gchar* value = get_value_of_member(inforecv,"guid",NULL);
-		if(value && set_value_of_member(tfile->send,member,value)) {
+		gchar* value = jsonbackend_get_string(ref->select,inforecv,NULL);
+		if(value && set_value_of_member(tfile->send,ref->member,value)) {
 #ifdef G_MESSAGES_DEBUG
-				g_print("Replaced member %s value to %s\n",member,value);
+				g_print("Replaced member %s value to %s\n",ref->member,value);
 #endif
 			rval = TRUE;
 		}
@@ -848,31 +877,28 @@ gboolean replace_getinfo_member(testfile* tfile, gint index, const gchar* url) {
 		// Add result to list
 		tfile->inforecv = g_slist_append(tfile->inforecv,inforecv);
 		
-		g_free(infopath);
-		g_free(method);
 		g_free(infourl);
 		g_free(value);
 	}
-	else rval = FALSE;
 	return rval;
 }
 
 
 /**
 * Add a value of a member requiring more information from the server
-* to the testfile replace hash table. The JSON having the details is
-* read at index of tfile structures and an request is sent to url+"path"
-* field in the JSON using "method". The reply to this response contains
-* a member field matching one at index in the list of getinfo-member
-* fields in tfile. This new member-value pair is added to the testfile
-* replace hash table where member is the key.
-*
-* Calls get_value_of_member() to read the pfererences from getinfo JSON.
+* to the testfile replace hash table. The reference of the member at
+* index tells the path and method of the request, the value is searched
+* from the reply with the compiled path of the reference (data.guid if
+* not set). This new member-value pair is added to the testfile replace
+* hash table where member is the key.
+*
+* Identical requests (method and url) are sent only once in a run, the
+* reply is shared through the request cache.
+*
 * Calls http_post() to send the request (most likely GET).
-* Calls get_value_of_member() to get the value from the server response.
 *
 * @param tfile Current testfile_t containing the member to be replaced
-* @param index Position of member name and JSON at testfile_t structures
+* @param index Position of member name and reference at testfile_t structures
 * @param url Base url to which request is sent
 *
 * @return TRUE when value was found in reply and added to/replaced in hash table
@@ -882,45 +908,41 @@ gboolean add_getinfo_member_value_to_list(testfile* tfile, gint index, const gch
 	if(!tfile  || !url) return FALSE;
 
 	// List empty
-	if(!tfile->moreinfo) return TRUE;
+	if(!tfile->moreinfo || !tfile->fixture) return TRUE;
 	
-	gboolean rval = TRUE;
-	
-	// Get member to be replaced
-	const gchar* member = (gchar*)g_slist_nth_data(tfile->moreinfo,index);
-	
-	// Get the json holding the details for this parameter
-	jsonreply* infosend = (jsonreply*)g_slist_nth_data(tfile->infosend,index);
-	jsonreply* inforecv = NULL;
+	gboolean rval = FALSE;
 	
-	// Found json
-	if(infosend) {
+	// Get the reference telling where the value is
+	reference* ref = (reference*)g_slist_nth_data(tfile->fixture->getinfos,index);
 	
-		// Get path and method from file
-		gchar* infopath = get_value_of_member(infosend,"path",NULL);
-		gchar* method = get_value_of_member(infosend,"method",NULL);
+	// Found reference with a valid path
+	if(ref && ref->select) {
 		
 		// Construct url
-		gchar* infourl = g_strjoin("/",url,infopath,NULL);
-						
+		gchar* infourl = arena_strjoin(arena_step(),"/",url,ref->path,NULL);
+		
+		// Reply of the same request in this run
+		gboolean owner = FALSE;
+		jsonreply* inforecv = requestcache_lookup(ref->method,infourl,&owner);
+		gboolean cached = inforecv != NULL;
+		
 		// Send an empty json to server to retrieve information
-		inforecv = http_post(infourl,NULL,method);
+		if(!inforecv) {
+			http_set_latency_key(ref->path);
+			inforecv = http_post(infourl,NULL,ref->method);
+			results_add(tfile->id,ref->method,ref->path,inforecv);
+			if(owner) cached = requestcache_complete(ref->method,infourl,inforecv);
+		}
 		
-		// Search the value and replace it
-		gchar* value = get_value_of_member(inforecv,"guid",NULL);
+		// Search the value and replace it, value is allocated from run arena as the keys
+		gchar* value = jsonbackend_get_string(ref->select,inforecv,arena_run());
 		if(value) {
-			g_hash_table_insert(tfile->replace,g_strdup(member),g_strdup(value));
+			g_hash_table_insert(tfile->replace,arena_strdup(arena_run(),ref->member),value);
 			rval = TRUE;
 		}
 		
-		// Add result to list
-		tfile->inforecv = g_slist_append(tfile->inforecv,inforecv);
-		
-		g_free(infopath);
-		g_free(method);
-		g_free(infourl);
-		g_free(value);
+		// Add result to list unless owned by cache
+		if(!cached) tfile->inforecv = g_slist_append(tfile->inforecv,inforecv);
 	}
-	else rval = FALSE;
 	return rval;
-}
\ No newline at end of file
+}
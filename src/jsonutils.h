@@ -13,7 +13,11 @@ gboolean load_json_from_file(JsonParser* parser, const gchar* path);
 
 gboolean load_json_from_data(JsonParser* parser, const gchar* data, const gssize length);
 
+JsonNode* jsonreply_get_root(jsonreply* jsondata);
+void jsonreply_clear_root(jsonreply* jsondata);
+
 gchar* get_value_of_member(jsonreply* data, const gchar* search, const gchar* search2);
+gboolean release_testfile_reply(testfile* tfile);
 
 gboolean set_value_of_member(jsonreply* data, const gchar* member, const gchar* value);
 gboolean set_values_of_all_members(jsonreply* jsondata, GHashTable* replace);
@@ -22,8 +26,8 @@ jsonreply* create_delete_reply(const gchar* member, const gchar* value);
 
 gboolean verify_server_response(jsonreply* request, jsonreply* response);
 
-gboolean replace_required_member(GHashTable* filetable, testfile* tfile, gint index);
-gboolean add_required_member_value_to_list(GHashTable* filetable, testfile* tfile, gint index);
+gboolean replace_required_member(testfile* tfile, gint index);
+gboolean add_required_member_value_to_list(testfile* tfile, gint index);
 
 gboolean replace_getinfo_member(testfile* tfile, gint index, const gchar* url);
 gboolean add_getinfo_member_value_to_list(testfile* tfile, gint index, const gchar* url);
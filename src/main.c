@@ -1,15 +1,22 @@
-#include <stdio.h>
-#include <string.h>
-#include <glib.h>
-#include <glib-object.h>
-#include <json-glib/json-glib.h>
-
 #include "utils.h"
 #include "jsonutils.h"
 #include "connectionutils.h"
 #include "tests.h"
+#include "pacing.h"
+#include "results.h"
+#include "shard.h"
+#include "soak.h"
+#include "jsonbackend.h"
 #include "definitions.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <json-glib/json-glib.h>
+
 #define USERNAME_MAX_CHAR 51
 #define TEMPLEN 100
 
@@ -17,6 +24,9 @@
 * Test selection part of UI. Lists tests for this user
 * and awaits for selection. Runs test if it is found and
 * asks whether to rerun test or to quit or to return to main.
+* When the test fails the resources are left on server and
+* the test can be resumed from the failed step. Otherwise the
+* resources are removed before continuing.
 *
 * @param user username to use for loading preferences
 *
@@ -38,6 +48,9 @@ gboolean run_test_selection(gchar* user) {
 	
 		gboolean loop = TRUE, rerun = FALSE;
 		gchar tnumber = '\0';
+		
+		// Keep resources of failed tests for resuming
+		tests_set_keep_resources(TRUE);
 	
 		// Run main loop for test selection
 		while(loop) {
@@ -100,19 +113,31 @@ gboolean run_test_selection(gchar* user) {
 				tests_initialize(test);
 			
 				// Run
-				if(tests_run_test(prefs->username,test)) 
-					g_print("Test %s completed with failures.\n",test->name);
+				gboolean passed = tests_run_test(prefs->username,test);
+				if(!passed) g_print("Test %s completed with failures.\n",test->name);
 				else g_print("Test %s complete\n",test->name);
 			
 				// Clear and reset test
 				tests_reset(test);
 				
+				if(!passed && tests_get_failed_step())
+					g_print("Resume from failed step \"%s\" (f) or ",tests_get_failed_step());
 				g_print("Redo test (r) or quit (q) or go to main (m) or return to user selection (u): ");
 				
 				// Get char 
 				gchar response = getc(stdin);
+				
+				// Resources are removed unless resuming
+				if(response != 'f' || passed) tests_cleanup_pending(prefs->username,test);
 			
 				switch (response) {
+					case 'f':
+						if(!passed && tests_get_failed_step()) {
+							tests_set_resume_point(tests_get_failed_step());
+							rerun = TRUE;
+						}
+						else g_print("Invalid selection. Return to main.\n");
+						break;
 					case 'r':
 						rerun = TRUE;
 						break;
@@ -191,6 +216,40 @@ void run_user_loop() {
 	g_free(user);
 }
 
+/**
+* Run a single test and print whether it passed. Test is initialized
+* before and reset after running.
+*
+* @param username User whose test is run
+* @param test Test to run
+*
+* @return EXIT_TEST_PASSED, EXIT_TEST_SLOW when a latency budget was exceeded or EXIT_TEST_FAILED
+*/
+static gint run_single_test(gchar* username, testcase* test) {
+	gint status = EXIT_TEST_PASSED;
+	
+	g_print("Running test \"%s\" to %s (with %d files)\n",
+			test->name,test->URL,g_hash_table_size(test->files));
+			
+	// Init
+	tests_initialize(test);
+
+	// Run
+	if(!tests_run_test(username,test)) {
+		g_print("Test %s completed with failures.\n",test->name);
+		status = EXIT_TEST_FAILED;
+	}
+	else if(tests_get_slow_steps() > 0) {
+		g_print("Test %s complete but %u steps exceeded latency budget.\n",test->name,tests_get_slow_steps());
+		status = EXIT_TEST_SLOW;
+	}
+	else g_print("Test %s complete\n",test->name);
+
+	// REset
+	tests_reset(test);
+	return status;
+}
+
 /**
 * Run a test directly with specified user. Attempts to load preferences
 * with specified username and if successful, tries to get a test with
@@ -202,11 +261,11 @@ void run_user_loop() {
 * @param user User whose preferences is to be loaded
 * @param testname Name of the user's test to load
 *
-* @return TRUE if user and testname was found, FALSE if either is missing or not found
+* @return Status of the test (see run_single_test()) or EXIT_NOT_FOUND if user or test was not found
 */
-gboolean run_user_test(gchar* user, gchar* testname) {
+gint run_user_test(gchar* user, gchar* testname) {
 	user_preference* prefs = NULL;
-	gboolean rval = FALSE;
+	gint rval = EXIT_NOT_FOUND;
 	
 	if(!user || !testname) return rval;
 
@@ -215,31 +274,156 @@ gboolean run_user_test(gchar* user, gchar* testname) {
 	
 		// Get test and when found run it
 		testcase* test = preference_get_test(prefs,testname);
-		if(test) {
-			g_print("Running test \"%s\" to %s (with %d files)\n",
-					test->name,test->URL,g_hash_table_size(test->files));
-				
-			// Init
-			tests_initialize(test);
-		
-			// Run
-			if(tests_run_test(prefs->username,test)) 
-				g_print("Test %s completed with failures.\n",test->name);
-			else g_print("Test %s complete\n",test->name);
+		if(test) rval = run_single_test(prefs->username,test);
 		
-			// REset
-			tests_reset(test);
-			rval = TRUE;
-		}
 		// Test not found
-		else {
-			rval = FALSE;
-			g_print("Test \"%s\" not found\n",testname);
+		else g_print("Test \"%s\" not found\n",testname);
+		
+		destroy_preferences();
+	}
+	
+	return rval;
+}
+
+/**
+* Run the tests of the user assigned to given shard. Tests are split to
+* shards with shard_assign() and run one after another.
+*
+* This is run only when program is called with switch -u for username
+* and --shard i/n.
+*
+* @param user User whose preferences is to be loaded
+* @param index Index of the shard (0...count-1)
+* @param count Amount of shards
+*
+* @return Worst status of the tests (see run_single_test()) or EXIT_NOT_FOUND if user was not found
+*/
+gint run_user_shard(gchar* user, guint index, guint count) {
+	user_preference* prefs = NULL;
+	gint rval = EXIT_TEST_PASSED;
+	
+	if(!user) return EXIT_NOT_FOUND;
+	
+	// Load preferences for this user
+	if(!(prefs = load_preferences(user))) return EXIT_NOT_FOUND;
+	
+	set_parser(prefs->parser);
+	
+	GSList* assigned = shard_assign(prefs,index,count);
+	shard_set_current((gint)index);
+	
+	for(GSList* iter = assigned; iter; iter = g_slist_next(iter))
+		rval = MAX(rval,run_single_test(prefs->username,(testcase*)iter->data));
+	
+	shard_set_current(-1);
+	g_slist_free(assigned);
+	destroy_preferences();
+	return rval;
+}
+
+/**
+* Check the files of the tests of the user without sending any requests.
+* All errors of each test are printed.
+*
+* This is run only when program is called with switches -u and --check,
+* -t limits the check to a single test.
+*
+* @param user User whose preferences is to be loaded
+* @param testname Name of the test to check, NULL checks all tests
+*
+* @return EXIT_TEST_PASSED, EXIT_TEST_FAILED if errors were found or EXIT_NOT_FOUND
+*/
+gint run_user_check(gchar* user, gchar* testname) {
+	user_preference* prefs = NULL;
+	gint rval = EXIT_TEST_PASSED;
+	
+	if(!user) return EXIT_NOT_FOUND;
+	
+	// Load preferences for this user
+	if(!(prefs = load_preferences(user))) return EXIT_NOT_FOUND;
+	
+	for(GSequenceIter* iter = g_sequence_get_begin_iter(prefs->tests); 
+		!g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+		testcase* test = (testcase*)g_sequence_get(iter);
+		
+		if(testname && g_strcmp0(test->name,testname) != 0) continue;
+		
+		guint errors = tests_check_test(prefs->username,test);
+		if(errors > 0) {
+			g_print("Test %s has %u errors\n",test->name,errors);
+			rval = EXIT_TEST_FAILED;
 		}
+		else g_print("Test %s is valid\n",test->name);
+	}
+	
+	if(testname && !preference_get_test(prefs,testname)) {
+		g_print("Test \"%s\" not found\n",testname);
+		rval = EXIT_NOT_FOUND;
+	}
+	
+	destroy_preferences();
+	return rval;
+}
+
+/**
+* Run a test of the user repeatedly for given duration to find drift.
+* Each iteration is a complete run including cleanup. Latencies of the
+* steps are sampled after each run and memory usage of testfw after the
+* test is reset. Drift of the samples is reported at the end.
+*
+* This is run only when program is called with switches -u, -t and --soak.
+*
+* @param user User whose preferences is to be loaded
+* @param testname Name of the user's test to run
+* @param seconds Duration of the soak in seconds
+*
+* @return Worst status of the runs, at least EXIT_TEST_SLOW if latency growth was found, or EXIT_NOT_FOUND
+*/
+gint run_user_soak(gchar* user, gchar* testname, gint64 seconds) {
+	user_preference* prefs = NULL;
+	gint rval = EXIT_TEST_PASSED;
+	guint iterations = 0, failures = 0;
+	
+	if(!user || !testname) return EXIT_NOT_FOUND;
+
+	// Load preferences for this user
+	if(!(prefs = load_preferences(user))) return EXIT_NOT_FOUND;
+	
+	testcase* test = preference_get_test(prefs,testname);
+	if(!test) {
+		g_print("Test \"%s\" not found\n",testname);
 		destroy_preferences();
+		return EXIT_NOT_FOUND;
+	}
+	
+	set_parser(prefs->parser);
+	soak_start();
+	
+	gint64 end = g_get_monotonic_time() + seconds * G_USEC_PER_SEC;
+	
+	while(g_get_monotonic_time() < end) {
+		g_print("Soak iteration %u of test \"%s\"\n",++iterations,test->name);
+		
+		tests_initialize(test);
+		if(!tests_run_test(prefs->username,test)) {
+			rval = EXIT_TEST_FAILED;
+			failures++;
+		}
+		else if(tests_get_slow_steps() > 0) rval = MAX(rval,EXIT_TEST_SLOW);
+		
+		// Results are cleared on reset, memory is sampled after it
+		soak_sample_latencies(results_get());
+		tests_reset(test);
+		results_clear_reports();
+		soak_sample_memory();
 	}
-	else rval = FALSE;
 	
+	g_print("Soak of test %s: %u iterations, %u failed\n",test->name,iterations,failures);
+	// Growth of testfw memory is only reported, it is not slowness of the test
+	if(soak_report() > 0) rval = MAX(rval,EXIT_TEST_SLOW);
+	
+	soak_clear();
+	destroy_preferences();
 	return rval;
 }
 
@@ -250,9 +434,37 @@ int main(int argc, char *argv[]) {
 	gint optc = -1;
 	gchar* user = NULL;
 	gchar* test = NULL;
+	gchar* resume = NULL;
+	gchar* shard = NULL;
+	gchar* report = NULL;
+	gchar* merge = NULL;
+	gchar* soak = NULL;
+	gboolean check = FALSE;
+	gboolean update_durations = FALSE;
+	gchar* bench = NULL;
+	
+	static struct option long_options[] = {
+		{"user",		required_argument,	0,	'u'},
+		{"test",		required_argument,	0,	't'},
+		{"resume-from",	required_argument,	0,	'r'},
+		{"keep",		no_argument,		0,	'k'},
+		{"bounded-memory",	no_argument,	0,	'b'},
+		{"deadline",	required_argument,	0,	'd'},
+		{"rate",		required_argument,	0,	'p'},
+		{"max-in-flight",	required_argument,	0,	'i'},
+		{"shard",		required_argument,	0,	's'},
+		{"results",		required_argument,	0,	'o'},
+		{"merge",		required_argument,	0,	'm'},
+		{"soak",		required_argument,	0,	'S'},
+		{"check",		no_argument,		0,	'c'},
+		{"json-backend",	required_argument,	0,	'j'},
+		{"bench-json",	required_argument,	0,	'B'},
+		{"update-durations",	no_argument,	0,	'U'},
+		{0,				0,					0,	0}
+	};
 	
 	// Check command line options
-	while ((optc = getopt(argc,argv,"u:t:")) != -1) {
+	while ((optc = getopt_long(argc,argv,"u:t:r:kbd:p:i:s:o:m:S:cj:B:U",long_options,NULL)) != -1) {
 		switch (optc) {
 			case 'u':
 				user = optarg;
@@ -260,18 +472,149 @@ int main(int argc, char *argv[]) {
 			case 't':
 				test = optarg;
 				break;
+			case 'r':
+				resume = optarg;
+				break;
+			case 'k':
+				tests_set_keep_resources(TRUE);
+				break;
+			case 'b':
+				tests_set_bounded_memory(TRUE);
+				break;
+			case 'd':
+				if(string_is_integer(optarg)) tests_set_deadline((guint)g_ascii_strtoull(optarg,NULL,10));
+				else g_print("Invalid deadline \"%s\", expected seconds\n",optarg);
+				break;
+			case 'p':
+				if(string_is_decimal(optarg) && g_ascii_strtod(optarg,NULL) > 0.0) pacing_set_rate(g_ascii_strtod(optarg,NULL));
+				else g_print("Invalid rate \"%s\", expected requests per second\n",optarg);
+				break;
+			case 'i':
+				if(string_is_integer(optarg)) pacing_set_max_in_flight((guint)g_ascii_strtoull(optarg,NULL,10));
+				else g_print("Invalid max in flight \"%s\"\n",optarg);
+				break;
+			case 's':
+				shard = optarg;
+				break;
+			case 'o':
+				report = optarg;
+				break;
+			case 'm':
+				merge = optarg;
+				break;
+			case 'S':
+				soak = optarg;
+				break;
+			case 'c':
+				check = TRUE;
+				break;
+			case 'j':
+				if(!jsonbackend_select(optarg)) return 1;
+				break;
+			case 'B':
+				bench = optarg;
+				break;
+			case 'U':
+				update_durations = TRUE;
+				break;
 			default:
 				break;
 		}
 	}
 	
+	// Caches shared by the connections and pacing of the URLs are kept until exit
+	atexit(http_shutdown);
+	atexit(pacing_clear);
+	
+	// Merge results of shards, remaining arguments are the results to merge
+	if(merge) {
+		if(optind >= argc) {
+			g_print("Merging requires result files: --merge (output) (results)...\n");
+			return 1;
+		}
+		return results_merge(merge,&argv[optind]) ? 0 : 1;
+	}
+	
+	// Compare json backends, remaining arguments are the paths to search
+	if(bench) {
+		if(g_file_test(bench,G_FILE_TEST_IS_DIR)) return jsonbackend_bench_corpus(bench) ? 0 : 1;
+		if(optind >= argc) {
+			g_print("Benchmark requires paths to search: --bench-json (file) (path)... or --bench-json (directory)\n");
+			return 1;
+		}
+		return jsonbackend_bench(bench,&argv[optind]) ? 0 : 1;
+	}
+	
+	// Merge durations of the finished shards to the history of the next split
+	if(update_durations) {
+		if(!user) {
+			g_print("Updating durations requires user (-u).\n");
+			return 1;
+		}
+		return shard_update_durations(user) ? 0 : 1;
+	}
+	
+	// Validate files without touching the network
+	if(check) {
+		if(!user) {
+			g_print("Checking requires user (-u), test (-t) is optional.\n");
+			return 1;
+		}
+		gint status = run_user_check(user,test);
+		if(status == EXIT_NOT_FOUND) g_print("No such user or test found.\n");
+		return status;
+	}
+	
+	// Run tests of a single shard
+	if(shard) {
+		guint index = 0, count = 0;
+		
+		if(!user || test || !shard_parse(shard,&index,&count)) {
+			g_print("Sharding requires user (-u) without test and shard as i/n (1 <= i <= n).\n");
+			return 1;
+		}
+		gint status = run_user_shard(user,index,count);
+		if(status == EXIT_NOT_FOUND) {
+			g_print("No such user found.\n");
+			return status;
+		}
+		if(report) results_write_report(report,user,shard);
+		results_clear_reports();
+		return status;
+	}
+	
+	// Run a single test repeatedly for given duration
+	if(soak) {
+		gint64 seconds = 0;
+		
+		if(!user || !test || resume || !soak_parse_duration(soak,&seconds)) {
+			g_print("Soak requires user (-u), test (-t) and duration as seconds or with suffix s, m or h.\n");
+			return 1;
+		}
+		gint status = run_user_soak(user,test,seconds);
+		if(status == EXIT_NOT_FOUND) g_print("No such user or test found.\n");
+		return status;
+	}
+	
+	// Resuming is possible only for a single test
+	if(resume) {
+		if(!user || !test) {
+			g_print("Resuming requires both user (-u) and test (-t).\n");
+			return 1;
+		}
+		tests_set_resume_point(resume);
+	}
+	
 	// Run from CLI
 	if(user && test) {
-		if(!run_user_test(user,test)) {
+		gint status = run_user_test(user,test);
+		if(status == EXIT_NOT_FOUND) {
 			g_print("No such user or test found.\n");
-			return 1;
+			return status;
 		}
-		return 0;
+		if(report) results_write_report(report,user,NULL);
+		results_clear_reports();
+		return status;
 	}
 	
 	// Run without parameters -> user selection
@@ -0,0 +1,205 @@
+#include <string.h>
+#include "pacing.h"
+
+static GHashTable* pacers = NULL; // Hash table of pacer_t structures, base URL as key
+static gdouble rate_override = 0.0; // Rate set for all base URLs, 0 if not set
+static guint in_flight_override = 0; // Max in flight set for all base URLs, 0 if not set
+
+/**
+* Free a single pacer_t, called by GHashTable destroy notification.
+*
+* @param data Pointer to pacer to free
+*/
+static void free_pacer(gpointer data) {
+	pacer* pc = (pacer*)data;
+	if(pc) {
+		g_free(pc->base);
+		g_free(pc);
+	}
+}
+
+/**
+* Set rate of requests for all base URLs, overrides the rate set in preferences.
+*
+* @param rate Requests per second, 0 to use rate of preferences
+*/
+void pacing_set_rate(gdouble rate) {
+	rate_override = rate > 0.0 ? rate : 0.0;
+}
+
+/**
+* Set maximum amount of requests in flight for all base URLs, overrides
+* the limit set in preferences.
+*
+* @param max Maximum amount of concurrent requests, 0 to use limit of preferences
+*/
+void pacing_set_max_in_flight(guint max) {
+	in_flight_override = max;
+}
+
+/**
+* Add the tokens accumulated since last refill, up to burst.
+*
+* @param pc Pacer to refill
+* @param now Current monotonic time
+*/
+static void pacing_refill(pacer* pc, gint64 now) {
+	pc->tokens += pc->rate * (now - pc->refilled) / G_USEC_PER_SEC;
+	if(pc->tokens > pc->burst) pc->tokens = pc->burst;
+	pc->refilled = now;
+}
+
+/**
+* Configure pacing of requests to given base URL. Requests are paced with
+* a token bucket: rate tokens are added each second up to burst and each
+* request takes one. Buckets are kept for the process, old configuration
+* of the base URL is replaced but its tokens and the collected statistics
+* are kept, so a run following another does not start with a full burst.
+*
+* @param base Base URL, requests to URLs starting with this are paced
+* @param rate Requests per second, 0 disables rate limiting
+* @param burst Amount of requests that can be sent at once, at least 1
+* @param max_in_flight Maximum amount of concurrent requests, 0 is unlimited
+*/
+void pacing_configure(const gchar* base, gdouble rate, guint burst, guint max_in_flight) {
+	if(!base) return;
+	
+	if(!pacers) pacers = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)free_pacer);
+	
+	pacer* pc = (pacer*)g_hash_table_lookup(pacers,base);
+	gint64 now = g_get_monotonic_time();
+	
+	if(!pc) {
+		pc = g_new0(struct pacer_t,1);
+		pc->base = g_strdup(base);
+		pc->tokens = (gdouble)MAX(1,burst);
+		pc->refilled = now;
+		g_hash_table_insert(pacers,g_strdup(base),pc);
+	}
+	
+	// Tokens accumulated with the old rate, limited by the new burst
+	else pacing_refill(pc,now);
+	
+	pc->rate = rate_override > 0.0 ? rate_override : rate;
+	pc->burst = (gdouble)MAX(1,burst);
+	pc->max_in_flight = in_flight_override > 0 ? in_flight_override : max_in_flight;
+	pc->tokens = MIN(pc->tokens,pc->burst);
+}
+
+/**
+* Find the pacer of the url, the one with the longest matching base URL.
+*
+* @param url URL of the request
+*
+* @return Pacer or NULL if url has no pacing
+*/
+static pacer* pacing_find(const gchar* url) {
+	if(!pacers || !url) return NULL;
+	
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	pacer* found = NULL;
+	
+	g_hash_table_iter_init(&iter,pacers);
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		pacer* pc = (pacer*)value;
+		if(g_str_has_prefix(url,pc->base) && (!found || strlen(pc->base) > strlen(found->base)))
+			found = pc;
+	}
+	return found;
+}
+
+/**
+* Try to take a token and a slot for a request without waiting.
+*
+* @param url URL of the request
+* @param wait Set to time to wait before next try in microseconds, can be NULL
+*
+* @return TRUE when request can be sent, pacing_release() must be called after it
+*/
+gboolean pacing_try_acquire(const gchar* url, gint64* wait) {
+	pacer* pc = pacing_find(url);
+	if(wait) *wait = 0;
+	if(!pc) return TRUE;
+	
+	// Slot is freed only by a finished request, check again later
+	if(pc->max_in_flight > 0 && pc->in_flight >= pc->max_in_flight) {
+		if(wait) *wait = PACING_MIN_SLEEP_US;
+		return FALSE;
+	}
+	
+	if(pc->rate > 0.0) {
+		pacing_refill(pc,g_get_monotonic_time());
+		
+		if(pc->tokens < 1.0) {
+			if(wait) *wait = MAX(PACING_MIN_SLEEP_US,(gint64)((1.0 - pc->tokens) * G_USEC_PER_SEC / pc->rate));
+			return FALSE;
+		}
+		pc->tokens -= 1.0;
+	}
+	
+	pc->in_flight++;
+	return TRUE;
+}
+
+/**
+* Take a token and a slot for a request, waits until they are available.
+* Requests are sent one at a time by the caller, so a slot is always
+* released before the next blocking request.
+*
+* @param url URL of the request
+*
+* @return Time waited in microseconds, pacing_release() must be called after request
+*/
+gint64 pacing_acquire(const gchar* url) {
+	gint64 start = g_get_monotonic_time();
+	gint64 wait = 0;
+	
+	while(!pacing_try_acquire(url,&wait)) g_usleep((gulong)wait);
+	
+	gint64 waited = g_get_monotonic_time() - start;
+	pacer* pc = pacing_find(url);
+	if(pc) pc->waited_us += waited;
+	return waited;
+}
+
+/**
+* Release the slot of a finished request.
+*
+* @param url URL of the request
+*/
+void pacing_release(const gchar* url) {
+	pacer* pc = pacing_find(url);
+	if(pc && pc->in_flight > 0) pc->in_flight--;
+}
+
+/**
+* Print the total time waited for pacing of each base URL.
+*/
+void pacing_print_stats() {
+	if(!pacers) return;
+	
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	
+	g_hash_table_iter_init(&iter,pacers);
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		pacer* pc = (pacer*)value;
+		if(pc->rate > 0.0 || pc->max_in_flight > 0) 
+			g_print("Pacing of %s (%.1f/s, burst %.0f, max in flight %u): waited %.1f ms\n",
+				pc->base,pc->rate,pc->burst,pc->max_in_flight,pc->waited_us / 1000.0);
+	}
+}
+
+/**
+* Remove all pacing configuration and the buckets. Called at exit of the
+* process.
+*/
+void pacing_clear() {
+	if(pacers) g_hash_table_destroy(pacers);
+	pacers = NULL;
+}
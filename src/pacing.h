@@ -0,0 +1,19 @@
+#ifndef __PACING_H_
+#define __PACING_H_
+
+#include "definitions.h"
+
+#define PACING_MIN_SLEEP_US 1000
+
+void pacing_set_rate(gdouble rate);
+void pacing_set_max_in_flight(guint max);
+void pacing_configure(const gchar* base, gdouble rate, guint burst, guint max_in_flight);
+
+gint64 pacing_acquire(const gchar* url);
+gboolean pacing_try_acquire(const gchar* url, gint64* wait);
+void pacing_release(const gchar* url);
+
+void pacing_print_stats();
+void pacing_clear();
+
+#endif
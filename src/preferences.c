@@ -1,4 +1,6 @@
 #include "preferences.h"
+#include "urltemplate.h"
+#include "capture.h"
 #include "utils.h"
 
 static GHashTable* userlist = NULL;
@@ -55,6 +57,138 @@ user_preference* load_preferences(const gchar* username) {
 	return NULL;
 }
 
+/**
+* Get unsigned integer value of member field given as string. 
+*
+* @param reader Reader containing the object with member
+* @param member Name of the member field
+* @param value Value to return if member was not found or is invalid
+*
+* @return Value of the member or given value
+*/
+static guint get_member_uint(JsonReader* reader, const gchar* member, guint value) {
+	gchar* string = get_json_member_string(reader,member);
+	
+	if(string && string_is_integer(string)) value = (guint)g_ascii_strtoull(string,NULL,10);
+	g_free(string);
+	return value;
+}
+
+/**
+* Read timeouts from members connect_timeout_ms, timeout_ms, low_speed_bytes
+* and low_speed_s. Timeouts that are not set are kept as they are.
+*
+* @param reader Reader at the object containing timeouts
+* @param tout Timeouts to update
+*/
+static void read_timeouts(JsonReader* reader, timeouts* tout) {
+	tout->connect_ms = get_member_uint(reader,"connect_timeout_ms",tout->connect_ms);
+	tout->total_ms = get_member_uint(reader,"timeout_ms",tout->total_ms);
+	tout->low_speed_bytes = get_member_uint(reader,"low_speed_bytes",tout->low_speed_bytes);
+	tout->low_speed_s = get_member_uint(reader,"low_speed_s",tout->low_speed_s);
+}
+
+/**
+* Read paths whose GET replies are cached on disk from "cacheable" array,
+* e.g. "cacheable": [ "products", "units" ]. A path matches every URL
+* under base URL starting with it.
+*
+* @param reader Reader at the test element
+* @param test Test to add paths to
+*/
+static void read_cacheable(JsonReader* reader, testcase* test) {
+	
+	// Not mandatory, nothing is cached by default
+	if(json_reader_read_member(reader,"cacheable") && json_reader_is_array(reader)) {
+		for(gint pathidx = 0; pathidx < json_reader_count_elements(reader); pathidx++) {
+			json_reader_read_element(reader,pathidx);
+			const gchar* path = json_reader_get_string_value(reader);
+			if(path && *path) test->cacheable = g_slist_append(test->cacheable,g_strdup(path));
+			json_reader_end_element(reader);
+		}
+	}
+	json_reader_end_member(reader);
+}
+
+/**
+* Read values captured from the reply of the file from "capture" object,
+* e.g. "capture": { "case": "data.guid" }. Member is the name of the value
+* in capture store and its value is the path of the value in the reply.
+*
+* @param reader Reader at the file element
+* @param tfile Testfile to add captures to
+*/
+static void read_captures(JsonReader* reader, testfile* tfile) {
+	
+	// Not mandatory
+	if(json_reader_read_member(reader,"capture") && json_reader_is_object(reader)) {
+		gchar** members = json_reader_list_members(reader);
+		
+		for(gint membidx = 0; members && members[membidx] != NULL; membidx++) {
+			gchar* path = get_json_member_string(reader,members[membidx]);
+			capture* cap = capture_add(&(tfile->captures),members[membidx],path);
+			
+			if(cap) cap->declared = TRUE;
+			else g_print("Invalid capture \"%s\" of file id \"%s\"\n",members[membidx],tfile->id);
+			g_free(path);
+		}
+		g_strfreev(members);
+	}
+	json_reader_end_member(reader);
+}
+
+/**
+* Read retry policies of the test from "retry" object. Each member of
+* the object is a method with an object containing the policy, e.g.:
+* "retry": { "GET": { "attempts": "3", "hedge": "yes" } }
+* Fields: attempts, backoff_ms, max_backoff_ms, idempotency_key (yes/no),
+* hedge (yes/no, GET only) and hedge_ms. POST is retried only when
+* idempotency_key is enabled.
+*
+* @param reader Reader at the test element
+* @param test Test to add policies to
+*/
+static void read_retry_policies(JsonReader* reader, testcase* test) {
+	
+	// Not mandatory, no retries by default
+	if(json_reader_read_member(reader,"retry") && json_reader_is_object(reader)) {
+		gchar** methods = json_reader_list_members(reader);
+		
+		for(gint methodidx = 0; methods && methods[methodidx] != NULL; methodidx++) {
+			json_reader_read_member(reader,methods[methodidx]);
+			
+			retry_policy* policy = retry_policy_initialize();
+			
+			policy->attempts = MAX(1,get_member_uint(reader,"attempts",policy->attempts));
+			policy->backoff_ms = get_member_uint(reader,"backoff_ms",policy->backoff_ms);
+			policy->max_backoff_ms = get_member_uint(reader,"max_backoff_ms",policy->max_backoff_ms);
+			policy->hedge_ms = get_member_uint(reader,"hedge_ms",policy->hedge_ms);
+			
+			gchar* idempotency = get_json_member_string(reader,"idempotency_key");
+			gchar* hedge = get_json_member_string(reader,"hedge");
+			policy->idempotency_key = g_strcmp0(idempotency,"yes") == 0;
+			policy->hedge = g_strcmp0(hedge,"yes") == 0;
+			g_free(idempotency);
+			g_free(hedge);
+			
+			// Repeating POST could create duplicate resources
+			if(g_strcmp0(methods[methodidx],"POST") == 0 && !policy->idempotency_key && policy->attempts > 1) {
+				g_print("POST is not retried in test \"%s\" without \"idempotency_key\": \"yes\"\n",test->name);
+				policy->attempts = 1;
+			}
+			
+			// Only GET has no side effects when duplicated
+			if(g_strcmp0(methods[methodidx],"GET") != 0) policy->hedge = FALSE;
+			
+			g_hash_table_replace(test->retries,g_strdup(methods[methodidx]),policy);
+			
+			json_reader_end_member(reader);
+		}
+		g_strfreev(methods);
+	}
+	json_reader_end_member(reader);
+}
+
 /**
 * Reads preference file of the given user. First reads the
 * "tests" array from the parser loaded in user_preferences.
@@ -69,7 +203,8 @@ user_preference* load_preferences(const gchar* username) {
 * are treated as strings.
 *
 * Files have to have following 5 member field names: id, file,
-* path, method, delete.
+* path, method, delete. Paths are compiled to templates whose
+* variables refer to files by their optional name or id.
 *
 * @param preferences in which the parser is that has the file loaded
 *
@@ -109,6 +244,34 @@ gboolean read_preferences(user_preference* preferences) {
 			g_free(url);
 			g_free(name);
 			g_free(encoding);
+			
+			// Optional, release replies when no longer needed
+			gchar *bounded = get_json_member_string(reader,"bounded_memory");
+			if(test && g_strcmp0(bounded,"yes") == 0) test->bounded_memory = TRUE;
+			g_free(bounded);
+			
+			if(test) {
+				read_retry_policies(reader,test);
+				
+				// Optional, defaults for files and deadline of the whole run
+				read_timeouts(reader,&(test->timeouts));
+				test->deadline_s = get_member_uint(reader,"deadline_s",test->deadline_s);
+				test->reserve_s = get_member_uint(reader,"cleanup_reserve_s",test->reserve_s);
+				
+				// Optional, pacing of requests to URL
+				gchar* rate = get_json_member_string(reader,"rate_per_s");
+				if(rate) test->rate = MAX(0.0,g_ascii_strtod(rate,NULL));
+				g_free(rate);
+				test->burst = get_member_uint(reader,"burst",test->burst);
+				test->max_in_flight = get_member_uint(reader,"max_in_flight",test->max_in_flight);
+				
+				read_cacheable(reader,test);
+				
+				// Optional, connection is opened while loading by default
+				gchar *prewarm = get_json_member_string(reader,"prewarm");
+				if(g_strcmp0(prewarm,"no") == 0) test->prewarm = FALSE;
+				g_free(prewarm);
+			}
 				
 			// Add test 
 			preference_add_test(preferences,test);
@@ -169,6 +332,20 @@ gboolean read_preferences(user_preference* preferences) {
 							// Initialize new testfile_t
 							testfile* tfile = testfile_initialize(id,file,path,method,need_delete);
 							
+							// Timeouts of the test unless set for the file
+							tfile->timeouts = test->timeouts;
+							read_timeouts(reader,&(tfile->timeouts));
+							
+							// Optional latency budgets
+							tfile->max_latency_ms = get_member_uint(reader,"max_latency_ms",0);
+							tfile->p95_latency_ms = get_member_uint(reader,"p95_latency_ms",0);
+							
+							// Optional name used in path templates of other files
+							tfile->name = get_json_member_string(reader,"name");
+							
+							// Optional values taken from the reply when it arrives
+							read_captures(reader,tfile);
+							
 							// add it
 							if(!testcase_add_file(test,tfile)) 
 								g_print("replaced old data in test %s\n", test->name);
@@ -187,6 +364,9 @@ gboolean read_preferences(user_preference* preferences) {
 				else g_print("Cannot read file list, \"files\" is not an array\n");
 			}
 			json_reader_end_member(reader); // files
+			
+			// Paths are compiled once all files are known
+			if(test) urltemplate_compile_test(test);
 
 			json_reader_end_element(reader); // test at testidx
 		}
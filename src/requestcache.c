@@ -0,0 +1,132 @@
+#include "requestcache.h"
+#include "jsonutils.h"
+#include "jsonbackend.h"
+#include "utils.h"
+
+static GHashTable* requests = NULL; // Hash table of cached_request_t structures, "method url" as key
+static guint cache_hits = 0; // Lookups served from cache
+static guint cache_misses = 0; // Lookups that sent the request
+
+/**
+* Free a single cached_request_t, called by GHashTable destroy notification.
+*
+* @param data Pointer to cached request to free
+*/
+static void free_cached_request(gpointer data) {
+	cached_request* req = (cached_request*)data;
+	if(req) {
+		free_jsonreply(req->reply);
+		g_free(req);
+	}
+}
+
+/**
+* Check whether requests with method can be shared, only requests
+* without side effects are.
+*
+* @param method Method of the request
+*
+* @return TRUE when replies to method can be cached
+*/
+static gboolean requestcache_method_cacheable(const gchar* method) {
+	return g_strcmp0(method,"GET") == 0 || g_strcmp0(method,"HEAD") == 0;
+}
+
+/**
+* Lookup a reply for request from the run cache. When the request is not
+* cached the caller becomes the owner of the request: it must send the
+* request and give the reply with requestcache_complete(). Lookups are
+* done one at a time on the thread running the test, a request is pending
+* only between the lookup and the completion of its owner and a lookup of
+* it then is sent without the cache.
+*
+* @param method Method of the request
+* @param url Url of the request
+* @param owner Set to TRUE when caller must send the request and complete it
+*
+* @return Cached reply (owned by cache, valid until requestcache_clear()) or NULL
+*/
+jsonreply* requestcache_lookup(const gchar* method, const gchar* url, gboolean* owner) {
+	if(owner) *owner = FALSE;
+	if(!method || !url || !owner || !requestcache_method_cacheable(method)) return NULL;
+	
+	gchar* key = g_strjoin(" ",method,url,NULL);
+	jsonreply* reply = NULL;
+	
+	if(!requests) requests = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)free_cached_request);
+	
+	cached_request* req = (cached_request*)g_hash_table_lookup(requests,key);
+	
+	// Owner has not completed the request yet, caller sends it without the cache
+	if(req && req->pending) g_free(key);
+	else if(req) {
+		cache_hits++;
+		reply = req->reply;
+		g_free(key);
+	}
+	else {
+		cache_misses++;
+		req = g_new0(struct cached_request_t,1);
+		req->pending = TRUE;
+		g_hash_table_insert(requests,key,req);
+		*owner = TRUE;
+	}
+	
+	return reply;
+}
+
+/**
+* Complete a request owned by the caller (see requestcache_lookup()). A
+* successful reply is stored to cache and it is parsed here once for all
+* users. Otherwise the request is removed from cache and the next lookup
+* sends it again.
+*
+* @param method Method of the request
+* @param url Url of the request
+* @param reply Reply to the request, can be NULL
+*
+* @return TRUE when cache took the reply, otherwise caller must free it
+*/
+gboolean requestcache_complete(const gchar* method, const gchar* url, jsonreply* reply) {
+	if(!method || !url || !requests) return FALSE;
+	
+	gchar* key = g_strjoin(" ",method,url,NULL);
+	gboolean stored = FALSE;
+	
+	// Parse or check before sharing
+	gboolean usable = reply && reply->outcome == OUTCOME_OK && jsonbackend_validate(reply);
+	
+	cached_request* req = (cached_request*)g_hash_table_lookup(requests,key);
+	if(req && req->pending) {
+		if(usable) {
+			req->reply = reply;
+			req->pending = FALSE;
+			stored = TRUE;
+		}
+		else g_hash_table_remove(requests,key);
+	}
+	
+	g_free(key);
+	return stored;
+}
+
+/**
+* Print the statistics of the run cache.
+*/
+void requestcache_print_stats() {
+	if(cache_hits + cache_misses == 0) return;
+	g_print("Request cache: %u sent, %u served from cache\n",cache_misses,cache_hits);
+}
+
+/**
+* Remove all cached replies and clear statistics, called when the run ends.
+*/
+void requestcache_clear() {
+	if(requests) g_hash_table_destroy(requests);
+	requests = NULL;
+	cache_hits = cache_misses = 0;
+}
@@ -0,0 +1,12 @@
+#ifndef __REQUESTCACHE_H_
+#define __REQUESTCACHE_H_
+
+#include "definitions.h"
+
+jsonreply* requestcache_lookup(const gchar* method, const gchar* url, gboolean* owner);
+gboolean requestcache_complete(const gchar* method, const gchar* url, jsonreply* reply);
+
+void requestcache_print_stats();
+void requestcache_clear();
+
+#endif
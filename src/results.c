@@ -0,0 +1,499 @@
+#include "results.h"
+#include "jsonutils.h"
+
+static GSList *results = NULL; // List of result_t structures of the run
+static gchar *current_test = NULL; // Name of the test being run
+static GSList *reports = NULL; // List of JsonNode reports of finished tests
+static guint64 histogram[RESULTS_BUCKETS] = { 0 }; // Latencies of all finished tests
+
+// Upper bounds of latency histogram buckets in milliseconds, last is unlimited
+static const gint64 bucket_bounds[RESULTS_BUCKETS] = 
+	{ 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, G_MAXINT64 };
+
+/**
+* Start collecting results for the given test. Results of previous
+* test are cleared.
+*
+* @param testname Name of the test
+*/
+void results_start(const gchar* testname) {
+	results_clear();
+	current_test = g_strdup(testname);
+}
+
+/**
+* Get outcome as string.
+*
+* @param out Outcome
+*
+* @return Constant string describing outcome (don't free this)
+*/
+const gchar* results_outcome_to_string(outcome out) {
+	switch(out) {
+		case OUTCOME_OK: return "ok";
+		case OUTCOME_FAILED: return "failed";
+		case OUTCOME_CONNECT_TIMEOUT: return "connect-timeout";
+		case OUTCOME_TIMEOUT: return "timeout";
+		case OUTCOME_LOW_SPEED: return "low-speed";
+		case OUTCOME_DEADLINE: return "deadline";
+		case OUTCOME_CANCELLED: return "cancelled";
+		case OUTCOME_SLOW: return "slow";
+		default: return "unknown";
+	}
+}
+
+/**
+* Create a new result_t for the current test.
+*
+* @param id File id of the step the request belongs to
+* @param method Method used
+* @param path Path used with REST API URL
+*
+* @return Newly allocated result_t, free with free_result()
+*/
+static result* results_new(const gchar* id, const gchar* method, const gchar* path) {
+	result* res = g_new0(struct result_t,1);
+	res->test = g_strdup(current_test);
+	res->id = g_strdup(id);
+	res->method = g_strdup(method);
+	res->path = g_strdup(path);
+	res->attempt = 1;
+	res->used = TRUE;
+	return res;
+}
+
+/**
+* Add result of a single request to the results of the current test.
+* Each attempt of the request (retries and hedged duplicates) is added
+* as a separate result. Lengths of the data received from network and
+* after decoding are taken from the reply.
+*
+* @param id File id of the step the request belongs to
+* @param method Method used
+* @param path Path used with REST API URL
+* @param reply Reply of the server, can be NULL
+*/
+void results_add(const gchar* id, const gchar* method, const gchar* path, jsonreply* reply) {
+	if(!id || !method) return;
+
+	// No attempt information, e.g. no reply at all
+	if(!reply || !reply->attempts) {
+		result* res = results_new(id,method,path);
+		if(reply) {
+			res->wire_length = reply->wire_length;
+			res->decoded_length = reply->length;
+			res->status = reply->status;
+			res->outcome = reply->outcome;
+		}
+		results = g_slist_append(results,res);
+		return;
+	}
+
+	for(GSList* iter = reply->attempts; iter; iter = g_slist_next(iter)) {
+		attempt* try = (attempt*)iter->data;
+		result* res = results_new(id,method,path);
+
+		res->attempt = try->number;
+		res->hedged = try->hedged;
+		res->used = try->used;
+		res->status = try->status;
+		res->outcome = try->outcome;
+		res->latency_us = try->latency_us;
+		res->queued_us = try->queued_us;
+		res->wire_length = try->wire_length;
+		if(try->used) res->decoded_length = reply->length;
+
+		results = g_slist_append(results,res);
+	}
+}
+
+/**
+* Print summary of the results of the current test: attempt, status,
+* outcome, latency, time waited for pacing and bytes received from network and after decoding for each
+* request and in total. Retried attempts are marked with "r", hedged
+* duplicates with "h" and attempts whose reply was not used with "-".
+* Amount of attempts with each outcome other than ok is listed last.
+*/
+void results_print_summary() {
+	if(!results) return;
+
+	gsize wire = 0, decoded = 0;
+	guint requests = 0, attempts = 0;
+	guint outcomes[OUTCOME_SLOW + 1] = { 0 };
+	gint64 network = 0, queued = 0;
+
+	g_print("Results of test \"%s\":\n",current_test);
+	g_print("id\tmethod\ttry\tstatus\toutcome\tms\twait ms\twire\tdecoded\tpath\n");
+	g_print("-------------------------------------------------------------------------------\n");
+
+	for(GSList* iter = results; iter; iter = g_slist_next(iter)) {
+		result* res = (result*)iter->data;
+		g_print(" %s\t%s\t%u%s%s%s\t%ld\t%s\t%.1f\t%.1f\t%" G_GSIZE_FORMAT "\t%" G_GSIZE_FORMAT "\t%s\n",res->id,res->method,
+			res->attempt,res->attempt > 1 ? "r" : "",res->hedged ? "h" : "",res->used ? "" : "-",
+			res->status,results_outcome_to_string(res->outcome),
+			res->latency_us / 1000.0,res->queued_us / 1000.0,
+			res->wire_length,res->decoded_length,res->path);
+		wire += res->wire_length;
+		decoded += res->decoded_length;
+		if(res->used) requests++;
+		attempts++;
+		network += res->latency_us;
+		queued += res->queued_us;
+		if(res->outcome <= OUTCOME_SLOW) outcomes[res->outcome]++;
+	}
+
+	g_print("Total %u requests in %u attempts: %" G_GSIZE_FORMAT " bytes from network, %" G_GSIZE_FORMAT " bytes decoded",
+		requests,attempts,wire,decoded);
+	if(wire > 0 && decoded > 0) g_print(" (%.1f%%)",100.0 * wire / decoded);
+	g_print("\n");
+	g_print("Time in network %.1f ms, waited for pacing %.1f ms\n",network / 1000.0,queued / 1000.0);
+	
+	for(gint out = OUTCOME_FAILED; out <= OUTCOME_SLOW; out++)
+		if(outcomes[out] > 0) g_print(" %s: %u\n",results_outcome_to_string(out),outcomes[out]);
+	g_print("\n");
+}
+
+/**
+* Get the results of the current test.
+*
+* @return List of result_t structures (don't free this)
+*/
+GSList* results_get() {
+	return results;
+}
+
+/**
+* Clear the results of the current test.
+*/
+void results_clear() {
+	g_slist_free_full(results,(GDestroyNotify)free_result);
+	results = NULL;
+	g_free(current_test);
+	current_test = NULL;
+}
+
+/**
+* Free a single result_t.
+*
+* @param data Pointer to result to free
+*/
+void free_result(gpointer data) {
+	result* res = (result*)data;
+	if(res) {
+		g_free(res->test);
+		g_free(res->id);
+		g_free(res->method);
+		g_free(res->path);
+		g_free(res);
+	}
+}
+
+/**
+* Get the histogram bucket of latency.
+*
+* @param latency_us Latency in microseconds
+*
+* @return Index of the bucket
+*/
+static gint results_get_bucket(gint64 latency_us) {
+	gint bucket = 0;
+	while(bucket < RESULTS_BUCKETS - 1 && latency_us > bucket_bounds[bucket] * 1000) bucket++;
+	return bucket;
+}
+
+/**
+* Add histogram with given counts as member "histogram" to builder.
+*
+* @param builder Builder with an object open
+* @param counts Counts of each bucket
+*/
+static void results_build_histogram(JsonBuilder* builder, const guint64* counts) {
+	json_builder_set_member_name(builder,"histogram");
+	json_builder_begin_object(builder);
+	
+	// Last bucket is unlimited, it has no bound
+	json_builder_set_member_name(builder,"bounds_ms");
+	json_builder_begin_array(builder);
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS - 1; bucket++) 
+		json_builder_add_int_value(builder,bucket_bounds[bucket]);
+	json_builder_end_array(builder);
+	
+	json_builder_set_member_name(builder,"counts");
+	json_builder_begin_array(builder);
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS; bucket++) 
+		json_builder_add_int_value(builder,counts[bucket]);
+	json_builder_end_array(builder);
+	
+	json_builder_end_object(builder);
+}
+
+/**
+* Finish the results of the current test. A structured report of the test
+* with all attempts and a latency histogram is stored for writing it with
+* results_write_report(). Latencies are added to histogram of the run.
+*
+* @param passed TRUE when test passed
+* @param duration_us Duration of the test
+*/
+void results_finish(gboolean passed, gint64 duration_us) {
+	if(!current_test) return;
+	
+	guint64 counts[RESULTS_BUCKETS] = { 0 };
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+	
+	json_builder_set_member_name(builder,"name");
+	json_builder_add_string_value(builder,current_test);
+	json_builder_set_member_name(builder,"passed");
+	json_builder_add_boolean_value(builder,passed);
+	json_builder_set_member_name(builder,"duration_ms");
+	json_builder_add_int_value(builder,duration_us / 1000);
+	
+	json_builder_set_member_name(builder,"requests");
+	json_builder_begin_array(builder);
+	
+	for(GSList* iter = results; iter; iter = g_slist_next(iter)) {
+		result* res = (result*)iter->data;
+		
+		json_builder_begin_object(builder);
+		json_builder_set_member_name(builder,"id");
+		json_builder_add_string_value(builder,res->id);
+		json_builder_set_member_name(builder,"method");
+		json_builder_add_string_value(builder,res->method);
+		json_builder_set_member_name(builder,"path");
+		json_builder_add_string_value(builder,res->path);
+		json_builder_set_member_name(builder,"attempt");
+		json_builder_add_int_value(builder,res->attempt);
+		json_builder_set_member_name(builder,"hedged");
+		json_builder_add_boolean_value(builder,res->hedged);
+		json_builder_set_member_name(builder,"used");
+		json_builder_add_boolean_value(builder,res->used);
+		json_builder_set_member_name(builder,"status");
+		json_builder_add_int_value(builder,res->status);
+		json_builder_set_member_name(builder,"outcome");
+		json_builder_add_string_value(builder,results_outcome_to_string(res->outcome));
+		json_builder_set_member_name(builder,"latency_us");
+		json_builder_add_int_value(builder,res->latency_us);
+		json_builder_set_member_name(builder,"queued_us");
+		json_builder_add_int_value(builder,res->queued_us);
+		json_builder_set_member_name(builder,"wire");
+		json_builder_add_int_value(builder,res->wire_length);
+		json_builder_set_member_name(builder,"decoded");
+		json_builder_add_int_value(builder,res->decoded_length);
+		json_builder_end_object(builder);
+		
+		// Requests that were not sent have no latency
+		if(res->outcome != OUTCOME_DEADLINE || res->latency_us > 0) 
+			counts[results_get_bucket(res->latency_us)]++;
+	}
+	json_builder_end_array(builder);
+	
+	results_build_histogram(builder,counts);
+	json_builder_end_object(builder);
+	
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS; bucket++) histogram[bucket] += counts[bucket];
+	
+	reports = g_slist_append(reports,json_builder_get_root(builder));
+	g_object_unref(builder);
+}
+
+/**
+* Write root node to file as pretty printed json.
+*
+* @param root Root node of json
+* @param path File to write to
+*
+* @return TRUE when file was written
+*/
+static gboolean results_write_json(JsonNode* root, const gchar* path) {
+	GError *error = NULL;
+	JsonGenerator *generator = json_generator_new();
+	json_generator_set_pretty(generator,TRUE);
+	json_generator_set_root(generator,root);
+	
+	gboolean rval = json_generator_to_file(generator,path,&error);
+	if(!rval && error) {
+		g_print("Cannot write results to \"%s\". Reason: %s\n",path,error->message);
+		g_error_free(error);
+	}
+	g_object_unref(generator);
+	return rval;
+}
+
+/**
+* Write reports of all finished tests as json to given file with the
+* latency histogram of all tests. Reports of multiple shards can be
+* combined with results_merge().
+*
+* @param path File to write to
+* @param username User whose tests were run
+* @param shard Shard of the run as "i/n", can be NULL
+*
+* @return TRUE when file was written
+*/
+gboolean results_write_report(const gchar* path, const gchar* username, const gchar* shard) {
+	if(!path) return FALSE;
+	
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+	
+	json_builder_set_member_name(builder,"user");
+	json_builder_add_string_value(builder,username);
+	json_builder_set_member_name(builder,"shard");
+	if(shard) json_builder_add_string_value(builder,shard);
+	else json_builder_add_null_value(builder);
+	
+	results_build_histogram(builder,histogram);
+	
+	json_builder_set_member_name(builder,"tests");
+	json_builder_begin_array(builder);
+	for(GSList* iter = reports; iter; iter = g_slist_next(iter))
+		json_builder_add_value(builder,json_node_copy((JsonNode*)iter->data));
+	json_builder_end_array(builder);
+	
+	json_builder_end_object(builder);
+	
+	JsonNode* root = json_builder_get_root(builder);
+	gboolean rval = results_write_json(root,path);
+	if(rval) g_print("Results of %u tests written to \"%s\"\n",g_slist_length(reports),path);
+	
+	json_node_free(root);
+	g_object_unref(builder);
+	return rval;
+}
+
+/**
+* Estimate percentile of latency from histogram, the upper bound of the
+* bucket containing the percentile is returned.
+*
+* @param counts Counts of each bucket
+* @param percentile Percentile to estimate (0-100)
+*
+* @return Upper bound in milliseconds or -1 if percentile is in the last bucket or no data
+*/
+static gint64 results_histogram_percentile(const guint64* counts, guint percentile) {
+	guint64 total = 0, cumulative = 0;
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS; bucket++) total += counts[bucket];
+	if(total == 0) return -1;
+	
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS - 1; bucket++) {
+		cumulative += counts[bucket];
+		if(cumulative * 100 >= total * percentile) return bucket_bounds[bucket];
+	}
+	return -1;
+}
+
+/**
+* Merge the reports written by results_write_report() for each shard into
+* one report. Tests of all reports are combined and histograms summed. A
+* summary of the merged report is printed.
+*
+* @param output File to write the merged report to
+* @param inputs NULL terminated list of report files
+*
+* @return TRUE when all reports were read and merged report was written
+*/
+gboolean results_merge(const gchar* output, gchar** inputs) {
+	if(!output || !inputs) return FALSE;
+	
+	gboolean rval = TRUE;
+	guint64 counts[RESULTS_BUCKETS] = { 0 };
+	guint tests = 0, passed = 0, requests = 0, shards = 0;
+	gint64 duration = 0;
+	gchar* username = NULL;
+	
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+	json_builder_set_member_name(builder,"tests");
+	json_builder_begin_array(builder);
+	
+	for(gint inputidx = 0; inputs[inputidx]; inputidx++) {
+		JsonParser *parser = json_parser_new();
+		
+		if(!load_json_from_file(parser,inputs[inputidx]) || 
+			json_node_get_node_type(json_parser_get_root(parser)) != JSON_NODE_OBJECT) {
+			g_print("Cannot read results from \"%s\"\n",inputs[inputidx]);
+			g_object_unref(parser);
+			rval = FALSE;
+			continue;
+		}
+		
+		JsonObject* report = json_node_get_object(json_parser_get_root(parser));
+		shards++;
+		
+		if(!username) username = g_strdup(json_object_get_string_member_with_default(report,"user",NULL));
+		
+		// Copy the tests
+		JsonArray* testarray = json_object_has_member(report,"tests") ? 
+			json_object_get_array_member(report,"tests") : NULL;
+		
+		for(guint testidx = 0; testarray && testidx < json_array_get_length(testarray); testidx++) {
+			JsonNode* testnode = json_array_get_element(testarray,testidx);
+			JsonObject* test = json_node_get_object(testnode);
+			
+			tests++;
+			if(json_object_get_boolean_member_with_default(test,"passed",FALSE)) passed++;
+			duration += json_object_get_int_member_with_default(test,"duration_ms",0);
+			if(json_object_has_member(test,"requests"))
+				requests += json_array_get_length(json_object_get_array_member(test,"requests"));
+				
+			json_builder_add_value(builder,json_node_copy(testnode));
+		}
+		
+		// Sum the histogram
+		JsonObject* hist = json_object_has_member(report,"histogram") ? 
+			json_object_get_object_member(report,"histogram") : NULL;
+		JsonArray* histcounts = hist && json_object_has_member(hist,"counts") ? 
+			json_object_get_array_member(hist,"counts") : NULL;
+			
+		for(guint bucket = 0; histcounts && bucket < json_array_get_length(histcounts) && bucket < RESULTS_BUCKETS; bucket++)
+			counts[bucket] += json_node_get_int(json_array_get_element(histcounts,bucket));
+		
+		g_object_unref(parser);
+	}
+	
+	json_builder_end_array(builder);
+	
+	json_builder_set_member_name(builder,"user");
+	json_builder_add_string_value(builder,username);
+	json_builder_set_member_name(builder,"shard");
+	json_builder_add_null_value(builder);
+	json_builder_set_member_name(builder,"shards");
+	json_builder_add_int_value(builder,shards);
+	results_build_histogram(builder,counts);
+	
+	json_builder_end_object(builder);
+	
+	JsonNode* root = json_builder_get_root(builder);
+	if(!results_write_json(root,output)) rval = FALSE;
+	json_node_free(root);
+	g_object_unref(builder);
+	
+	// Summary of merged results
+	g_print("Merged %u reports: %u tests (%u passed, %u failed), %u requests, %.1f s in total\n",
+		shards,tests,passed,tests - passed,requests,duration / 1000.0);
+	g_print("latency ms\tcount\n");
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS; bucket++) {
+		if(bucket < RESULTS_BUCKETS - 1) g_print(" <= %" G_GINT64_FORMAT "\t\t%" G_GUINT64_FORMAT "\n",bucket_bounds[bucket],counts[bucket]);
+		else g_print(" > %" G_GINT64_FORMAT "\t%" G_GUINT64_FORMAT "\n",bucket_bounds[bucket - 1],counts[bucket]);
+	}
+	
+	guint percentiles[] = { 50, 95, 99 };
+	for(gint index = 0; index < G_N_ELEMENTS(percentiles); index++) {
+		gint64 bound = results_histogram_percentile(counts,percentiles[index]);
+		if(bound >= 0) g_print(" p%u <= %" G_GINT64_FORMAT " ms\n",percentiles[index],bound);
+		else if(requests > 0) g_print(" p%u > %" G_GINT64_FORMAT " ms\n",percentiles[index],bucket_bounds[RESULTS_BUCKETS - 2]);
+	}
+	
+	g_free(username);
+	return rval;
+}
+
+/**
+* Clear the reports of finished tests and the histogram of the run.
+*/
+void results_clear_reports() {
+	g_slist_free_full(reports,(GDestroyNotify)json_node_free);
+	reports = NULL;
+	for(gint bucket = 0; bucket < RESULTS_BUCKETS; bucket++) histogram[bucket] = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef __RESULTS_H_
+#define __RESULTS_H_
+
+#include "definitions.h"
+
+#define RESULTS_BUCKETS 14
+
+void results_start(const gchar* testname);
+void results_add(const gchar* id, const gchar* method, const gchar* path, jsonreply* reply);
+void results_print_summary();
+void results_clear();
+GSList* results_get();
+
+const gchar* results_outcome_to_string(outcome out);
+
+void results_finish(gboolean passed, gint64 duration_us);
+gboolean results_write_report(const gchar* path, const gchar* username, const gchar* shard);
+gboolean results_merge(const gchar* output, gchar** inputs);
+void results_clear_reports();
+
+void free_result(gpointer data);
+
+#endif
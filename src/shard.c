@@ -0,0 +1,339 @@
+#include <string.h>
+#include "shard.h"
+#include <glib/gstdio.h>
+
+static gint current_shard = -1; // Index of the shard of the following runs, -1 when not sharding
+
+/**
+* Parse shard specification "i/n" where i is the shard (1...n) and n
+* the amount of shards.
+*
+* @param spec Specification to parse
+* @param index Set to index of the shard (0...n-1)
+* @param count Set to amount of shards
+*
+* @return TRUE when specification was valid
+*/
+gboolean shard_parse(const gchar* spec, guint* index, guint* count) {
+	if(!spec || !index || !count) return FALSE;
+	
+	gchar** split = g_strsplit(spec,"/",2);
+	gboolean rval = FALSE;
+	
+	if(split[0] && split[1] && *split[0] && *split[1]) {
+		gchar *end1 = NULL, *end2 = NULL;
+		guint64 i = g_ascii_strtoull(split[0],&end1,10);
+		guint64 n = g_ascii_strtoull(split[1],&end2,10);
+		
+		if(*end1 == '\0' && *end2 == '\0' && n > 0 && i >= 1 && i <= n) {
+			*index = (guint)i - 1;
+			*count = (guint)n;
+			rval = TRUE;
+		}
+	}
+	g_strfreev(split);
+	return rval;
+}
+
+/**
+* Set the shard the following runs belong to. The durations of the runs
+* are saved to the duration file of the shard.
+*
+* @param index Index of the shard (0...n-1), -1 when not sharding
+*/
+void shard_set_current(gint index) {
+	current_shard = index;
+}
+
+/**
+* Form path to the duration history of the user.
+*
+* @param username User
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* shard_make_path(const gchar* username) {
+	return g_strjoin("/",TESTPATH,username,DURATIONFILE,NULL);
+}
+
+/**
+* Form path to the durations saved by the runs of a shard, runs not part
+* of a shard use index 0.
+*
+* @param username User
+*
+* @return New charstring to be free'd with g_free()
+*/
+static gchar* shard_make_run_path(const gchar* username) {
+	gchar* file = g_strdup_printf(DURATIONFILE_RUN,current_shard + 1);
+	gchar* path = g_strjoin("/",TESTPATH,username,file,NULL);
+	g_free(file);
+	return path;
+}
+
+/**
+* Check whether the file is a duration file of a shard (durations.<index>.tsv).
+*/
+static gboolean shard_is_run_file(const gchar* name) {
+	if(!g_str_has_prefix(name,DURATIONFILE_PREFIX) || !g_str_has_suffix(name,DURATIONFILE_SUFFIX)) return FALSE;
+	
+	const gchar* index = name + strlen(DURATIONFILE_PREFIX);
+	gsize length = strlen(index) - strlen(DURATIONFILE_SUFFIX);
+	if(length == 0) return FALSE;
+	
+	for(gsize pos = 0; pos < length; pos++) if(!g_ascii_isdigit(index[pos])) return FALSE;
+	return TRUE;
+}
+
+/**
+* Read durations from a tab separated file with test name and duration in
+* milliseconds on each line to the hash table, existing are replaced.
+*
+* @param path File to read
+* @param durations Hash table to add to
+*
+* @return TRUE when file was read
+*/
+static gboolean shard_read_durations(const gchar* path, GHashTable* durations) {
+	gchar* contents = NULL;
+	
+	if(!g_file_get_contents(path,&contents,NULL,NULL)) return FALSE;
+	
+	gchar** lines = g_strsplit(contents,"\n",-1);
+	
+	for(gint lineidx = 0; lines[lineidx]; lineidx++) {
+		gchar** fields = g_strsplit(lines[lineidx],"\t",2);
+		
+		if(fields[0] && fields[1] && *fields[0]) {
+			gint64* duration = g_new(gint64,1);
+			*duration = g_ascii_strtoll(fields[1],NULL,10);
+			g_hash_table_replace(durations,g_strdup(fields[0]),duration);
+		}
+		g_strfreev(fields);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	return TRUE;
+}
+
+static GHashTable* shard_new_durations() {
+	return g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)g_free,
+		(GDestroyNotify)g_free);
+}
+
+/**
+* Load the duration history of the tests of the user. The history is a
+* tab separated file with test name and duration in milliseconds on each
+* line. It is changed only by shard_update_durations(), so all shards
+* read the same history.
+*
+* @param username User whose history is loaded
+*
+* @return Hash table with test name as key and pointer to gint64 duration
+* as value, free with g_hash_table_destroy()
+*/
+GHashTable* shard_load_durations(const gchar* username) {
+	GHashTable* durations = shard_new_durations();
+	gchar* path = shard_make_path(username);
+	
+	shard_read_durations(path,durations);
+	g_free(path);
+	return durations;
+}
+
+/**
+* Write a single line of duration history to string. 
+* Called by g_hash_table_foreach() only.
+*/
+static void shard_add_duration_line(gpointer key, gpointer value, gpointer string) {
+	g_string_append_printf((GString*)string,"%s\t%" G_GINT64_FORMAT "\n",(gchar*)key,*(gint64*)value);
+}
+
+/**
+* Write durations to a file.
+*
+* @param path File to write
+* @param durations Hash table of durations to write
+*
+* @return TRUE when file was written
+*/
+static gboolean shard_write_durations(const gchar* path, GHashTable* durations) {
+	GString* contents = g_string_new(NULL);
+	g_hash_table_foreach(durations,(GHFunc)shard_add_duration_line,contents);
+	
+	gboolean rval = g_file_set_contents(path,contents->str,contents->len,NULL);
+	if(!rval) g_print("Cannot save duration history to \"%s\"\n",path);
+	
+	g_string_free(contents,TRUE);
+	return rval;
+}
+
+/**
+* Update the duration of a test in the duration file of the current shard.
+* The new duration is weighted with SHARD_DURATION_WEIGHT and the history
+* with the rest so a single slow run does not change the balance of the
+* shards too much. The history shared by the shards is not changed, the
+* shard files are merged to it with shard_update_durations().
+*
+* @param username User of the test
+* @param testname Name of the test
+* @param duration_ms Duration of the run
+*/
+void shard_save_duration(const gchar* username, const gchar* testname, gint64 duration_ms) {
+	if(!username || !testname) return;
+	
+	gchar* path = shard_make_run_path(username);
+	GHashTable* durations = shard_new_durations();
+	shard_read_durations(path,durations);
+	
+	// Earlier run of this shard is newer than the shared history
+	gint64* old = (gint64*)g_hash_table_lookup(durations,testname);
+	GHashTable* history = old ? NULL : shard_load_durations(username);
+	if(history) old = (gint64*)g_hash_table_lookup(history,testname);
+	
+	gint64* duration = g_new(gint64,1);
+	*duration = old ? (gint64)(*old * (1.0 - SHARD_DURATION_WEIGHT) + duration_ms * SHARD_DURATION_WEIGHT) : duration_ms;
+	g_hash_table_replace(durations,g_strdup(testname),duration);
+	
+	shard_write_durations(path,durations);
+	
+	g_free(path);
+	if(history) g_hash_table_destroy(history);
+	g_hash_table_destroy(durations);
+}
+
+/**
+* Merge the duration files of the shards of the user to the duration
+* history and remove them. Run after all shards have finished, the next
+* split uses the merged history. Files are merged in order of name.
+*
+* @param username User whose durations are merged
+*
+* @return TRUE when history was written or there was nothing to merge
+*/
+gboolean shard_update_durations(const gchar* username) {
+	if(!username) return FALSE;
+	
+	gchar* dir = g_strjoin("/",TESTPATH,username,NULL);
+	GDir* folder = g_dir_open(dir,0,NULL);
+	GSList* files = NULL;
+	
+	if(folder) {
+		const gchar* name = NULL;
+		while((name = g_dir_read_name(folder)))
+			if(shard_is_run_file(name)) files = g_slist_insert_sorted(files,g_strdup(name),(GCompareFunc)g_strcmp0);
+		g_dir_close(folder);
+	}
+	
+	gboolean rval = TRUE;
+	
+	if(files) {
+		GHashTable* durations = shard_load_durations(username);
+		
+		for(GSList* iter = files; iter; iter = g_slist_next(iter)) {
+			gchar* path = g_strjoin("/",dir,(gchar*)iter->data,NULL);
+			shard_read_durations(path,durations);
+			g_free(path);
+		}
+		
+		gchar* path = shard_make_path(username);
+		rval = shard_write_durations(path,durations);
+		g_free(path);
+		
+		// Remove only when merged, otherwise the next update retries
+		for(GSList* iter = files; rval && iter; iter = g_slist_next(iter)) {
+			gchar* path = g_strjoin("/",dir,(gchar*)iter->data,NULL);
+			g_remove(path);
+			g_free(path);
+		}
+		g_print("Merged %u duration files to history of \"%s\"\n",g_slist_length(files),username);
+		g_hash_table_destroy(durations);
+	}
+	
+	g_slist_free_full(files,(GDestroyNotify)g_free);
+	g_free(dir);
+	return rval;
+}
+
+/**
+* Compare function for sorting tests longest first, ties are sorted by
+* name to keep the assignment same on every machine.
+*/
+static gint shard_compare_items(gconstpointer a, gconstpointer b) {
+	const shard_item* first = (const shard_item*)a;
+	const shard_item* second = (const shard_item*)b;
+	
+	if(first->duration != second->duration) return first->duration > second->duration ? -1 : 1;
+	return g_strcmp0(first->test->name,second->test->name);
+}
+
+/**
+* Assign tests of the user to shards and get the tests of given shard.
+* Tests are assigned longest first to the shard with least total duration
+* (ties to lowest index) using the duration history. Tests without history
+* are assumed to take the average duration of the tests with history. The
+* assignment is deterministic, so every process gets the same split as long
+* as they share the preferences and the history. Runs of the shards do not
+* change the history, see shard_update_durations().
+*
+* @param prefs Preferences of the user
+* @param index Index of the shard (0...count-1)
+* @param count Amount of shards
+*
+* @return List of testcases (owned by prefs) of the shard, free with g_slist_free()
+*/
+GSList* shard_assign(user_preference* prefs, guint index, guint count) {
+	if(!prefs || count == 0 || index >= count) return NULL;
+	
+	GHashTable* durations = shard_load_durations(prefs->username);
+	GArray* items = g_array_new(FALSE,FALSE,sizeof(shard_item));
+	gint64 known = 0, total = 0;
+	
+	for(GSequenceIter* iter = g_sequence_get_begin_iter(prefs->tests); 
+		!g_sequence_iter_is_end(iter); 
+		iter = g_sequence_iter_next(iter)) {
+		shard_item item = { (testcase*)g_sequence_get(iter), -1 };
+		if(!item.test) continue;
+		
+		gint64* duration = (gint64*)g_hash_table_lookup(durations,item.test->name);
+		if(duration) {
+			item.duration = *duration;
+			total += *duration;
+			known++;
+		}
+		g_array_append_val(items,item);
+	}
+	
+	// Unknown tests get the average, at least 1 to balance by count without history
+	gint64 average = known > 0 ? MAX(1,total / known) : 1;
+	for(guint itemidx = 0; itemidx < items->len; itemidx++)
+		if(g_array_index(items,shard_item,itemidx).duration < 0) 
+			g_array_index(items,shard_item,itemidx).duration = average;
+	
+	g_array_sort(items,shard_compare_items);
+	
+	gint64* loads = g_new0(gint64,count);
+	GSList* assigned = NULL;
+	
+	for(guint itemidx = 0; itemidx < items->len; itemidx++) {
+		shard_item* item = &g_array_index(items,shard_item,itemidx);
+		guint lightest = 0;
+		
+		for(guint shard = 1; shard < count; shard++) 
+			if(loads[shard] < loads[lightest]) lightest = shard;
+			
+		loads[lightest] += item->duration;
+		if(lightest == index) assigned = g_slist_append(assigned,item->test);
+	}
+	
+	g_print("Shard %u/%u: %u of %u tests, estimated %.1f s\n",index + 1,count,
+		g_slist_length(assigned),items->len,loads[index] / 1000.0);
+	
+	g_free(loads);
+	g_array_free(items,TRUE);
+	g_hash_table_destroy(durations);
+	return assigned;
+}
@@ -0,0 +1,22 @@
+#ifndef __SHARD_H_
+#define __SHARD_H_
+
+#include "definitions.h"
+
+#define DURATIONFILE "durations.tsv"
+#define DURATIONFILE_PREFIX "durations."
+#define DURATIONFILE_SUFFIX ".tsv"
+#define DURATIONFILE_RUN "durations.%d.tsv"
+#define SHARD_DURATION_WEIGHT 0.3
+
+gboolean shard_parse(const gchar* spec, guint* index, guint* count);
+
+void shard_set_current(gint index);
+
+GHashTable* shard_load_durations(const gchar* username);
+void shard_save_duration(const gchar* username, const gchar* testname, gint64 duration_ms);
+gboolean shard_update_durations(const gchar* username);
+
+GSList* shard_assign(user_preference* prefs, guint index, guint count);
+
+#endif
@@ -0,0 +1,256 @@
+#include <math.h>
+#include <malloc.h>
+#include <unistd.h>
+#include "soak.h"
+
+static GHashTable* series = NULL; // Hash table of soak_series_t structures, name as key
+static GSequence* order = NULL; // Names of the series in the order they were added
+static gint64 soak_started = 0; // Monotonic time when soak was started
+static guint memory_samples = 0; // Amount of memory samples taken, including warmup
+
+/**
+* Parse duration given as seconds or with suffix s, m or h (e.g. "90m").
+*
+* @param spec Duration to parse
+* @param seconds Set to the duration in seconds
+*
+* @return TRUE when duration was valid and more than 0
+*/
+gboolean soak_parse_duration(const gchar* spec, gint64* seconds) {
+	if(!spec || !seconds || !g_ascii_isdigit(*spec)) return FALSE;
+	
+	gchar* end = NULL;
+	gint64 value = g_ascii_strtoll(spec,&end,10);
+	
+	if(g_strcmp0(end,"h") == 0) value *= 3600;
+	else if(g_strcmp0(end,"m") == 0) value *= 60;
+	else if(*end != '\0' && g_strcmp0(end,"s") != 0) return FALSE;
+	
+	*seconds = value;
+	return value > 0;
+}
+
+/**
+* Free a single soak_series_t, called by GHashTable destroy notification.
+*
+* @param data Pointer to series to free
+*/
+static void free_soak_series(gpointer data) {
+	soak_series* ser = (soak_series*)data;
+	if(ser) {
+		g_free(ser->name);
+		g_array_free(ser->times,TRUE);
+		g_array_free(ser->values,TRUE);
+		g_free(ser);
+	}
+}
+
+/**
+* Start a new soak, clears the samples of previous soak.
+*/
+void soak_start() {
+	soak_clear();
+	series = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		NULL,
+		(GDestroyNotify)free_soak_series);
+	order = g_sequence_new(NULL);
+	soak_started = g_get_monotonic_time();
+}
+
+/**
+* Add a sample to series with given name, series is created if it does not
+* exist. Time of the sample is the time since the start of the soak.
+*
+* @param name Name of the series
+* @param value Value of the sample
+* @param memory TRUE for a series of testfw memory
+*/
+static void soak_add_sample(const gchar* name, gdouble value, gboolean memory) {
+	if(!series) return;
+	
+	soak_series* ser = (soak_series*)g_hash_table_lookup(series,name);
+	if(!ser) {
+		ser = g_new0(struct soak_series_t,1);
+		ser->name = g_strdup(name);
+		ser->memory = memory;
+		ser->times = g_array_new(FALSE,FALSE,sizeof(gdouble));
+		ser->values = g_array_new(FALSE,FALSE,sizeof(gdouble));
+		g_hash_table_insert(series,ser->name,ser);
+		g_sequence_append(order,ser->name);
+	}
+	
+	gdouble time = (g_get_monotonic_time() - soak_started) / (gdouble)G_USEC_PER_SEC;
+	g_array_append_val(ser->times,time);
+	g_array_append_val(ser->values,value);
+}
+
+/**
+* Sample the latencies of a run. Successful requests of each method and
+* path (as in preferences) are added to own series in milliseconds.
+*
+* @param results List of result_t of the run
+*/
+void soak_sample_latencies(GSList* results) {
+	for(GSList* iter = results; iter; iter = g_slist_next(iter)) {
+		result* res = (result*)iter->data;
+		if(!res->used || (res->outcome != OUTCOME_OK && res->outcome != OUTCOME_SLOW)) continue;
+		
+		gchar* name = g_strjoin(" ",res->method,res->path,NULL);
+		soak_add_sample(name,res->latency_us / 1000.0,FALSE);
+		g_free(name);
+	}
+}
+
+/**
+* Sample the memory usage of testfw: resident set size from /proc and
+* bytes allocated from heap by malloc. The first SOAK_WARMUP samples are
+* skipped as caches and pools are still filling up.
+*/
+void soak_sample_memory() {
+	if(++memory_samples <= SOAK_WARMUP) return;
+	
+	gchar* statm = NULL;
+	if(g_file_get_contents("/proc/self/statm",&statm,NULL,NULL)) {
+		gchar** fields = g_strsplit(statm," ",3);
+		if(fields[0] && fields[1]) 
+			soak_add_sample("testfw RSS (KiB)",
+				g_ascii_strtoll(fields[1],NULL,10) * sysconf(_SC_PAGESIZE) / 1024.0,TRUE);
+		g_strfreev(fields);
+		g_free(statm);
+	}
+	
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+	soak_add_sample("testfw heap (KiB)",info.uordblks / 1024.0,TRUE);
+}
+
+/**
+* Calculate least squares slope of values over time.
+*
+* @param ser Series
+* @param first Index of the first sample to use
+*
+* @return Slope in units per hour
+*/
+static gdouble soak_slope(soak_series* ser, guint first) {
+	gdouble meant = 0.0, meanv = 0.0, cov = 0.0, var = 0.0;
+	guint n = ser->values->len - first;
+	
+	for(guint index = first; index < ser->values->len; index++) {
+		meant += g_array_index(ser->times,gdouble,index) / n;
+		meanv += g_array_index(ser->values,gdouble,index) / n;
+	}
+	for(guint index = first; index < ser->values->len; index++) {
+		gdouble dt = g_array_index(ser->times,gdouble,index) - meant;
+		cov += dt * (g_array_index(ser->values,gdouble,index) - meanv);
+		var += dt * dt;
+	}
+	return var > 0.0 ? cov / var * 3600.0 : 0.0;
+}
+
+/**
+* Calculate Mann-Kendall trend statistic of the values. Positive Z tells
+* of increasing trend, |Z| > 1.96 is significant at 5% level.
+*
+* @param ser Series
+* @param first Index of the first sample to use
+*
+* @return Z statistic
+*/
+static gdouble soak_mann_kendall(soak_series* ser, guint first) {
+	guint n = ser->values->len - first;
+	gint64 s = 0;
+	
+	for(guint i = first; i + 1 < ser->values->len; i++) {
+		gdouble vi = g_array_index(ser->values,gdouble,i);
+		for(guint j = i + 1; j < ser->values->len; j++) {
+			gdouble vj = g_array_index(ser->values,gdouble,j);
+			s += (vj > vi) - (vj < vi);
+		}
+	}
+	
+	gdouble variance = n * (n - 1.0) * (2.0 * n + 5.0) / 18.0;
+	if(variance <= 0.0 || s == 0) return 0.0;
+	return (s > 0 ? s - 1 : s + 1) / sqrt(variance);
+}
+
+/**
+* Check whether the series grows: it must have a significant increasing
+* trend over all samples and also over the later half of them. A single
+* step up followed by a plateau (e.g. a pool filling up once) trends over
+* all samples but not over the later half.
+*
+* @param ser Series
+* @param slope Slope of all samples
+* @param z Mann-Kendall Z of all samples
+*
+* @return TRUE when series is growing
+*/
+static gboolean soak_grows(soak_series* ser, gdouble slope, gdouble z) {
+	if(z <= SOAK_Z_THRESHOLD || slope <= 0.0) return FALSE;
+	
+	guint half = ser->values->len / 2;
+	return soak_mann_kendall(ser,half) > SOAK_Z_THRESHOLD && soak_slope(ser,half) > 0.0;
+}
+
+/**
+* Print drift report of the soak: for each series the amount of samples,
+* first and last value, slope per hour and Mann-Kendall Z. Series that
+* keep growing (see soak_grows()) are flagged. Series with less than
+* SOAK_MIN_SAMPLES are not tested. Growth of the memory of testfw is
+* reported separately as it is not a result of the test.
+*
+* @return Amount of latency series flagged as growing
+*/
+guint soak_report() {
+	if(!series) return 0;
+	
+	guint growing = 0, memory = 0;
+	
+	g_print("Soak drift over %.1f minutes:\n",(g_get_monotonic_time() - soak_started) / 60.0 / G_USEC_PER_SEC);
+	g_print("samples\tfirst\tlast\tslope/h\tZ\tseries\n");
+	g_print("-------------------------------------------------------------------------------\n");
+	
+	for(GSequenceIter* iter = g_sequence_get_begin_iter(order); 
+		!g_sequence_iter_is_end(iter); 
+		iter = g_sequence_iter_next(iter)) {
+		soak_series* ser = (soak_series*)g_hash_table_lookup(series,g_sequence_get(iter));
+		guint n = ser->values->len;
+		
+		if(n < SOAK_MIN_SAMPLES) {
+			g_print(" %u\t-\t-\t-\t-\t%s (too few samples)\n",n,ser->name);
+			continue;
+		}
+		
+		gdouble slope = soak_slope(ser,0);
+		gdouble z = soak_mann_kendall(ser,0);
+		gboolean grows = soak_grows(ser,slope,z);
+		
+		g_print(" %u\t%.1f\t%.1f\t%.2f\t%.2f\t%s%s\n",n,
+			g_array_index(ser->values,gdouble,0),g_array_index(ser->values,gdouble,n - 1),
+			slope,z,ser->name,grows ? " GROWING" : "");
+		if(grows && ser->memory) memory++;
+		else if(grows) growing++;
+	}
+	g_print("%u latency series with monotonic growth\n",growing);
+	if(memory > 0) g_print("Memory of testfw grows in %u series, possible leak in testfw itself\n",memory);
+	g_print("\n");
+	
+	return growing;
+}
+
+/**
+* Clear all samples of the soak.
+*/
+void soak_clear() {
+	if(series) g_hash_table_destroy(series);
+	if(order) g_sequence_free(order);
+	series = NULL;
+	order = NULL;
+	memory_samples = 0;
+}
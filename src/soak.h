@@ -0,0 +1,18 @@
+#ifndef __SOAK_H_
+#define __SOAK_H_
+
+#include "definitions.h"
+
+#define SOAK_MIN_SAMPLES 10
+#define SOAK_WARMUP 1
+#define SOAK_Z_THRESHOLD 1.96
+
+gboolean soak_parse_duration(const gchar* spec, gint64* seconds);
+
+void soak_start();
+void soak_sample_latencies(GSList* results);
+void soak_sample_memory();
+guint soak_report();
+void soak_clear();
+
+#endif
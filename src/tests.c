@@ -1,21 +1,249 @@
+#include <stdarg.h>
 #include "tests.h"
 #include "connectionutils.h"
+#include "checkpoint.h"
+#include "results.h"
+#include "arena.h"
+#include "pacing.h"
+#include "shard.h"
+#include "history.h"
+#include "fixtures.h"
+#include "requestcache.h"
+#include "httpcache.h"
+#include "urltemplate.h"
+#include "capture.h"
 
 static GSList *test_sequence = NULL;
+static gchar *resume_from = NULL; // Id of the step to resume from
+static gboolean keep_resources = FALSE; // Leave resources of a failed run to server
+static gchar *failed_step = NULL; // Id of the first failed step
+static gboolean bounded_memory = FALSE; // Release replies of all tests after their step
+static gboolean release_replies = FALSE; // Release the reply of each step after the step
+static guint run_deadline = 0; // Deadline of all runs in seconds, overrides test deadline
+static const gchar *run_user = NULL; // User whose test is being run
+static guint slow_steps = 0; // Steps of the run that exceeded their latency budget
+static gint prepared_step = -1; // Index of the step prepared while the previous request was in flight
+static gchar *prepared_url = NULL; // Url of the prepared step, NULL if it needs the reply in flight
 
 /** 
 * Check if given method for file sending is sending data
-* i.e. is either POST or PUT.
+* i.e. is either POST, PUT or PATCH.
 *
 * @param method Method to check
 *
-* @return TRUE if it is matching POST or PUT, FALSE otherwise (also when method is NULL)
+* @return TRUE if it is matching POST, PUT or PATCH, FALSE otherwise (also when method is NULL)
 */
 gboolean tests_file_sending_method(gchar* method) {
-	if(!method) return FALSE;
-	if((g_strcmp0(method,"POST") == 0) || 
-		(g_strcmp0(method,"PUT") == 0)) return TRUE;
-	else return FALSE;
+	return http_method_has_body(method);
+}
+
+/**
+* Set the step (file id) from which the next run is resumed. The state of the
+* steps before it is restored from the checkpoint of the previous run and only
+* the step and its dependents are conducted. Resuming keeps the resources of a
+* failed run on the server also for the resumed run.
+*
+* @param id File id of the step to resume from, NULL to run all steps
+*/
+void tests_set_resume_point(const gchar* id) {
+	g_free(resume_from);
+	resume_from = g_strdup(id);
+	if(id) keep_resources = TRUE;
+}
+
+/**
+* Set whether the resources created by a failed run are left on the server
+* so that the run can be resumed from the failed step.
+*
+* @param keep TRUE to leave resources of a failed run to server
+*/
+void tests_set_keep_resources(gboolean keep) {
+	keep_resources = keep;
+}
+
+/**
+* Get the id of the first failed step of the last run.
+*
+* @return Id of the step (don't free this) or NULL if all steps succeeded
+*/
+const gchar* tests_get_failed_step() {
+	return failed_step;
+}
+
+/**
+* Set bounded memory mode for all tests. Reply of each step is released
+* after the step, otherwise this is set per test in preferences.
+*
+* @param bounded TRUE to release replies when no longer needed
+*/
+void tests_set_bounded_memory(gboolean bounded) {
+	bounded_memory = bounded;
+}
+
+/**
+* Set deadline for each test run, overrides the deadline set for the test
+* in preferences. Part of the deadline is reserved for cleanup.
+*
+* @param seconds Time allowed for a run, 0 to use deadline of the test
+*/
+void tests_set_deadline(guint seconds) {
+	run_deadline = seconds;
+}
+
+/**
+* Get the amount of steps in the last run that were functionally correct
+* but exceeded their latency budget.
+*
+* @return Amount of slow steps
+*/
+guint tests_get_slow_steps() {
+	return slow_steps;
+}
+
+/**
+* Check the latency of the reply of a step against the latency budgets of
+* the file. Latency must not exceed max_latency_ms and p95 of the latency
+* over the last runs (history) with this run must not exceed p95_latency_ms.
+* When a budget is exceeded the outcome of the reply is set as slow.
+*
+* @param test Test details
+* @param tfile Testfile that was sent
+* @param reply Reply of the server
+*
+* @return FALSE when a budget was exceeded
+*/
+static gboolean tests_check_latency_budget(testcase* test, testfile* tfile, jsonreply* reply) {
+	if(!reply || (tfile->max_latency_ms == 0 && tfile->p95_latency_ms == 0)) return TRUE;
+	
+	attempt* used = NULL;
+	for(GSList* iter = reply->attempts; iter && !used; iter = g_slist_next(iter))
+		if(((attempt*)iter->data)->used) used = (attempt*)iter->data;
+	
+	// Failed requests are not checked, verification fails for those
+	if(!used || used->outcome != OUTCOME_OK) return TRUE;
+	
+	gboolean rval = TRUE;
+	
+	if(tfile->max_latency_ms > 0 && used->latency_us > (gint64)tfile->max_latency_ms * 1000) {
+		g_print("Test id \"%s\" took %.1f ms, budget is %u ms\n",
+			tfile->id,used->latency_us / 1000.0,tfile->max_latency_ms);
+		rval = FALSE;
+	}
+	
+	if(tfile->p95_latency_ms > 0) {
+		gint64 p95 = history_get_percentile(run_user,test->name,tfile->id,tfile->method,tfile->path,used->latency_us,95);
+		if(p95 > (gint64)tfile->p95_latency_ms * 1000) {
+			g_print("Test id \"%s\" p95 latency over last runs is %.1f ms, budget is %u ms\n",
+				tfile->id,p95 / 1000.0,tfile->p95_latency_ms);
+			rval = FALSE;
+		}
+	}
+	
+	if(!rval) {
+		used->outcome = OUTCOME_SLOW;
+		reply->outcome = OUTCOME_SLOW;
+		slow_steps++;
+	}
+	return rval;
+}
+
+/**
+* Mark step with given id as failed if no step has failed before.
+*
+* @param id File id of the failed step
+*/
+static void tests_set_failed_step(const gchar* id) {
+	if(!failed_step) failed_step = g_strdup(id);
+}
+
+/**
+* Prepare the run before the connection is opened. Maps and validates the
+* files of the test in the thread pool of validation, they are not parsed
+* again when sent.
+*
+* @param test Test details
+* @param testpath Base path of the test
+*
+* @return Amount of errors found in the files
+*/
+static guint tests_prepare_run(testcase* test, gchar* testpath) {
+#ifdef G_MESSAGES_DEBUG
+	gint64 start = g_get_monotonic_time();
+#endif
+	
+	guint errors = tests_validate_test(test,testpath);
+	
+#ifdef G_MESSAGES_DEBUG
+	g_print("Files of test \"%s\" loaded in %.1f ms\n",test->name,
+		(g_get_monotonic_time() - start) / 1000.0);
+	fixture_print_stats();
+#endif
+	return errors;
+}
+
+/**
+* Load the data of a step from its mapped file. Fields requiring values
+* from other files or the server are listed and the data to send is made.
+*
+* @param tfile Testfile of the step
+* @param testpath Base path of the test
+*
+* @return FALSE when the file was not loaded
+*/
+static gboolean tests_load_step(testfile* tfile, gchar* testpath) {
+	
+	// Use any other file except Empty.json, files were mapped and validated before the run
+	if(g_strcmp0(tfile->file,"Empty.json") == 0) return TRUE;
+	if(!tfile->fixture) return FALSE;
+	
+	// Do this only for files that are sent
+	if(tests_file_sending_method(tfile->method))
+		tests_check_fields_from_fixture(tfile,testpath);
+	
+	// Files without members to replace are sent as they are
+	tfile->send = fixture_make_send(tfile->fixture);
+	return TRUE;
+}
+
+/**
+* Prepare the next step while the request of the current step is in flight.
+* The file of the step is loaded and its url is rendered when the url does
+* not need values from the reply in flight. Host of the url is resolved and
+* connected to when prewarming is enabled. Values from the reply in flight
+* and from {parent} and {getinfo} fields are set after the reply arrives.
+* Called by http_post() only.
+*
+* @param data prefetch_t describing the step
+*/
+static void tests_prefetch_step(gpointer data) {
+	prefetch* job = (prefetch*)data;
+	gchar* searchparam = g_slist_nth_data(test_sequence,job->step);
+	testfile* tfile = searchparam ? (testfile*)g_hash_table_find(job->test->files,
+		(GHRFunc)find_from_hash_table,searchparam) : NULL;
+	
+	if(!tfile || !tests_load_step(tfile,job->testpath)) return;
+	prepared_step = job->step;
+	
+	g_free(prepared_url);
+	prepared_url = NULL;
+	
+	for(guint index = 0; tfile->template && index < tfile->template->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tfile->template->parts,urltemplate_part,index);
+		if(part->literal) continue;
+		if(g_strcmp0(part->file,job->in_flight) == 0 || !capture_get(part->name)) return;
+	}
+	
+	prepared_url = urltemplate_render(tfile->template,NULL,job->test->URL,NULL);
+	if(prepared_url && job->test->prewarm) http_preconnect(prepared_url);
+}
+
+/**
+* Clear the step prepared with tests_prefetch_step().
+*/
+static void tests_clear_prepared_step() {
+	prepared_step = -1;
+	g_free(prepared_url);
+	prepared_url = NULL;
 }
 
 /**
@@ -24,6 +252,12 @@ gboolean tests_file_sending_method(gchar* method) {
 void tests_initialize(testcase* test) {
 	// Initialize http with encoding
 	http_init(test->encoding);
+	
+	// Retry policies are per test
+	http_set_retry_policies(test->retries);
+	
+	// Pacing is per URL of the test
+	pacing_configure(test->URL,test->rate,test->burst,test->max_in_flight);
 }
 
 /**
@@ -33,8 +267,20 @@ void tests_reset(testcase* test) {
 	g_slist_free_full(test_sequence,(GDestroyNotify)free_key);
 	test_sequence = NULL;
 	
+	release_replies = FALSE;
+	
 	g_hash_table_foreach(test->files,(GHFunc)testcase_reset_file,NULL);
 	
+	tests_clear_prepared_step();
+	history_release_run();
+	results_clear();
+	requestcache_clear();
+	httpcache_clear();
+	capture_clear();
+	
+	// Release all transient data of the run at once
+	arena_release_run();
+	
 	// Cleanup http
 	http_close();
 }
@@ -52,27 +298,232 @@ gboolean tests_run_test(gchar* username, testcase* test) {
 
 	// Establish path to test
 	gchar* testpath = tests_make_path_for_test(username,test);
-
-	// Check which fields from the case creation reply have to be stored for future use
-	// This is done after loading the testfile in test_conduct_tests() to save resources
-	//g_hash_table_foreach(test->files, (GHFunc)tests_check_fields_from_testfiles, testpath);
 	
+	g_free(failed_step);
+	failed_step = NULL;
+	run_user = username;
+	slow_steps = 0;
+	
+	results_start(test->name);
+	arena_start_run();
+	
+	// Budgets and regressions are checked against the history before this run
+	history_load_run(username);
+
 	// Create the sequence of sending tests (json files as charstring data)
 	tests_build_test_sequence(test);
 	
 	// Set list of integer member fields for jsonutils to use
 	set_integer_fields(test->intfields);
+	
+	// Values needed later are captured, replies can be released after their step
+	release_replies = bounded_memory || test->bounded_memory;
+	
+	// Files are loaded and validated before the server is contacted at all
+	guint errors = tests_prepare_run(test,testpath);
+	
+	// Nothing is created on server with broken files, not even a connection
+	if(errors > 0) {
+		g_print("Test \"%s\" has %u errors in its files, not run\n",test->name,errors);
+		g_free(testpath);
+		return FALSE;
+	}
+	
+	// Values captured from the replies
+	tests_plan_captures(test);
+	
+	// Connection is opened before the first step, the first request pays only for its own time
+	if(test->prewarm) http_prewarm(test->URL);
+	
+	// Replies of cacheable GETs are kept between runs in the test folder
+	if(test->cacheable) {
+		gchar* cachedir = g_strjoin("/",testpath,HTTPCACHEDIR,NULL);
+		httpcache_configure(cachedir,test->URL,test->cacheable);
+		g_free(cachedir);
+	}
+	
+	// Resuming requires that the resources of the previous run are still on server
+	if(resume_from) {
+		if(!checkpoint_cleanup_pending(testpath) ||
+			!g_slist_find_custom(test_sequence,resume_from,(GCompareFunc)g_strcmp0)) {
+			g_print("Cannot resume test \"%s\" from step \"%s\", no checkpoint found. Running all steps.\n",
+				test->name,resume_from);
+			g_free(resume_from);
+			resume_from = NULL;
+		}
+	}
+	
+	// Deadline of the whole run
+	guint deadline_s = run_deadline > 0 ? run_deadline : test->deadline_s;
+	gint64 started = g_get_monotonic_time();
+	if(deadline_s > 0) http_set_deadline(started + (gint64)deadline_s * G_USEC_PER_SEC);
+	
+	// Remove the resources left by previous run before starting from beginning
+	if(!resume_from) {
+		if(checkpoint_cleanup_pending(testpath)) tests_cleanup_checkpoint(test,testpath);
+		checkpoint_clear(testpath);
+	}
+	
+	// Steps must end before the time reserved for cleanup
+	if(deadline_s > 0) {
+		guint reserve = MIN(test->reserve_s,deadline_s / 2);
+		http_set_deadline(started + (gint64)(deadline_s - reserve) * G_USEC_PER_SEC);
+	}
 
 	// Do tests
 	rval = tests_conduct_tests(test,testpath);
+	
+	// Cleanup can use the reserved time
+	if(deadline_s > 0) {
+		if(http_deadline_passed()) 
+			g_print("Deadline of %u seconds reached in test \"%s\", cleaning up\n",deadline_s,test->name);
+		http_set_deadline(started + (gint64)deadline_s * G_USEC_PER_SEC);
+	}
 
-	tests_unload_tests(test,testpath);
+	// Leave resources to server for resuming
+	if(!rval && keep_resources && failed_step) {
+		checkpoint_save_state(testpath,failed_step,TRUE);
+		g_print("Resources of test \"%s\" were left on server, resume from step \"%s\" with --resume-from %s\n",
+			test->name,failed_step,failed_step);
+	}
+	else {
+		tests_unload_tests(test,testpath);
+		checkpoint_clear(testpath);
+	}
+	
+	g_free(resume_from);
+	resume_from = NULL;
+	
+	http_set_deadline(0);
+	
+	// Report and duration history for sharding
+	gint64 duration = g_get_monotonic_time() - started;
+	results_finish(rval,duration);
+	shard_save_duration(username,test->name,duration / 1000);
+	
+	results_print_summary();
+	pacing_print_stats();
+	requestcache_print_stats();
+	httpcache_print_stats();
+	http_print_stats();
+	
+	// Compare latencies to previous runs before adding this run to them
+	history_report_regressions(username,results_get());
+	history_append(username,results_get());
+	arena_print_stats();
 		
 	g_free(testpath);
 	
 	return rval;
 }
 
+/**
+* Remove the resources left on server by a previous failed run of the test.
+* Restores the replies of all steps from the checkpoint and unloads them
+* as if the run was just conducted. Http has to be initialized.
+*
+* @param test Test details
+* @param testpath Base path of tests
+*/
+void tests_cleanup_checkpoint(testcase* test, gchar* testpath) {
+	
+	g_print("Removing resources left on server by previous run of test \"%s\"\n",test->name);
+	
+	// Values needed by cleanup are captured from the restored replies
+	tests_plan_captures(test);
+	
+	for(gint testidx = 0; testidx < g_slist_length(test_sequence); testidx++) {
+		testfile* tfile = (testfile*)g_hash_table_find(test->files,
+			(GHRFunc)find_from_hash_table, 
+			g_slist_nth_data(test_sequence,testidx));
+		
+		if(!checkpoint_restore_step(testpath,tfile)) continue;
+		capture_take(tfile);
+		
+		// Login is always first, authenticate with the stored token
+		if(testidx == 0) set_token((gchar*)capture_get_from_file(tfile->id,"data.token"));
+	}
+	
+	tests_unload_tests(test,testpath);
+	
+	g_hash_table_foreach(test->files,(GHFunc)testcase_reset_file,NULL);
+	capture_clear();
+	checkpoint_clear(testpath);
+}
+
+/**
+* Remove the resources left on server by a failed run of the test if the
+* run was not resumed. Initializes and resets the test for the cleanup.
+*
+* @param username User whose test is cleaned up
+* @param test Test details
+*/
+void tests_cleanup_pending(gchar* username, testcase* test) {
+	gchar* testpath = tests_make_path_for_test(username,test);
+	
+	if(checkpoint_cleanup_pending(testpath)) {
+		tests_initialize(test);
+		tests_build_test_sequence(test);
+		set_integer_fields(test->intfields);
+		
+		tests_cleanup_checkpoint(test,testpath);
+		
+		tests_reset(test);
+	}
+	g_free(testpath);
+}
+
+/**
+* Send the request of a step. The next step is prepared while the request
+* is in flight. Latency budget of the step is checked, the result is added
+* to results and the values needed later are captured once from the reply.
+*
+* @param test Test details
+* @param tfile Testfile of the step
+* @param url Url to send to
+* @param next Next step to prepare, NULL for the last step
+*/
+static void tests_send_step(testcase* test, testfile* tfile, gchar* url, prefetch* next) {
+	http_set_latency_key(tfile->path);
+	
+	// Not done when no request was sent, e.g. a fresh reply from cache
+	http_set_in_flight_work(next ? tests_prefetch_step : NULL,next);
+	tfile->recv = http_post(url,tfile->send,tfile->method);
+	http_set_in_flight_work(NULL,NULL);
+	tests_check_latency_budget(test,tfile,tfile->recv);
+	results_add(tfile->id,tfile->method,tfile->path,tfile->recv);
+	capture_take(tfile);
+}
+
+/**
+* Check whether the step depends on any of the steps conducted when resuming.
+* Login is required by all steps and steps that are not sending data read
+* the state created by all earlier steps. Otherwise the step depends on the
+* files its {parent} members are searched from and on the files the variables
+* of its path refer to.
+*
+* @param tfile Testfile of the step
+* @param conducted Hash table of conducted file ids
+*
+* @return TRUE when the step needs to be conducted again
+*/
+static gboolean tests_step_depends_on(testfile* tfile, GHashTable* conducted) {
+	if(g_hash_table_contains(conducted,"login")) return TRUE;
+	
+	if(!tests_file_sending_method(tfile->method)) return g_hash_table_size(conducted) > 0;
+	
+	for(guint index = 0; tfile->template && index < tfile->template->parts->len; index++) {
+		const gchar* file = g_array_index(tfile->template->parts,urltemplate_part,index).file;
+		if(file && g_hash_table_contains(conducted,file)) return TRUE;
+	}
+	
+	for(GSList* iter = tfile->fixture ? tfile->fixture->parents : NULL; iter; iter = g_slist_next(iter)) {
+		const gchar* search_file = ((reference*)iter->data)->search_file;
+		if(search_file && g_hash_table_contains(conducted,search_file)) return TRUE;
+	}
+	return FALSE;
+}
+
 /**
 * Do all tests according to the testing sequence
 * @param test Test details
@@ -84,6 +535,14 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 	if(!test || !testpath) return FALSE;
 
 	gboolean rval = TRUE;
+	
+	// When resuming, ids of the steps that are conducted again
+	GHashTable* conducted = NULL;
+	gboolean upstream = FALSE;
+	if(resume_from) {
+		conducted = g_hash_table_new(g_str_hash,g_str_equal);
+		upstream = TRUE;
+	}
 
 	// Go through the test sequence
 	for(gint testidx = 0; testidx < g_slist_length(test_sequence); testidx++) {
@@ -91,6 +550,14 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 		// Get the item in test sequence
 		gchar* searchparam = g_slist_nth_data(test_sequence,testidx);
 		
+		// Out of time, remaining steps are not conducted
+		if(http_deadline_passed()) {
+			g_print("Run deadline reached, test id \"%s\" and the following were not conducted\n",searchparam);
+			tests_set_failed_step(searchparam);
+			rval = FALSE;
+			break;
+		}
+		
 #ifdef G_MESSAGES_DEBUG
 		g_print("Press enter to continue with test \"%s\" file id=\"%s\"",test->name,searchparam);
 		gchar c = '0';
@@ -101,65 +568,62 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 			(GHRFunc)find_from_hash_table, 
 			searchparam);
 		
-		// Read any other file except Empty.json	
-		if(g_strcmp0(tfile->file,"Empty.json") != 0) {
-			// Create path for the file to be read
-			gchar* filepath = g_strjoin("/",testpath,tfile->file,NULL);
-		
-			JsonParser *parser = json_parser_new();
-		
-			// Read json detailed by this data (stucture)
-			if(!load_json_from_file(parser, filepath)) return FALSE;
-			
-			// Do this only for files that are sent
-			if(tests_file_sending_method(tfile->method))
-				tests_check_fields_from_loaded_testfile(parser, tfile, testpath);
-		
-			// Establish a generator to get the character representation
-			JsonGenerator *generator = json_generator_new();
-			json_generator_set_root(generator, json_parser_get_root(parser));
-	
-			// Create new jsonreply and set it to contain json as string data
-			tfile->send = jsonreply_initialize();
-			tfile->send->data = json_generator_to_data(generator,&(tfile->send->length));
-		
-			g_object_unref(generator);
-			g_object_unref(parser);
+		// Step may have been loaded while the previous request was in flight
+		gboolean prepared = prepared_step == testidx;
+		prepared_step = -1;
+		if(!prepared && !tests_load_step(tfile,testpath)) {
+			tests_set_failed_step(tfile->id);
+			if(conducted) g_hash_table_destroy(conducted);
+			return FALSE;
 		}
 		
-		// If path contains {id} it needs to be replaced with case id
-		if(g_strrstr(tfile->path,"{id}")) {
-		
-			// Get case file
-			testfile* temp = (testfile*)g_hash_table_find(test->files,
-				(GHRFunc)find_from_hash_table, 
-				"0");
-			
-			// Get case id
-			gchar* caseid = get_value_of_member(temp->recv,"guid",NULL);
+		// Resuming, restore steps that are upstream or not dependent on conducted steps
+		if(conducted) {
+			if(g_strcmp0(tfile->id,resume_from) == 0) upstream = FALSE;
 			
-			if(caseid) {
+			if((upstream || !tests_step_depends_on(tfile,conducted)) && 
+				checkpoint_restore_step(testpath,tfile)) {
+				g_print("Restored test id \"%s\" (file: %s) from checkpoint\n",tfile->id,tfile->file);
+				capture_take(tfile);
 				
-				// Tokenize path
-				gchar** split_path = g_strsplit(tfile->path,"/",5);
-				
-				// Go through the tokens and replace {id} with case id
-				for(gint splitidx = 0; split_path[splitidx] ; splitidx++) {
-					if(g_strcmp0(split_path[splitidx],"{id}") == 0) {
-						g_free(split_path[splitidx]);
-						split_path[splitidx] = caseid;
-					}
-				}
-				
-				// Replace the path with new
-				g_free(tfile->path);
-				tfile->path = g_strjoinv("/",split_path);
-				g_strfreev(split_path);
+				// Login is always first, authenticate with the stored token
+				if(testidx == 0) set_token((gchar*)capture_get_from_file(tfile->id,"data.token"));
+				if(release_replies) tests_release_replies(tfile);
+				arena_reset(arena_step());
+				continue;
 			}
+			
+			// Remove the resource created by the previous attempt of this step
+			if(tfile->need_delete && checkpoint_restore_step(testpath,tfile)) {
+				capture_take(tfile);
+				tests_unload_file(test,tfile,testidx == 0);
+				free_jsonreply(tfile->recv);
+				tfile->recv = NULL;
+			}
+			g_hash_table_remove_all(tfile->replace);
+			g_hash_table_add(conducted,tfile->id);
 		}
 		
-		// Create url
-		gchar* url = g_strjoin("/",test->URL,tfile->path,NULL);
+		// Create url from the template of the path, variables are replaced
+		// with the values captured from earlier replies
+		gchar* url = prepared && prepared_url ? arena_strdup(arena_step(),prepared_url) :
+			urltemplate_render(tfile->template,arena_step(),test->URL,NULL);
+		g_free(prepared_url);
+		prepared_url = NULL;
+		if(!url) {
+			g_print("Url of test id \"%s\" cannot be made from path \"%s\"\n",tfile->id,tfile->path);
+			rval = FALSE;
+			tests_set_failed_step(tfile->id);
+			arena_reset(arena_step());
+			continue;
+		}
+		
+		// Timeouts of this step, used also when getting more info
+		http_set_timeouts(&(tfile->timeouts));
+		
+		// Next step is prepared while the request of this step is in flight
+		prefetch next = { test, testpath, testidx + 1, tfile->id };
+		prefetch* upcoming = testidx + 1 < (gint)g_slist_length(test_sequence) ? &next : NULL;
 		
 #ifdef G_MESSAGES_DEBUG
 		g_print("Conducting test id \"%s\"\n",test->name);
@@ -167,22 +631,29 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 				
 		// First is login, it is always first in the list
 		if(testidx == 0) {
-			tfile->recv = http_post(url,tfile->send,tfile->method);
+			tests_send_step(test,tfile,url,upcoming);
 			if(tfile->recv) {
-				gchar* token = get_value_of_member(tfile->recv,"token",NULL);
-				set_token(token);
-				g_free(token);
+				set_token((gchar*)capture_get_from_file(tfile->id,"data.token"));
+				checkpoint_save_step(testpath,tfile,TRUE);
+			}
+			else {
+				rval = FALSE;
+				tests_set_failed_step(tfile->id);
 			}
-			else rval = FALSE;
 		}
 		
 		// Case creation is second
 		else if(testidx == 1) {
-			tfile->recv = http_post(url,tfile->send,tfile->method);
+			tests_send_step(test,tfile,url,upcoming);
 			if(tfile->recv && verify_server_response(tfile->send,tfile->recv)) {
 				g_print ("Case added correctly\n\n\n");
+				checkpoint_save_step(testpath,tfile,TRUE);
+			}
+			else {
+				rval = FALSE;
+				tests_set_failed_step(tfile->id);
+				checkpoint_save_step(testpath,tfile,FALSE);
 			}
-			else rval = FALSE;
 		}
 		
 		// From third start the tests, here the required fields are checked and replaced
@@ -193,10 +664,10 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 			// Do this only for files that are sent
 			if(tests_file_sending_method(tfile->method)) {
 				for(index = 0; index < g_slist_length(tfile->required); index++) {
-					//replace_required_member(test->files,tfile,index);
+					//replace_required_member(tfile,index);
 				
 					// Use new function just to add member-new value pairs to hash table
-					add_required_member_value_to_list(test->files,tfile,index);
+					add_required_member_value_to_list(tfile,index);
 				}
 			
 				// Go through the list of items requiring more info
@@ -212,38 +683,101 @@ gboolean tests_conduct_tests(testcase* test, gchar* testpath) {
 				set_values_of_all_members(tfile->send, tfile->replace);		
 			}
 
-			tfile->recv = http_post(url,tfile->send,tfile->method);
+			tests_send_step(test,tfile,url,upcoming);
 			
 			// If there is something to verify
 			if(tfile->send) {
 				g_print("Verifying test id \"%s\" (file: %s):\n",tfile->id,tfile->file);
 				if(verify_server_response(tfile->send,tfile->recv)) {
 					g_print ("Test id \"%s\" was added correctly\n",tfile->id);
+					checkpoint_save_step(testpath,tfile,TRUE);
 				}
 				else {
 					g_print("Test id \"%s\" was not added correctly\n", tfile->id);
 					rval = FALSE;
+					tests_set_failed_step(tfile->id);
+					checkpoint_save_step(testpath,tfile,FALSE);
 				}
 				g_print("\n\n");
 			}
+			else checkpoint_save_step(testpath,tfile,TRUE);
 		}
 
-		g_free(url);	
+		// Release transient data of the step
+		arena_reset(arena_step());
+		
+		// Release the reply, values needed later were captured
+		if(release_replies) tests_release_replies(tfile);
 	}
+	
+	if(conducted) g_hash_table_destroy(conducted);
 	return rval;
 }
 
-/** 
-* Unload (or DELETE) tests from server, done in reverse order starting from last test
+/**
+* Unload (or DELETE) a single test from server using the reply of the
+* server to get the identification of the resource. Login is signed out.
+*
 * @param test Test details
-* @testpath base path to tests
+* @param tfile Testfile to unload
+* @param login TRUE when the testfile is the login
 */
-void tests_unload_tests(testcase* test,gchar* testpath) {
+void tests_unload_file(testcase* test, testfile* tfile, gboolean login) {
 	
 	jsonreply *deldata = NULL;
 	jsonreply *delresp = NULL;
 	gchar *url = NULL;
-	gchar *value = NULL;
+	const gchar *value = NULL;
+	
+	// If we got a reply its values were captured
+	if(!tfile || (!tfile->recv && !tfile->released)) return;
+	
+	http_set_timeouts(&(tfile->timeouts));
+		
+	// Login is signed out
+	if(login) {
+		value = capture_get_from_file(tfile->id,"data.user_guid");
+
+		deldata = create_delete_reply("user_guid",value);
+	
+		if(deldata && value) {
+			url = g_strjoin("/",test->URL,"SignOut",value,NULL);
+			http_set_latency_key("SignOut");
+			delresp = http_post(url,deldata,"GET");
+			results_add(tfile->id,"GET","SignOut",delresp);
+		}
+	}
+
+	// Others are deleted when required
+	else if(tfile->need_delete){
+		
+		value = capture_get_from_file(tfile->id,"data.guid");
+
+		// Url is the path of the file rendered with the values of this run,
+		// never the raw path as it may contain variables like {id}
+		if(value) {
+			deldata = create_delete_reply("guid",value);
+			url = urltemplate_render(tfile->template,NULL,test->URL,value);
+			if(!url) g_print("Cannot DELETE test id \"%s\", url cannot be made from path \"%s\"\n",
+				tfile->id,tfile->path);
+		}
+		if(url) {
+			http_set_latency_key(tfile->path);
+			delresp = http_post(url,deldata,"DELETE");
+			results_add(tfile->id,"DELETE",tfile->path,delresp);
+		}
+	}
+	g_free(url);
+	free_jsonreply(delresp);
+	free_jsonreply(deldata);
+}
+
+/** 
+* Unload (or DELETE) tests from server, done in reverse order starting from last test
+* @param test Test details
+* @testpath base path to tests
+*/
+void tests_unload_tests(testcase* test,gchar* testpath) {
 	
 	// Go through the sequence in reverse
 	for(gint testidx = g_slist_length(test_sequence) -1 ; testidx >= 0; testidx--) {
@@ -262,37 +796,8 @@ void tests_unload_tests(testcase* test,gchar* testpath) {
 			(GHRFunc)find_from_hash_table, 
 			searchparam);
 		
-		// If we got a reply we can get all details
-		if(tfile->recv) {
-		
-			// First (here last) is login, it is always first in the list
-			if(testidx == 0) {
-				value = get_value_of_member(tfile->recv,"user_guid",NULL);
-
-				deldata = create_delete_reply("user_guid",value);
-			
-				if(deldata && value) {
-					url = g_strjoin("/",test->URL,"SignOut",value,NULL);
-					delresp = http_post(url,deldata,"GET");
-				}
-			}
-		
-			// Rest in reverse order
-			else if(tfile->need_delete){
-				
-				value = get_value_of_member(tfile->recv,"guid",NULL);
-
-				if(value) {
-					deldata = create_delete_reply("guid",value);			
-					url = g_strjoin("/",test->URL,tfile->path,value,NULL);
-					delresp = http_post(url,deldata,"DELETE");
-				}
-			}
-		}
-		g_free(value);
-		g_free(url);
-		free_jsonreply(delresp);
-		free_jsonreply(deldata);
+		// First (here last) is login, it is always first in the list
+		tests_unload_file(test,tfile,testidx == 0);
 	}
 	
 }
@@ -312,6 +817,14 @@ void tests_build_test_sequence(testcase* test) {
 		testfile* tfile = (testfile*)g_hash_table_find(test->files,
 			(GHRFunc)find_from_hash_table, 
 			searchparam);
+		
+		// Reported by validation
+		if(!tfile) {
+			g_free(searchparam);
+			continue;
+		}
+					
+		tfile->order = testidx;
 					
 		// First is login, it is always first in the list
 		if(testidx == 0) test_sequence = g_slist_prepend(test_sequence,g_strdup(tfile->id));
@@ -322,196 +835,300 @@ void tests_build_test_sequence(testcase* test) {
 }
 
 /**
-* Checks the fields from the files defined for this test that which contain {parent} and {getinfo}
-* values. These member names containing such values are added to the lists of the test files to be
-* replaced later when the particular test is conducted. 
-*
-* This is called only by the hash table foreach function and is not meant to be used otherwise.
+* Adds the member names of the mapped test file containing {parent} and {getinfo}
+* values to the lists of the test file to be replaced later. The references of
+* these members were loaded and compiled with the file.
 * 
-* @param key - Key in hash table
-* @param value - Value corresponding to the key in hashtable
-* @param testpath - Base path to tests
+* @param tfile - testfile containing details and the mapped file
+* @param testpath - Base path to tests
 */
-void tests_check_fields_from_testfiles(gpointer key, gpointer value, gpointer testpath) {
-
-	JsonParser *parser = json_parser_new();
+void tests_check_fields_from_fixture(testfile *tfile, gchar* testpath) {
+	if(!tfile->fixture) return;
 	
-	// Cast the input value to testfile and create path based on filename
-	testfile* tfile = (testfile*)value;
-	gchar* filepath = g_strjoin("/",testpath,tfile->file,NULL);
+	// Requires information from other file
+	for(GSList* iter = tfile->fixture->parents; iter; iter = g_slist_next(iter))
+		tfile->required = g_slist_append(tfile->required,((reference*)iter->data)->member);
 	
-	// Load json with this filename
-	if(!load_json_from_file(parser, filepath)) return;
-		
-	JsonReader *reader = json_reader_new (json_parser_get_root (parser));
+	// Requires more information from the server
+	for(GSList* iter = tfile->fixture->getinfos; iter; iter = g_slist_next(iter))
+		tfile->moreinfo = g_slist_append(tfile->moreinfo,((reference*)iter->data)->member);
+}
 
-	gchar** members = json_reader_list_members(reader);
+/**
+* Map and validate a single file in the thread pool of validation.
+*
+* @param data testfile to load
+* @param testpath Base path to tests
+*/
+static void tests_load_fixture_job(gpointer data, gpointer testpath) {
+	tests_load_fixture(NULL,data,testpath);
+}
+
+/**
+* Add an error found in validation to list of errors.
+*
+* @param errors List to add to
+* @param tfile Testfile the error is in
+* @param format Format of the error message
+*/
+static void tests_add_error(GSList** errors, testfile* tfile, const gchar* format, ...) {
+	va_list args;
+	va_start(args,format);
+	gchar* message = g_strdup_vprintf(format,args);
+	va_end(args);
 	
-	// Go through all members of this json
-	for(gint membidx = 0; members[membidx] != NULL; membidx++) {
+	*errors = g_slist_append(*errors,g_strdup_printf("id \"%s\" (%s): %s",tfile->id,tfile->file,message));
+	g_free(message);
+}
 
-		// Get the value of current member
-		gchar* membstring = get_json_member_string(reader,members[membidx]);
-		
-		// Requires information from other file
-		if(g_strcmp0(membstring,"{parent}") == 0) {
+/**
+* Check the captures declared for a testfile. Names are shared by all files
+* of the test, a name can be declared only once. Names of path variables
+* ({name.member} and {id}) and internal values (id:path) are reserved.
+*
+* @param test Test details
+* @param tfile Testfile to check
+* @param errors List to add the errors to
+*/
+static void tests_check_captures(testcase* test, testfile* tfile, GSList** errors) {
+	for(GSList* iter = tfile->captures; iter; iter = g_slist_next(iter)) {
+		capture* cap = (capture*)iter->data;
+		if(!cap->declared) continue;
 		
-			// Add member name to list
-			tfile->required = g_slist_append(tfile->required,g_strdup(members[membidx]));
-			
-			JsonParser *par_parser = json_parser_new();
-			
-			// Create file offering more information
-			gchar* par_infopath = g_strjoin(".",filepath,"info",members[membidx],"json",NULL);
-			
-			if(load_json_from_file(par_parser,par_infopath)) {
-				JsonGenerator *par_generator = json_generator_new();
-				json_generator_set_root(par_generator, json_parser_get_root(par_parser));
-				
-				// Initialize struct for the new json and store json
-				jsonreply* info = jsonreply_initialize();
-				info->data = json_generator_to_data(par_generator,&(info->length));
-				
-				// To verify that this item is in correct position in the list 
-				// and corresponds to the member string location
-				gint add_position = g_slist_length(tfile->required) - 1;
-				tfile->reqinfo = g_slist_insert(tfile->reqinfo,info,add_position);
-
-				g_object_unref(par_generator);
-			}
-			g_free(par_infopath);
-			g_object_unref(par_parser);
+		if(g_strcmp0(cap->name,"id") == 0 || g_strstr_len(cap->name,-1,".") || g_strstr_len(cap->name,-1,":")) {
+			tests_add_error(errors,tfile,"capture name \"%s\" is reserved, names cannot be id or contain '.' or ':'",
+				cap->name);
+			continue;
 		}
 		
-		// Requires more information from the server
-		if(g_strcmp0(membstring,"{getinfo}") == 0) {
+		// Reported for the later one of the files
+		GHashTableIter files;
+		gpointer key = NULL, value = NULL;
+		g_hash_table_iter_init(&files,test->files);
 		
-			// Add member name to list
-			tfile->moreinfo = g_slist_append(tfile->moreinfo,g_strdup(members[membidx]));
+		while(g_hash_table_iter_next(&files,&key,&value)) {
+			testfile* other = (testfile*)value;
+			if(other == tfile || other->order > tfile->order) continue;
 			
-			JsonParser *info_parser = json_parser_new();
-			
-			// Create path to the file offering more information
-			gchar* infopath = g_strjoin(".",filepath,"getinfo",members[membidx],"json",NULL);
-			
-			// Load the json file
-			if(load_json_from_file(info_parser,infopath)) {
-				JsonGenerator *info_generator = json_generator_new();
-				json_generator_set_root(info_generator, json_parser_get_root(info_parser));
-				
-				// Initialize struct for the new json and store json
-				jsonreply* info = jsonreply_initialize();
-				info->data = json_generator_to_data(info_generator,&(info->length));
-				
-				// To verify that this item is in correct position in the list 
-				// and corresponds to the member string location
-				gint add_position = g_slist_length(tfile->moreinfo) - 1;
-				tfile->infosend = g_slist_insert(tfile->infosend,info,add_position);
-
-				g_object_unref(info_generator);
+			for(GSList* ocap = other->captures; ocap; ocap = g_slist_next(ocap)) {
+				if(g_strcmp0(((capture*)ocap->data)->name,cap->name) == 0)
+					tests_add_error(errors,tfile,"capture \"%s\" is declared also by id \"%s\"",cap->name,other->id);
 			}
-			g_free(infopath);
-			g_object_unref(info_parser);
 		}
-		g_free(membstring);
 	}
-	
-	//g_print("\n");	
-	g_strfreev(members);
-	g_object_unref(reader);
-	g_object_unref(parser);
-	parser = NULL;
-	g_free(filepath);
 }
 
 /**
-* Checks the fields from the file loaded in parser for presence of {parent} and
-* {getinfo} values. These member names containing such values are added to the
-* lists of the test files to be replaced later. 
-* 
-* @param parser - Parser where file is loaded
-* @param tfile - testfile containing details
-* @param testpath - Base path to tests
+* Check the references of a loaded testfile. {parent} members must have
+* an info file with a path to the value and a search_file that exists and
+* is conducted before the file. {getinfo} members must have path, method
+* and a path to the value. Variables of the path must refer to files that
+* are conducted before the file. Declared captures must have unique names.
+*
+* @param test Test details
+* @param tfile Testfile to check
+* @param errors List to add the errors to
 */
-void tests_check_fields_from_loaded_testfile(JsonParser *parser,testfile *tfile, gchar* testpath) {
+static void tests_check_references(testcase* test, testfile* tfile, GSList** errors) {
+	
+	tests_check_captures(test,tfile,errors);
+	
+	if(!tfile->template)
+		tests_add_error(errors,tfile,"path \"%s\" is not a valid template",tfile->path);
+	
+	for(guint index = 0; tfile->template && index < tfile->template->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tfile->template->parts,urltemplate_part,index);
+		testfile* source = part->file ? (testfile*)g_hash_table_lookup(test->files,part->file) : NULL;
 		
-	gchar* filepath = g_strjoin("/",testpath,tfile->file,NULL);
-	JsonReader *reader = json_reader_new (json_parser_get_root (parser));
-
-	gchar** members = json_reader_list_members(reader);
+		if(part->literal) continue;
+		if(!source)
+			tests_add_error(errors,tfile,"variable {%s} of path \"%s\" refers to unknown file",part->name,tfile->path);
+		else if(source->order >= tfile->order)
+			tests_add_error(errors,tfile,"variable {%s} of path \"%s\" refers to id \"%s\" that is not conducted before",
+				part->name,tfile->path,source->id);
+	}
+	
+	if(!tfile->fixture) return;
 	
-	// Go through all members of this json
-	for(gint membidx = 0; members[membidx] != NULL; membidx++) {
+	for(GSList* iter = tfile->fixture->parents; iter; iter = g_slist_next(iter)) {
+		reference* ref = (reference*)iter->data;
+		testfile* search = ref->search_file ? (testfile*)g_hash_table_lookup(test->files,ref->search_file) : NULL;
+		
+		if(!ref->search_file || !ref->select)
+			tests_add_error(errors,tfile,"{parent} member \"%s\" has no valid %s.info.%s.json",
+				ref->member,tfile->file,ref->member);
+		else if(!search)
+			tests_add_error(errors,tfile,"{parent} member \"%s\" refers to unknown search_file \"%s\"",
+				ref->member,ref->search_file);
+		else if(search->order >= tfile->order)
+			tests_add_error(errors,tfile,"{parent} member \"%s\" refers to search_file \"%s\" that is not conducted before",
+				ref->member,ref->search_file);
+	}
+	
+	for(GSList* iter = tfile->fixture->getinfos; iter; iter = g_slist_next(iter)) {
+		reference* ref = (reference*)iter->data;
+		
+		if(!ref->path || !ref->method || !ref->select)
+			tests_add_error(errors,tfile,"{getinfo} member \"%s\" has no valid %s.getinfo.%s.json with path and method",
+				ref->member,tfile->file,ref->member);
+	}
+}
 
-		// Get the value of current member
-		gchar* membstring = get_json_member_string(reader,members[membidx]);
+/**
+* Validate all files of the test before any request is sent. The files, their
+* info files and the paths in them are loaded in parallel in a thread pool and
+* the references between the files are checked after that. All errors found
+* are printed at once. Test sequence must be built before.
+*
+* @param test Test details
+* @param testpath Base path to tests
+*
+* @return Amount of errors found
+*/
+guint tests_validate_test(testcase* test, gchar* testpath) {
+	GSList* errors = NULL;
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	
+	GThreadPool* pool = g_thread_pool_new(tests_load_fixture_job,testpath,
+		(gint)g_get_num_processors(),FALSE,NULL);
+	
+	g_hash_table_iter_init(&iter,test->files);
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		if(pool) g_thread_pool_push(pool,value,NULL);
+		else tests_load_fixture(key,value,testpath);
+	}
+	
+	// Wait for all files
+	if(pool) g_thread_pool_free(pool,FALSE,TRUE);
+	
+	if(g_slist_length(test_sequence) != g_hash_table_size(test->files))
+		errors = g_slist_append(errors,g_strdup("file ids must be \"login\" and numbers from \"0\" without gaps"));
+	
+	// Checked in the order of the run
+	for(GSList* id = test_sequence; id; id = g_slist_next(id)) {
+		testfile* tfile = (testfile*)g_hash_table_lookup(test->files,id->data);
 		
-		// Requires information from other file
-		if(g_strcmp0(membstring,"{parent}") == 0) {
+		if(!tfile->fixture && g_strcmp0(tfile->file,"Empty.json") != 0)
+			tests_add_error(&errors,tfile,"file cannot be mapped or is not valid json");
 		
-			// Add member name to list
-			tfile->required = g_slist_append(tfile->required,g_strdup(members[membidx]));
-			
-			JsonParser *par_parser = json_parser_new();
-			
-			// Create file offering more information
-			gchar* par_infopath = g_strjoin(".",filepath,"info",members[membidx],"json",NULL);
-			
-			if(load_json_from_file(par_parser,par_infopath)) {
-				JsonGenerator *par_generator = json_generator_new();
-				json_generator_set_root(par_generator, json_parser_get_root(par_parser));
-				
-				// Initialize struct for the new json and store json
-				jsonreply* info = jsonreply_initialize();
-				info->data = json_generator_to_data(par_generator,&(info->length));
-				
-				// To verify that this item is in correct position in the list 
-				// and corresponds to the member string location
-				gint add_position = g_slist_length(tfile->required) - 1;
-				tfile->reqinfo = g_slist_insert(tfile->reqinfo,info,add_position);
+		tests_check_references(test,tfile,&errors);
+	}
+	
+	for(GSList* error = errors; error; error = g_slist_next(error))
+		g_print("Test \"%s\": %s\n",test->name,(gchar*)error->data);
+	
+	guint count = g_slist_length(errors);
+	g_slist_free_full(errors,(GDestroyNotify)g_free);
+	return count;
+}
 
-				g_object_unref(par_generator);
-			}
-			g_free(par_infopath);
-			g_object_unref(par_parser);
+/**
+* Check the files of a test without running it. No requests are sent.
+*
+* @param test Test details
+* @param username User whose test is checked
+*
+* @return Amount of errors found
+*/
+guint tests_check_test(gchar* username, testcase* test) {
+	gchar* testpath = tests_make_path_for_test(username,test);
+	
+	tests_build_test_sequence(test);
+	guint errors = tests_validate_test(test,testpath);
+	
+	// Files are kept with the test, identical files of the following tests are shared
+	g_slist_free_full(test_sequence,(GDestroyNotify)free_key);
+	test_sequence = NULL;
+	
+	g_free(testpath);
+	return errors;
+}
+
+/**
+* Map and validate the files of the test before the run. Called by the hash
+* table foreach function only. Files that are not valid are left unmapped and
+* the step using them fails. Files of an earlier run are loaded again only
+* when they have changed.
+* 
+* @param key - Key in hash table
+* @param value - testfile to load
+* @param testpath - Base path to tests
+*/
+void tests_load_fixture(gpointer key, gpointer value, gpointer testpath) {
+	testfile* tfile = (testfile*)value;
+	
+	if(g_strcmp0(tfile->file,"Empty.json") == 0) return;
+	
+	// Kept from the previous run unless the files were changed
+	if(tfile->fixture) {
+		if(fixture_is_current(tfile->fixture)) return;
+		free_fixture(tfile->fixture);
+		tfile->fixture = NULL;
+	}
+	
+	gchar* filepath = g_strjoin("/",(gchar*)testpath,tfile->file,NULL);
+	tfile->fixture = fixture_load(filepath);
+	g_free(filepath);
+}
+
+/**
+* Register the values captured from the replies of the testfiles. Login token
+* and user_guid are needed for authentication and SignOut, the guid of each
+* file to be deleted by cleanup and the values of {parent} members by the
+* steps containing them. Captures declared in preferences and variables of
+* paths were registered when preferences were loaded. Registering is done
+* once, the captures are kept with the files.
+*
+* @param test Test details
+*/
+void tests_plan_captures(testcase* test) {
+	
+	for(GSList* iter = test_sequence; iter; iter = g_slist_next(iter)) {
+		testfile* tfile = (testfile*)g_hash_table_lookup(test->files,iter->data);
+		
+		// Needed by authentication and cleanup
+		if(iter == test_sequence) {
+			capture_add_to_file(tfile,"data.token");
+			capture_add_to_file(tfile,"data.user_guid");
 		}
+		else if(tfile->need_delete) capture_add_to_file(tfile,"data.guid");
 		
-		// Requires more information from the server
-		if(g_strcmp0(membstring,"{getinfo}") == 0) {
+		// Empty.json is not mapped
+		if(!tests_file_sending_method(tfile->method) || !tfile->fixture) continue;
 		
-			// Add member name to list
-			tfile->moreinfo = g_slist_append(tfile->moreinfo,g_strdup(members[membidx]));
+		// Go through all {parent} members, their values are captured from the replies of other files
+		for(GSList* member = tfile->fixture->parents; member; member = g_slist_next(member)) {
+			reference* ref = (reference*)member->data;
 			
-			JsonParser *info_parser = json_parser_new();
-			
-			// Create path to the file offering more information
-			gchar* infopath = g_strjoin(".",filepath,"getinfo",members[membidx],"json",NULL);
-			
-			// Load the json file
-			if(load_json_from_file(info_parser,infopath)) {
-				JsonGenerator *info_generator = json_generator_new();
-				json_generator_set_root(info_generator, json_parser_get_root(info_parser));
-				
-				// Initialize struct for the new json and store json
-				jsonreply* info = jsonreply_initialize();
-				info->data = json_generator_to_data(info_generator,&(info->length));
-				
-				// To verify that this item is in correct position in the list 
-				// and corresponds to the member string location
-				gint add_position = g_slist_length(tfile->moreinfo) - 1;
-				tfile->infosend = g_slist_insert(tfile->infosend,info,add_position);
-
-				g_object_unref(info_generator);
-			}
-			g_free(infopath);
-			g_object_unref(info_parser);
+			if(ref->search_file && ref->select)
+				capture_add_to_file((testfile*)g_hash_table_lookup(test->files,ref->search_file),
+					ref->select->expression);
 		}
-		g_free(membstring);
 	}
-		
-	g_strfreev(members);
-	g_free(filepath);
-	g_object_unref(reader);
+}
+
+/**
+* Release the data of the conducted step and its reply. Values needed by
+* later steps were captured when the reply arrived.
+*
+* @param tfile Testfile of the conducted step
+*/
+void tests_release_replies(testfile* tfile) {
+
+	// Data sent and replies for {getinfo} are not needed anymore
+	free_jsonreply(tfile->send);
+	tfile->send = NULL;
+	
+	g_slist_free_full(tfile->inforecv,(GDestroyNotify)free_jsonreply);
+	tfile->inforecv = NULL;
+	
+	if(release_testfile_reply(tfile)) {
+#ifdef G_MESSAGES_DEBUG
+		g_print("Released reply of test id \"%s\", captured %d values\n",
+			tfile->id,g_slist_length(tfile->captures));
+#endif
+	}
 }
 
 /**
@@ -6,21 +6,36 @@
 #include "jsonutils.h"
 #include "utils.h"
 
+void tests_set_resume_point(const gchar* id);
+void tests_set_keep_resources(gboolean keep);
+void tests_set_bounded_memory(gboolean bounded);
+void tests_set_deadline(guint seconds);
+guint tests_get_slow_steps();
+const gchar* tests_get_failed_step();
+
 void tests_initialize(testcase* test);
 void tests_reset(testcase* test);
 
 gboolean tests_run_test(gchar* username, testcase* test);
 
-void tests_check_fields_from_testfiles(gpointer key, gpointer value, gpointer testpath);
-
-void tests_check_fields_from_loaded_testfile(JsonParser *parser,testfile *tfile, gchar* testpath);
+void tests_check_fields_from_fixture(testfile *tfile, gchar* testpath);
+void tests_load_fixture(gpointer key, gpointer value, gpointer testpath);
+guint tests_validate_test(testcase* test, gchar* testpath);
+guint tests_check_test(gchar* username, testcase* test);
 
 gchar* tests_make_path_for_test(gchar* username, testcase* test);
 
 void tests_build_test_sequence(testcase* test);
 
+void tests_plan_captures(testcase* test);
+void tests_release_replies(testfile* tfile);
+
 gboolean tests_conduct_tests(testcase* test, gchar* testpath);
 
+void tests_unload_file(testcase* test, testfile* tfile, gboolean login);
 void tests_unload_tests(testcase* test, gchar* testpath);
 
+void tests_cleanup_checkpoint(testcase* test, gchar* testpath);
+void tests_cleanup_pending(gchar* username, testcase* test);
+
 #endif
\ No newline at end of file
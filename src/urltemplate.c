@@ -0,0 +1,312 @@
+#include "urltemplate.h"
+#include "capture.h"
+
+/**
+* Print error of compilation with the position in expression.
+*
+* @param expression Expression being compiled
+* @param pos Position of the error
+* @param reason Reason of the error
+*/
+static void urltemplate_print_error(const gchar* expression, const gchar* pos, const gchar* reason) {
+	g_print("Invalid path template \"%s\" at position %ld: %s\n",expression,(glong)(pos - expression),reason);
+}
+
+/**
+* Add a literal part to template, empty literals are not added.
+*
+* @param tmpl Template to add to
+* @param start Start of the literal
+* @param length Length of the literal
+*/
+static void urltemplate_add_literal(urltemplate* tmpl, const gchar* start, gsize length) {
+	if(length == 0) return;
+	
+	urltemplate_part part = { 0 };
+	part.literal = g_strndup(start,length);
+	part.length = length;
+	g_array_append_val(tmpl->parts,part);
+	tmpl->literal_length += length;
+}
+
+/**
+* Compile a path template. Variables are written in braces, e.g.
+* Cases/{case.guid}/metrics or Hours?case={case.guid}, the rest of the path
+* including query string is literal. Variables are bound to the files of
+* the test with urltemplate_compile_test().
+*
+* @param expression Path to compile
+*
+* @return Newly allocated urltemplate_t to be free'd with free_urltemplate() or NULL if not valid
+*/
+urltemplate* urltemplate_compile(const gchar* expression) {
+	if(!expression) return NULL;
+	
+	urltemplate* tmpl = g_new0(struct urltemplate_t,1);
+	tmpl->expression = g_strdup(expression);
+	tmpl->parts = g_array_new(FALSE,TRUE,sizeof(urltemplate_part));
+	
+	const gchar* p = expression;
+	const gchar* literal = expression;
+	
+	while(*p) {
+		if(*p == '}') {
+			urltemplate_print_error(expression,p,"} without {");
+			free_urltemplate(tmpl);
+			return NULL;
+		}
+		if(*p != '{') {
+			p++;
+			continue;
+		}
+		
+		urltemplate_add_literal(tmpl,literal,p - literal);
+		
+		const gchar* name = ++p;
+		while(*p && *p != '}' && *p != '{' && *p != '/' && !g_ascii_isspace(*p)) p++;
+		
+		if(*p != '}' || p == name) {
+			urltemplate_print_error(expression,p,p == name ? "variable name expected" : "} expected");
+			free_urltemplate(tmpl);
+			return NULL;
+		}
+		
+		urltemplate_part part = { 0 };
+		part.name = g_strndup(name,p - name);
+		g_array_append_val(tmpl->parts,part);
+		
+		literal = ++p;
+	}
+	urltemplate_add_literal(tmpl,literal,p - literal);
+	
+	return tmpl;
+}
+
+/**
+* Find a file by the name used in templates, files without a name are
+* found with their id.
+*
+* @param test Test to search
+* @param name Name or id of the file
+*
+* @return Testfile or NULL if not found
+*/
+static testfile* urltemplate_find_file(testcase* test, const gchar* name) {
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	
+	g_hash_table_iter_init(&iter,test->files);
+	while(g_hash_table_iter_next(&iter,&key,&value))
+		if(g_strcmp0(((testfile*)value)->name,name) == 0) return (testfile*)value;
+	
+	return (testfile*)g_hash_table_lookup(test->files,name);
+}
+
+/**
+* Find the file declaring a capture with the name.
+*
+* @param test Test to search
+* @param name Name of the capture
+*
+* @return Testfile or NULL if not found
+*/
+static testfile* urltemplate_find_capture(testcase* test, const gchar* name) {
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	
+	g_hash_table_iter_init(&iter,test->files);
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		for(GSList* cap = ((testfile*)value)->captures; cap; cap = g_slist_next(cap))
+			if(g_strcmp0(((capture*)cap->data)->name,name) == 0) return (testfile*)value;
+	}
+	return NULL;
+}
+
+/**
+* Bind the variables of a template to the files of the test. Variable
+* {name.path} refers to the value at data.path in the reply of the file
+* with the name, {id} is the guid of the case (id "0") and {name} is a
+* value captured as declared in the "capture" of a file. The value is
+* added to the captures of the file so it is taken when the reply arrives.
+*
+* @param tmpl Template to bind
+* @param test Test whose files are referred
+*/
+static void urltemplate_bind(urltemplate* tmpl, testcase* test) {
+	for(guint index = 0; index < tmpl->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tmpl->parts,urltemplate_part,index);
+		if(part->literal) continue;
+		
+		const gchar* member = strchr(part->name,'.');
+		gchar* owner = member ? g_strndup(part->name,member - part->name) : g_strdup(part->name);
+		gchar* path = member ? g_strjoin(".","data",member + 1,NULL) : NULL;
+		
+		if(g_strcmp0(part->name,"id") == 0) {
+			g_free(owner);
+			owner = g_strdup("0");
+			path = g_strdup("data.guid");
+		}
+		
+		testfile* source = NULL;
+		if(!path) source = urltemplate_find_capture(test,part->name);
+		else if((source = urltemplate_find_file(test,owner)) && !capture_add(&source->captures,part->name,path))
+			source = NULL;
+		
+		if(source) part->file = g_strdup(source->id);
+		
+		g_free(owner);
+		g_free(path);
+	}
+}
+
+/**
+* Compile the paths of all files of the test and bind their variables.
+* Called once when preferences are loaded. Files whose path is not valid
+* are left without template, validation of the test reports them.
+*
+* @param test Test to compile
+*
+* @return TRUE when all paths were compiled
+*/
+gboolean urltemplate_compile_test(testcase* test) {
+	if(!test) return FALSE;
+	
+	gboolean rval = TRUE;
+	GHashTableIter iter;
+	gpointer key = NULL, value = NULL;
+	
+	g_hash_table_iter_init(&iter,test->files);
+	while(g_hash_table_iter_next(&iter,&key,&value)) {
+		testfile* tfile = (testfile*)value;
+		
+		free_urltemplate(tfile->template);
+		if((tfile->template = urltemplate_compile(tfile->path))) urltemplate_bind(tfile->template,test);
+		else rval = FALSE;
+	}
+	return rval;
+}
+
+/**
+* Check whether character is unreserved in url and can be written as is.
+*
+* @param c Character to check
+*
+* @return TRUE when character is unreserved
+*/
+static gboolean urltemplate_is_unreserved(gchar c) {
+	return g_ascii_isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+/**
+* Get the length of a value after percent-encoding.
+*
+* @param value Value to encode
+*
+* @return Length of the encoded value
+*/
+static gsize urltemplate_escaped_length(const gchar* value) {
+	gsize length = 0;
+	for(const gchar* c = value; *c; c++) length += urltemplate_is_unreserved(*c) ? 1 : 3;
+	return length;
+}
+
+/**
+* Write a value percent-encoded.
+*
+* @param pos Position to write to, must have room for the encoded value
+* @param value Value to encode
+*
+* @return Position after the written value
+*/
+static gchar* urltemplate_write_escaped(gchar* pos, const gchar* value) {
+	static const gchar hex[] = "0123456789ABCDEF";
+	
+	for(const gchar* c = value; *c; c++) {
+		if(urltemplate_is_unreserved(*c)) *pos++ = *c;
+		else {
+			*pos++ = '%';
+			*pos++ = hex[(guchar)*c >> 4];
+			*pos++ = hex[(guchar)*c & 0x0f];
+		}
+	}
+	return pos;
+}
+
+/**
+* Render the url of a template: base, '/', the path with variables replaced
+* by the values in capture store and '/' with suffix when given. Length is
+* calculated first so the url is written to a single allocation. Values
+* are percent-encoded.
+*
+* @param tmpl Template to render
+* @param ar Arena to allocate from, when NULL url must be free'd with g_free()
+* @param base Base url
+* @param suffix Last segment of the url, e.g. guid of the resource, can be NULL
+*
+* @return Url or NULL if a value was not captured
+*/
+gchar* urltemplate_render(urltemplate* tmpl, arena* ar, const gchar* base, const gchar* suffix) {
+	if(!tmpl || !base) return NULL;
+	
+	gsize baselength = strlen(base);
+	gsize suffixlength = suffix ? strlen(suffix) : 0;
+	gsize length = baselength + 1 + tmpl->literal_length + (suffix ? suffixlength + 1 : 0);
+	
+	for(guint index = 0; index < tmpl->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tmpl->parts,urltemplate_part,index);
+		if(part->literal) continue;
+		
+		const gchar* value = capture_get(part->name);
+		if(!value) {
+			g_print("Value of {%s} in path \"%s\" was not captured\n",part->name,tmpl->expression);
+			return NULL;
+		}
+		length += urltemplate_escaped_length(value);
+	}
+	
+	gchar* url = ar ? (gchar*)arena_alloc(ar,length + 1) : (gchar*)g_malloc(length + 1);
+	gchar* pos = url;
+	
+	memcpy(pos,base,baselength);
+	pos += baselength;
+	*pos++ = '/';
+	
+	for(guint index = 0; index < tmpl->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tmpl->parts,urltemplate_part,index);
+		
+		if(part->literal) {
+			memcpy(pos,part->literal,part->length);
+			pos += part->length;
+		}
+		else pos = urltemplate_write_escaped(pos,capture_get(part->name));
+	}
+	
+	if(suffix) {
+		*pos++ = '/';
+		memcpy(pos,suffix,suffixlength);
+		pos += suffixlength;
+	}
+	*pos = '\0';
+	
+	return url;
+}
+
+/**
+* Free a compiled template.
+*
+* @param data Pointer to urltemplate_t to free
+*/
+void free_urltemplate(gpointer data) {
+	urltemplate* tmpl = (urltemplate*)data;
+	if(!tmpl) return;
+	
+	for(guint index = 0; index < tmpl->parts->len; index++) {
+		urltemplate_part* part = &g_array_index(tmpl->parts,urltemplate_part,index);
+		g_free(part->literal);
+		g_free(part->name);
+		g_free(part->file);
+	}
+	g_array_free(tmpl->parts,TRUE);
+	g_free(tmpl->expression);
+	g_free(tmpl);
+}
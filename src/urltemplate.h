@@ -0,0 +1,12 @@
+#ifndef __URLTEMPLATE_H_
+#define __URLTEMPLATE_H_
+
+#include "definitions.h"
+#include "arena.h"
+
+urltemplate* urltemplate_compile(const gchar* expression);
+gboolean urltemplate_compile_test(testcase* test);
+gchar* urltemplate_render(urltemplate* tmpl, arena* ar, const gchar* base, const gchar* suffix);
+void free_urltemplate(gpointer data);
+
+#endif
@@ -1,4 +1,9 @@
+#include <unistd.h>
 #include "utils.h"
+#include "arena.h"
+#include "fixtures.h"
+#include "urltemplate.h"
+#include "capture.h"
 
 static JsonParser* default_parser = NULL;
 
@@ -40,6 +45,24 @@ gboolean string_is_integer(const gchar* string) {
 	return TRUE;
 }
 
+/**
+* Check whether string is a decimal number: digits with at most one
+* decimal point.
+*
+* @param string to be checked
+*
+* @return TRUE when string has digits and at most one '.'
+*/
+gboolean string_is_decimal(const gchar* string) {
+	gint length = strlen(string), digits = 0, points = 0;
+	for(gint strindex = 0; strindex < length; strindex++) {
+		if(string[strindex] == '.') points++;
+		else if(g_ascii_isdigit(string[strindex])) digits++;
+		else return FALSE;
+	}
+	return digits > 0 && points <= 1;
+}
+
 /**
 * A functions for running foreach() on GHashTable for searching a particular
 * key value from it.
@@ -129,6 +152,22 @@ testcase* testcase_initialize(const gchar* url, const gchar* testname, const gch
 		(GDestroyNotify)free_key,
 		(GDestroyNotify)free_testfile);
 	test->intfields = NULL;	
+	test->bounded_memory = FALSE;
+	test->timeouts.connect_ms = TIMEOUT_CONNECT_MS;
+	test->timeouts.total_ms = TIMEOUT_TOTAL_MS;
+	test->timeouts.low_speed_bytes = TIMEOUT_LOW_SPEED_BYTES;
+	test->timeouts.low_speed_s = TIMEOUT_LOW_SPEED_S;
+	test->deadline_s = 0;
+	test->reserve_s = DEADLINE_RESERVE_S;
+	test->rate = 0.0;
+	test->burst = 1;
+	test->max_in_flight = 0;
+	test->prewarm = TRUE;
+	test->retries = g_hash_table_new_full(
+		(GHashFunc)g_str_hash,
+		(GEqualFunc)g_str_equal,
+		(GDestroyNotify)free_key,
+		(GDestroyNotify)free_key);
 	return test;
 }
 
@@ -161,25 +200,25 @@ void testcase_reset_file(gpointer key, gpointer data, gpointer user) {
  	if(!data) return;
  	testfile *tfile = (testfile*)data;
  	
+ 	// Fixture is kept for the next run and reloaded if its files change, it is free'd with the testfile
  	free_jsonreply(tfile->send);
 	free_jsonreply(tfile->recv);
 	tfile->send = NULL;
 	tfile->recv = NULL;
 	
-	g_slist_free_full(tfile->required,(GDestroyNotify)free_key);
-	g_slist_free_full(tfile->moreinfo,(GDestroyNotify)free_key);
+	// Member names are owned by the fixture
+	g_slist_free(tfile->required);
+	g_slist_free(tfile->moreinfo);
 	
 	g_hash_table_remove_all(tfile->replace);
 	
-	g_slist_free_full(tfile->reqinfo,(GDestroyNotify)free_jsonreply);
-	g_slist_free_full(tfile->infosend,(GDestroyNotify)free_jsonreply);
 	g_slist_free_full(tfile->inforecv,(GDestroyNotify)free_jsonreply);
 	
 	tfile->required = NULL;
-	tfile->reqinfo = NULL;
 	tfile->moreinfo = NULL;
-	tfile->infosend = NULL;
 	tfile->inforecv = NULL;
+	
+	tfile->released = FALSE;
 }
 
 /**
@@ -208,28 +247,49 @@ testfile* testfile_initialize(const gchar* tid, const gchar* jsonfile, const gch
 	tfile->send = NULL;
 	tfile->recv = NULL;
 	
-	tfile->replace = g_hash_table_new_full(
+	// Keys and values of these are allocated from run arena
+	tfile->replace = g_hash_table_new(
 		(GHashFunc)g_str_hash,
-		(GEqualFunc)g_str_equal,
-		(GDestroyNotify)free_key,
-		(GDestroyNotify)free_key);
+		(GEqualFunc)g_str_equal);
 	
 	tfile->required = NULL;
-	tfile->reqinfo = NULL;
 	tfile->moreinfo = NULL;
-	tfile->infosend = NULL;
 	tfile->inforecv = NULL;
+	
+	tfile->order = -1;
+	tfile->released = FALSE;
 
 	return tfile;
 }
 
 /**
 * Initialize a jsonreply_t with g_new0() and return a pointer to it.
+* Reply is not spilled to a file (spill_fd is -1).
 *
 * @return newly allocated jsonreply_t as pointer
 */
 jsonreply* jsonreply_initialize() {
-	return g_new0(struct jsonreply_t,1);
+	jsonreply* reply = g_new0(struct jsonreply_t,1);
+	reply->spill_fd = -1;
+	return reply;
+}
+
+/**
+* Initialize retry policy with default values that disable retrying.
+* Backoff starts from RETRY_BACKOFF_MS and is limited to RETRY_MAX_BACKOFF_MS,
+* hedge delay is HEDGE_DELAY_MS until enough latencies are collected.
+*
+* @return Pointer to newly allocated retry_policy_t, free with g_free()
+*/
+retry_policy* retry_policy_initialize() {
+	retry_policy* policy = g_new0(struct retry_policy_t,1);
+	policy->attempts = 1;
+	policy->backoff_ms = RETRY_BACKOFF_MS;
+	policy->max_backoff_ms = RETRY_MAX_BACKOFF_MS;
+	policy->idempotency_key = FALSE;
+	policy->hedge = FALSE;
+	policy->hedge_ms = HEDGE_DELAY_MS;
+	return policy;
 }
 
 /**
@@ -308,15 +368,17 @@ void free_testcase(gpointer data) {
 		test->files = NULL;
 	}
 	g_slist_free_full(test->intfields,(GDestroyNotify)free_key);
+	if(test->retries) g_hash_table_destroy(test->retries);
+	g_slist_free_full(test->cacheable,(GDestroyNotify)free_key);
 	g_free(test);
 }
 
 /**
 * Free a single testfile, called by GHashTable destroy notification.
 * Clears strings with g_free() and frees GSLists with
-* g_slist_free_full() using free_key() for list of strings and
-* free_jsonreply() for the lists of JSONS as well as send and recv
-* structures.
+* g_slist_free_full() using free_jsonreply() for the lists of JSONS
+* as well as send and recv structures. Lists of member names contain
+* strings of the fixture and only the lists are free'd.
 *
 * @param data pointer to testfile to free
 */
@@ -328,18 +390,22 @@ void free_testfile(gpointer data) {
 	g_free(tfile->file);
 	g_free(tfile->path);
 	g_free(tfile->method);
+	g_free(tfile->name);
+	
+	free_urltemplate(tfile->template);
+	g_slist_free_full(tfile->captures,(GDestroyNotify)free_capture);
 
+	free_fixture(tfile->fixture);
 	free_jsonreply(tfile->send);
 	free_jsonreply(tfile->recv);
 	
 	g_hash_table_destroy(tfile->replace);
 
-	g_slist_free_full(tfile->required,(GDestroyNotify)free_key);
-	g_slist_free_full(tfile->moreinfo,(GDestroyNotify)free_key);
+	g_slist_free(tfile->required);
+	g_slist_free(tfile->moreinfo);
 
-	g_slist_free_full(tfile->reqinfo,(GDestroyNotify)free_jsonreply);
-	g_slist_free_full(tfile->infosend,(GDestroyNotify)free_jsonreply);
 	g_slist_free_full(tfile->inforecv,(GDestroyNotify)free_jsonreply);
+	
 
 	g_free(tfile);
 }
@@ -352,7 +418,13 @@ void free_testfile(gpointer data) {
 void free_jsonreply(gpointer data) {
 	jsonreply* item = (jsonreply*)data;
 	if(item) {
-		g_free(item->data);
+		if(item->spill_fd >= 0) close(item->spill_fd);
+		if(item->parser) g_object_unref(item->parser);
+		if(item->mapped) g_mapped_file_unref(item->mapped);
+		else g_free(item->data);
+		g_slist_free_full(item->attempts,(GDestroyNotify)g_free);
+		g_free(item->cache.etag);
+		g_free(item->cache.last_modified);
 		g_free(item);
 	}
 }
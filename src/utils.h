@@ -8,6 +8,7 @@ void set_parser(JsonParser *parser);
 JsonParser* get_parser();
 
 gboolean string_is_integer(const gchar* string);
+gboolean string_is_decimal(const gchar* string);
 gboolean find_from_hash_table(gpointer key, gpointer value, gpointer user_data);
 
 user_preference* preference_initialize(const gchar* username);
@@ -22,6 +23,7 @@ void testcase_reset_file(gpointer key, gpointer data, gpointer user);
 testfile* testfile_initialize(const gchar* id, const gchar* file, const gchar* path, const gchar* method, gboolean delete);
 
 jsonreply* jsonreply_initialize();
+retry_policy* retry_policy_initialize();
 
 void free_all_preferences(gpointer data);
 gboolean free_preferences(GHashTable* userlist, const gchar* username);